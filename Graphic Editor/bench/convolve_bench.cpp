@@ -0,0 +1,100 @@
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <vector>
+#include "convolve.h"
+
+// Сравнивает convolveSurface с эталоном convolveReference на случайном
+// изображении для нескольких ядер; время и расхождение пишутся через SDL_Log.
+// Запуск: ConvolveBench [размер], по умолчанию 1024.
+
+namespace {
+
+Kernel randomKernel(int n) {
+    std::vector<float> w(n * n);
+    for (float& v : w) v = static_cast<float>(SDL_rand(9) - 3);
+    Kernel k;
+    Kernel::fromWeights(w, k);
+    return k;
+}
+
+Kernel binomial(int n) {
+    std::vector<float> row(1, 1.0f);
+    while (static_cast<int>(row.size()) < n) {
+        std::vector<float> next(row.size() + 1, 0.0f);
+        for (size_t i = 0; i < row.size(); ++i) {
+            next[i] += row[i];
+            next[i + 1] += row[i];
+        }
+        row = next;
+    }
+    std::vector<float> w(n * n);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) w[y * n + x] = row[y] * row[x];
+    }
+    Kernel k;
+    Kernel::fromWeights(w, k);
+    return k;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const int size = argc > 1 ? std::max(16, atoi(argv[1])) : 1024;
+
+    SDL_Surface* image = SDL_CreateSurface(size, size, SDL_PIXELFORMAT_RGBA32);
+    if (!image) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ConvolveBench: %s", SDL_GetError());
+        return 1;
+    }
+    Uint8* pixels = static_cast<Uint8*>(image->pixels);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size * 4; ++x) pixels[y * image->pitch + x] = static_cast<Uint8>(SDL_rand(256));
+    }
+
+    struct Case { const char* name; Kernel kernel; };
+    const Case cases[] = {
+        { "sharpen 3x3", Kernel::sharpen() },
+        { "edge 3x3", Kernel::edgeDetect() },
+        { "box 7x7", Kernel::box(7) },
+        { "random 7x7", randomKernel(7) },
+        { "binomial 15x15", binomial(15) },
+        { "random 15x15", randomKernel(15) },
+    };
+
+    const double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+    for (const Case& c : cases) {
+        SDL_Surface* fast = SDL_DuplicateSurface(image);
+        SDL_Surface* naive = SDL_DuplicateSurface(image);
+        if (!fast || !naive) {
+            SDL_DestroySurface(fast);
+            SDL_DestroySurface(naive);
+            break;
+        }
+        std::vector<float> column, row;
+        const bool separable = c.kernel.separate(column, row);
+
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        convolveSurface(fast, c.kernel, EdgeMode::Mirror);
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        convolveReference(naive, c.kernel, EdgeMode::Mirror);
+        Uint64 t2 = SDL_GetPerformanceCounter();
+
+        int maxDiff = 0;
+        for (int y = 0; y < size; ++y) {
+            const Uint8* a = static_cast<const Uint8*>(fast->pixels) + y * fast->pitch;
+            const Uint8* b = static_cast<const Uint8*>(naive->pixels) + y * naive->pitch;
+            for (int x = 0; x < size * 4; ++x) maxDiff = std::max(maxDiff, abs(a[x] - b[x]));
+        }
+        double fastMs = (t1 - t0) * 1000.0 / freq;
+        double naiveMs = (t2 - t1) * 1000.0 / freq;
+        SDL_Log("convolve %dx%d %s%s: %.1f ms, naive %.1f ms (x%.1f), max diff %d",
+                size, size, c.name, separable ? " (separable)" : "", fastMs, naiveMs,
+                fastMs > 0.0 ? naiveMs / fastMs : 0.0, maxDiff);
+
+        SDL_DestroySurface(fast);
+        SDL_DestroySurface(naive);
+    }
+    SDL_DestroySurface(image);
+    return 0;
+}
@@ -12,5 +12,8 @@ public:
     // (Необязательно) Проверка попадания в объект — например, для выбора
     virtual bool contains(int x, int y, float scale, float offsetX, float offsetY) const { return false; }
 
+    // Рамка в мировых координатах для отсечения; false — неизвестна, рисовать всегда
+    virtual bool bounds(SDL_FRect& out) const { return false; }
+
     //virtual void drawToSurface(SDL_Surface* surface) const = 0;
 };
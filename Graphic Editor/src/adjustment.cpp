@@ -0,0 +1,366 @@
+#include "adjustment.h"
+#include "blur.h"
+#include "tiles.h"
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+constexpr float Pi = 3.14159265358979f;
+
+Uint64 mix(Uint64 h, Uint64 v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+// Отпечаток всего, от чего зависит тайл (tx, ty) корректирующего слоя index
+Uint64 tileStamp(const LayerStack& layers, int index, int tx, int ty, int pad) {
+    int tx0 = std::max(0, (tx * LayerTileSize - pad) / LayerTileSize);
+    int ty0 = std::max(0, (ty * LayerTileSize - pad) / LayerTileSize);
+    int tx1 = ((tx + 1) * LayerTileSize + pad - 1) / LayerTileSize;
+    int ty1 = ((ty + 1) * LayerTileSize + pad - 1) / LayerTileSize;
+
+    Uint64 h = mix(0, layers[index].adjustment->revision());
+    for (int j = 0; j < index; ++j) {
+        const Layer& layer = layers[j];
+        if (!layer.visible) continue;
+        h = mix(h, j);
+        if (layer.adjustment) {
+            h = mix(h, reinterpret_cast<uintptr_t>(layer.adjustment.get()));
+            h = mix(h, layer.adjustment->revision());
+            continue;
+        }
+        // Объекты слоя попадают в композит — любое их изменение пересчитывает тайл
+        if (layer.shapes().size()) {
+            h = mix(h, reinterpret_cast<uintptr_t>(layer.shapeStore.get()));
+            h = mix(h, layer.shapes().revision());
+        }
+        h = mix(h, reinterpret_cast<uintptr_t>(layer.surface.get()));
+        if (!layer.surface) continue;
+        int tilesX = (layer.canvasWidth + LayerTileSize - 1) / LayerTileSize;
+        int tilesY = (layer.canvasHeight + LayerTileSize - 1) / LayerTileSize;
+        for (int y = ty0; y <= std::min(ty1, tilesY - 1); ++y) {
+            for (int x = tx0; x <= std::min(tx1, tilesX - 1); ++x) {
+                h = mix(h, layer.tileRevision(x, y));
+            }
+        }
+    }
+    return h;
+}
+
+// Накладывает n пикселей (без умножения на альфу) на непрозрачную строку буфера
+void blendRow(Uint8* dst, const Uint8* src, int n) {
+    for (int x = 0; x < n; ++x, src += 4, dst += 4) {
+        int a = src[3];
+        if (a == 0) continue;
+        if (a == 255) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            continue;
+        }
+        dst[0] = static_cast<Uint8>((src[0] * a + dst[0] * (255 - a) + 127) / 255);
+        dst[1] = static_cast<Uint8>((src[1] * a + dst[1] * (255 - a) + 127) / 255);
+        dst[2] = static_cast<Uint8>((src[2] * a + dst[2] * (255 - a) + 127) / 255);
+    }
+}
+
+// Накладывает surface слоя на непрозрачный буфер области area
+void compositeOver(Uint8* buf, int pitch, SDL_Rect area, SDL_Surface* surface) {
+    SDL_Rect bounds = { 0, 0, surface->w, surface->h };
+    SDL_Rect part;
+    if (!SDL_GetRectIntersection(&area, &bounds, &part)) return;
+
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    for (int y = part.y; y < part.y + part.h; ++y) {
+        blendRow(buf + (y - area.y) * pitch + (part.x - area.x) * 4, pixels + y * surface->pitch + part.x * 4, part.w);
+    }
+}
+
+// То же для снимка слоя: по тайлам, пересекающимся с area
+void compositeOver(Uint8* buf, int pitch, SDL_Rect area, const TileSnapshot& snapshot) {
+    SDL_Rect bounds = { 0, 0, snapshot.w, snapshot.h };
+    SDL_Rect part;
+    if (!SDL_GetRectIntersection(&area, &bounds, &part)) return;
+
+    for (int ty = part.y / LayerTileSize; ty <= (part.y + part.h - 1) / LayerTileSize; ++ty) {
+        for (int tx = part.x / LayerTileSize; tx <= (part.x + part.w - 1) / LayerTileSize; ++tx) {
+            const PixelTile& tile = *snapshot.tiles[static_cast<size_t>(ty) * snapshot.tilesX + tx];
+            SDL_Rect tileRect = { tx * LayerTileSize, ty * LayerTileSize, tile.w, tile.h };
+            SDL_Rect cell;
+            if (!SDL_GetRectIntersection(&part, &tileRect, &cell)) continue;
+            for (int y = cell.y; y < cell.y + cell.h; ++y) {
+                const Uint8* src = &tile.pixels[(static_cast<size_t>(y - tileRect.y) * tile.w + (cell.x - tileRect.x)) * 4];
+                blendRow(buf + (y - area.y) * pitch + (cell.x - area.x) * 4, src, cell.w);
+            }
+        }
+    }
+}
+
+// Считает тайл rect корректирующего слоя по снимкам входов
+std::vector<Uint8> renderTile(const AdjustmentJob& job, SDL_Rect rect) {
+    SDL_Rect area = { rect.x - job.pad, rect.y - job.pad, rect.w + 2 * job.pad, rect.h + 2 * job.pad };
+    SDL_Rect bounds = { 0, 0, job.w, job.h };
+    SDL_GetRectIntersection(&area, &bounds, &area);
+
+    const int pitch = area.w * 4;
+    std::vector<Uint8> buf(static_cast<size_t>(pitch) * area.h);
+    SDL_memset(buf.data(), 255, buf.size());   // белый холст
+
+    // Подряд идущие табличные коррекции сворачиваются в одну таблицу
+    ColorLut pending = ColorLut::identity();
+    bool hasPending = false;
+    auto flush = [&]() {
+        if (hasPending) applyLut(buf.data(), area.w, area.h, pitch, pending);
+        pending = ColorLut::identity();
+        hasPending = false;
+    };
+
+    for (const AdjustmentJob::Input& input : job.inputs) {
+        if (input.adjustment && input.adjustment->isLut()) {
+            pending = pending.then(input.adjustment->lut());
+            hasPending = true;
+            continue;
+        }
+        flush();
+        if (input.adjustment) {
+            input.adjustment->apply(buf.data(), area.w, area.h, pitch);
+        } else {
+            // Пиксели слоя (у слоя изображения это и есть его фон), затем его
+            // прямоугольники и штрихи — в том же порядке, что и при отрисовке
+            if (input.pixels) compositeOver(buf.data(), pitch, area, *input.pixels);
+            if (input.shapes) input.shapes->rasterize(buf.data(), pitch, area);
+        }
+    }
+    flush();
+
+    std::vector<Uint8> out(static_cast<size_t>(rect.w) * rect.h * 4);
+    for (int y = 0; y < rect.h; ++y) {
+        SDL_memcpy(&out[static_cast<size_t>(y) * rect.w * 4],
+                   &buf[(rect.y + y - area.y) * pitch + (rect.x - area.x) * 4], rect.w * 4);
+    }
+    return out;
+}
+
+}
+
+const char* adjustmentName(AdjustmentType type) {
+    switch (type) {
+        case AdjustmentType::Levels:        return "Levels";
+        case AdjustmentType::Curves:        return "Curves";
+        case AdjustmentType::HueSaturation: return "Hue/Saturation";
+        case AdjustmentType::Blur:          return "Blur";
+        case AdjustmentType::BrightnessContrast: return "Brightness/Contrast";
+        case AdjustmentType::Invert:        return "Invert";
+        case AdjustmentType::Posterize:     return "Posterize";
+        case AdjustmentType::Threshold:     return "Threshold";
+    }
+    return "?";
+}
+
+Adjustment::Adjustment(const AdjustmentParams& params) : params_(params) {
+    compile();
+}
+
+void Adjustment::setParams(const AdjustmentParams& params) {
+    params_ = params;
+    ++revision_;
+    compile();
+}
+
+int Adjustment::padding() const {
+    return params_.type == AdjustmentType::Blur ? static_cast<int>(ceilf(3.0f * params_.sigma)) : 0;
+}
+
+bool Adjustment::isLut() const {
+    return params_.type != AdjustmentType::HueSaturation && params_.type != AdjustmentType::Blur;
+}
+
+void Adjustment::compile() {
+    const AdjustmentParams& p = params_;
+    lut_ = ColorLut::identity();
+    switch (p.type) {
+        case AdjustmentType::Levels:
+            lut_ = ColorLut::levels(p.inBlack, p.inWhite, p.gamma, p.outBlack, p.outWhite);
+            break;
+        case AdjustmentType::Curves:
+            lut_ = ColorLut::curves(p.curve);
+            break;
+        case AdjustmentType::BrightnessContrast:
+            lut_ = ColorLut::brightnessContrast(p.brightness, p.contrast);
+            break;
+        case AdjustmentType::Invert:
+            lut_ = ColorLut::invert();
+            break;
+        case AdjustmentType::Posterize:
+            lut_ = ColorLut::posterize(p.posterizeLevels);
+            break;
+        case AdjustmentType::Threshold:
+            lut_ = ColorLut::threshold(p.thresholdLevel);
+            break;
+        case AdjustmentType::HueSaturation: {
+            // Поворот оттенка вокруг оси серого и насыщенность — матрицы feColorMatrix
+            float cs = cosf(p.hue * Pi / 180.0f), sn = sinf(p.hue * Pi / 180.0f);
+            float hm[9] = {
+                0.213f + cs * 0.787f - sn * 0.213f, 0.715f - cs * 0.715f - sn * 0.715f, 0.072f - cs * 0.072f + sn * 0.928f,
+                0.213f - cs * 0.213f + sn * 0.143f, 0.715f + cs * 0.285f + sn * 0.140f, 0.072f - cs * 0.072f - sn * 0.283f,
+                0.213f - cs * 0.213f - sn * 0.787f, 0.715f - cs * 0.715f + sn * 0.715f, 0.072f + cs * 0.928f + sn * 0.072f
+            };
+            float s = 1.0f + std::clamp(p.saturation, -100.0f, 100.0f) / 100.0f;
+            float sm[9] = {
+                0.213f + 0.787f * s, 0.715f - 0.715f * s, 0.072f - 0.072f * s,
+                0.213f - 0.213f * s, 0.715f + 0.285f * s, 0.072f - 0.072f * s,
+                0.213f - 0.213f * s, 0.715f - 0.715f * s, 0.072f + 0.928f * s
+            };
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 3; ++c) {
+                    float v = sm[r * 3] * hm[c] + sm[r * 3 + 1] * hm[3 + c] + sm[r * 3 + 2] * hm[6 + c];
+                    matrix_[r * 3 + c] = static_cast<int>(lroundf(v * 1024.0f));
+                }
+            }
+            float l = std::clamp(p.lightness, -100.0f, 100.0f);
+            lut_ = ColorLut::brightnessContrast(l, 0.0f);
+            break;
+        }
+        case AdjustmentType::Blur:
+            break;
+    }
+}
+
+void Adjustment::apply(Uint8* pixels, int w, int h, int pitch) const {
+    switch (params_.type) {
+        case AdjustmentType::HueSaturation:
+            for (int y = 0; y < h; ++y) {
+                Uint8* p = pixels + y * pitch;
+                for (int x = 0; x < w; ++x, p += 4) {
+                    int r = p[0], g = p[1], b = p[2];
+                    for (int c = 0; c < 3; ++c) {
+                        int v = (matrix_[c * 3] * r + matrix_[c * 3 + 1] * g + matrix_[c * 3 + 2] * b + 512) >> 10;
+                        p[c] = lut_.table[c][std::clamp(v, 0, 255)];
+                    }
+                }
+            }
+            break;
+        case AdjustmentType::Blur:
+            blurBuffer(pixels, w, h, pitch, 4, params_.sigma);
+            break;
+        default:
+            applyLut(pixels, w, h, pitch, lut_);
+            break;
+    }
+}
+
+int topAdjustmentLayer(const LayerStack& layers) {
+    for (int i = static_cast<int>(layers.size()) - 1; i >= 0; --i) {
+        if (layers[i].visible && layers[i].adjustment) return i;
+    }
+    return -1;
+}
+
+void compositeArea(const LayerStack& layers, SDL_Rect area, Uint8* buf, int pitch) {
+    for (int y = 0; y < area.h; ++y) SDL_memset(buf + y * pitch, 255, area.w * 4);
+
+    // Под верхним корректирующим слоем всё уже сведено в его surface
+    const int top = topAdjustmentLayer(layers);
+    for (int j = std::max(top, 0); j < static_cast<int>(layers.size()); ++j) {
+        const Layer& layer = layers[j];
+        if (!layer.visible) continue;
+        if (layer.surface) compositeOver(buf, pitch, area, layer.surface);
+        if (!layer.adjustment) layer.shapes().rasterize(buf, pitch, area);
+    }
+}
+
+std::shared_ptr<AdjustmentJob> prepareAdjustments(LayerStack& layers, SDL_Rect area) {
+    // Корректирующий слой непрозрачен и закрывает всё под собой, так что считать
+    // нужно только верхний видимый; нижние применяются внутри него
+    int top = topAdjustmentLayer(layers);
+    if (top < 0 || !layers[top].surface) return nullptr;
+
+    int pad = 0;   // с каждым размытием ниже нужна всё более широкая окрестность
+    for (int j = 0; j <= top; ++j) {
+        if (layers[j].visible && layers[j].adjustment) pad += layers[j].adjustment->padding();
+    }
+
+    Layer& layer = layers[top];
+
+    SDL_Rect bounds = { 0, 0, layer.surface->w, layer.surface->h };
+    SDL_Rect part;
+    if (!SDL_GetRectIntersection(&area, &bounds, &part)) return nullptr;
+
+    int tilesX = (bounds.w + LayerTileSize - 1) / LayerTileSize;
+    int tilesY = (bounds.h + LayerTileSize - 1) / LayerTileSize;
+    std::vector<Uint64>& stamps = layer.adjustment->tileStamps;
+    if (stamps.size() != static_cast<size_t>(tilesX * tilesY)) {
+        stamps.assign(tilesX * tilesY, 0);
+    }
+
+    auto job = std::make_shared<AdjustmentJob>();
+    for (int ty = part.y / LayerTileSize; ty <= (part.y + part.h - 1) / LayerTileSize; ++ty) {
+        for (int tx = part.x / LayerTileSize; tx <= (part.x + part.w - 1) / LayerTileSize; ++tx) {
+            Uint64 stamp = tileStamp(layers, top, tx, ty, pad);
+            if (stamps[ty * tilesX + tx] == stamp) continue;
+            SDL_Rect rect = { tx * LayerTileSize, ty * LayerTileSize, LayerTileSize, LayerTileSize };
+            SDL_GetRectIntersection(&rect, &bounds, &rect);
+            job->tiles.push_back({ ty * tilesX + tx, stamp, rect, {} });
+        }
+    }
+    if (job->tiles.empty()) return nullptr;
+
+    job->layer = layers.idAt(top);
+    job->w = bounds.w;
+    job->h = bounds.h;
+    job->pad = pad;
+    for (int j = 0; j <= top; ++j) {
+        Layer& below = layers[j];
+        if (!below.visible) continue;
+        AdjustmentJob::Input input;
+        if (below.adjustment) {
+            input.adjustment = std::make_shared<const Adjustment>(*below.adjustment);
+        } else {
+            // Снимок копирует только тайлы, изменённые с прошлого раза; рамки
+            // объектов строятся здесь, до растеризации в других потоках
+            if (below.surface) input.pixels = snapshotLayer(below);
+            if (below.shapes().size()) {
+                below.shapes().bounds();
+                input.shapes = below.shapeStore;
+            }
+        }
+        job->inputs.push_back(std::move(input));
+    }
+    return job;
+}
+
+void renderAdjustmentTile(AdjustmentJob& job, size_t i) {
+    AdjustmentJob::Tile& tile = job.tiles[i];
+    tile.pixels = renderTile(job, tile.rect);
+}
+
+int applyAdjustments(LayerStack& layers, const AdjustmentJob& job, SDL_Rect& changed) {
+    changed = SDL_Rect{ 0, 0, 0, 0 };
+    const int index = layers.indexOf(job.layer);
+    if (index < 0 || !layers[index].adjustment || !layers[index].surface) return -1;
+    Layer& layer = layers[index];
+    if (layer.surface->w != job.w || layer.surface->h != job.h) return -1;
+
+    const int tilesX = (job.w + LayerTileSize - 1) / LayerTileSize;
+    const int tilesY = (job.h + LayerTileSize - 1) / LayerTileSize;
+    std::vector<Uint64>& stamps = layer.adjustment->tileStamps;
+    if (stamps.size() != static_cast<size_t>(tilesX * tilesY)) return -1;
+    SDL_Surface* out = layer.writableSurface();   // кэш может быть общим с копией слоя
+    if (!out) return -1;
+
+    // Если входы успели измениться, отпечаток тайла уже не совпадёт с текущим,
+    // и следующий пересчёт возьмёт его снова
+    SDL_LockSurface(out);
+    for (const AdjustmentJob::Tile& tile : job.tiles) {
+        if (tile.pixels.empty()) continue;
+        for (int y = 0; y < tile.rect.h; ++y) {
+            SDL_memcpy(static_cast<Uint8*>(out->pixels) + (tile.rect.y + y) * out->pitch + tile.rect.x * 4,
+                       &tile.pixels[static_cast<size_t>(y) * tile.rect.w * 4], tile.rect.w * 4);
+        }
+        stamps[tile.tile] = tile.stamp;
+        SDL_GetRectUnion(&changed, &tile.rect, &changed);
+    }
+    SDL_UnlockSurface(out);
+    return index;
+}
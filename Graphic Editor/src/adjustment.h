@@ -0,0 +1,119 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <memory>
+#include <vector>
+#include "layerstack.h"
+#include "lut.h"
+
+enum class AdjustmentType {
+    Levels,
+    Curves,
+    HueSaturation,
+    Blur,
+    BrightnessContrast,
+    Invert,
+    Posterize,
+    Threshold
+};
+
+const char* adjustmentName(AdjustmentType type);
+
+struct AdjustmentParams {
+    AdjustmentType type = AdjustmentType::Levels;
+
+    // Levels
+    int inBlack = 0, inWhite = 255;
+    float gamma = 1.0f;
+    int outBlack = 0, outWhite = 255;
+
+    // Curves: опорные точки (вход, выход) в 0..255
+    std::vector<SDL_Point> curve = { {0, 0}, {255, 255} };
+
+    // Hue/Saturation: градусы и проценты -100..100
+    float hue = 0.0f, saturation = 0.0f, lightness = 0.0f;
+
+    // Blur
+    float sigma = 4.0f;
+
+    // Brightness/Contrast: -100..100
+    float brightness = 0.0f, contrast = 0.0f;
+
+    int posterizeLevels = 4;
+    int thresholdLevel = 128;
+};
+
+// Корректирующий слой: своих пикселей нет, результат вычисляется из слоёв под ним
+// (их пикселей и растеризованных прямоугольников и штрихов).
+// Тайлы считаются лениво и кэшируются в surface слоя; отпечаток входов каждого
+// тайла сравнивается с текущим, так что пересчёт идёт только после изменения
+// параметров или пикселей нижних слоёв в этом тайле.
+class Adjustment {
+public:
+    explicit Adjustment(const AdjustmentParams& params);
+
+    const AdjustmentParams& params() const { return params_; }
+    void setParams(const AdjustmentParams& params);
+    Uint32 revision() const { return revision_; }
+
+    // Сколько пикселей вокруг тайла нужно для его расчёта
+    int padding() const;
+
+    // Применяет коррекцию к непрозрачному буферу RGBA32 на месте
+    void apply(Uint8* pixels, int w, int h, int pitch) const;
+
+    // Коррекция сводится к одной таблице: соседние такие слои сливаются при расчёте
+    bool isLut() const;
+    const ColorLut& lut() const { return lut_; }
+
+    std::vector<Uint64> tileStamps;   // отпечатки входов посчитанных тайлов
+
+private:
+    void compile();
+
+    AdjustmentParams params_;
+    Uint32 revision_ = 1;
+    ColorLut lut_;                // табличные коррекции, яркость для Hue/Saturation
+    int matrix_[9];               // Hue/Saturation, фиксированная точка 10 бит
+};
+
+// Индекс верхнего видимого корректирующего слоя или -1. Слои под ним не видны:
+// его результат непрозрачен и уже включает их.
+int topAdjustmentLayer(const LayerStack& layers);
+
+// Видимый результат стопки в области area (координаты холста) — непрозрачный
+// RGBA32 на белом холсте, pitch байт на строку. Верхний корректирующий слой
+// берётся из его кэша, посчитанного к этому моменту.
+void compositeArea(const LayerStack& layers, SDL_Rect area, Uint8* buf, int pitch);
+
+struct TileSnapshot;
+
+// Пересчёт устаревших тайлов верхнего видимого корректирующего слоя в пуле задач.
+// Нижние корректирующие слои применяются внутри него, подряд идущие табличные —
+// одной слитой таблицей. Входы — неизменяемые снимки (тайлы пикселей, объекты,
+// копии параметров), поэтому слои можно менять, пока тайлы считаются.
+struct AdjustmentJob {
+    struct Input {
+        std::shared_ptr<const Adjustment> adjustment;   // корректирующий слой
+        std::shared_ptr<const TileSnapshot> pixels;     // или пиксели растрового слоя
+        std::shared_ptr<const ObjectStore> shapes;      // и его объекты
+    };
+    struct Tile {
+        int tile;
+        Uint64 stamp;              // отпечаток входов на момент снимка
+        SDL_Rect rect;
+        std::vector<Uint8> pixels; // rect.w * rect.h * 4 после renderAdjustmentTile
+    };
+    LayerId layer = NoLayer;
+    int w = 0, h = 0, pad = 0;
+    std::vector<Input> inputs;     // видимые слои снизу вверх, последний — сам слой
+    std::vector<Tile> tiles;
+};
+
+// Поток UI: устаревшие тайлы, пересекающиеся с area (координаты холста), и снимки
+// входов; nullptr — пересчитывать нечего
+std::shared_ptr<AdjustmentJob> prepareAdjustments(LayerStack& layers, SDL_Rect area);
+// Любой поток: считает тайл i
+void renderAdjustmentTile(AdjustmentJob& job, size_t i);
+// Поток UI: переносит посчитанные тайлы в surface слоя и запоминает их отпечатки.
+// Возвращает позицию слоя (-1 — слой удалён или сменил размер), changed — изменённая область
+int applyAdjustments(LayerStack& layers, const AdjustmentJob& job, SDL_Rect& changed);
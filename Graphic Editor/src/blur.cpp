@@ -0,0 +1,275 @@
+#include "blur.h"
+#include "parallel.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <math.h>
+
+namespace {
+
+constexpr float SmallSigma = 3.0f;
+constexpr int StripWidth = 64;   // ширина полосы столбцов для вертикальных проходов
+
+// Ядро Гаусса в фиксированной точке 16.16 (сумма ровно 65536)
+std::vector<Uint32> gaussianKernel(float sigma, int& radius) {
+    radius = std::max(1, static_cast<int>(ceilf(3.0f * sigma)));
+    std::vector<float> f(2 * radius + 1);
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; ++i) {
+        f[i + radius] = expf(-(i * i) / (2.0f * sigma * sigma));
+        sum += f[i + radius];
+    }
+    std::vector<Uint32> k(f.size());
+    Uint32 total = 0;
+    for (size_t i = 0; i < f.size(); ++i) {
+        k[i] = static_cast<Uint32>(f[i] / sum * 65536.0f + 0.5f);
+        total += k[i];
+    }
+    k[radius] += 65536 - total;   // погрешность округления — в центральный отсчёт
+    return k;
+}
+
+// Радиусы трёх box-фильтров, в сумме приближающих Гаусс с данной sigma
+void boxRadii(float sigma, int radii[3]) {
+    const int n = 3;
+    float wIdeal = sqrtf(12.0f * sigma * sigma / n + 1.0f);
+    int wl = static_cast<int>(floorf(wIdeal));
+    if (wl % 2 == 0) --wl;
+    int wu = wl + 2;
+    float mIdeal = (12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f);
+    int m = static_cast<int>(roundf(mIdeal));
+    for (int i = 0; i < n; ++i) {
+        radii[i] = ((i < m ? wl : wu) - 1) / 2;
+    }
+}
+
+template <int C>
+void gaussRow(const Uint8* src, Uint8* dst, int w, const std::vector<Uint32>& k, int r) {
+    for (int x = 0; x < w; ++x) {
+        Uint32 acc[C] = {};
+        for (int t = -r; t <= r; ++t) {
+            const Uint8* p = src + std::clamp(x + t, 0, w - 1) * C;
+            Uint32 wt = k[t + r];
+            for (int c = 0; c < C; ++c) acc[c] += wt * p[c];
+        }
+        for (int c = 0; c < C; ++c) dst[x * C + c] = static_cast<Uint8>((acc[c] + 32768) >> 16);
+    }
+}
+
+// Скользящее среднее по строке с радиусом r (края — повтор крайнего пикселя)
+template <int C>
+void boxRow(const Uint8* src, Uint8* dst, int w, int r) {
+    const float inv = 1.0f / (2 * r + 1);
+    Uint32 sum[C] = {};
+    for (int t = -r; t <= r; ++t) {
+        const Uint8* p = src + std::clamp(t, 0, w - 1) * C;
+        for (int c = 0; c < C; ++c) sum[c] += p[c];
+    }
+    for (int x = 0; x < w; ++x) {
+        for (int c = 0; c < C; ++c) dst[x * C + c] = static_cast<Uint8>(sum[c] * inv + 0.5f);
+        const Uint8* add = src + std::min(x + r + 1, w - 1) * C;
+        const Uint8* sub = src + std::max(x - r, 0) * C;
+        for (int c = 0; c < C; ++c) sum[c] += add[c] - sub[c];
+    }
+}
+
+// Скользящее среднее по столбцам [x0, x1) — одна полоса, все строки сверху вниз
+void boxColumns(const Uint8* src, Uint8* dst, int h, int pitch, int b0, int b1, int r) {
+    const int n = b1 - b0;
+    const float inv = 1.0f / (2 * r + 1);
+    std::vector<Uint32> sum(n, 0);
+    for (int t = -r; t <= r; ++t) {
+        const Uint8* row = src + static_cast<size_t>(std::clamp(t, 0, h - 1)) * pitch + b0;
+        for (int i = 0; i < n; ++i) sum[i] += row[i];
+    }
+    for (int y = 0; y < h; ++y) {
+        Uint8* out = dst + static_cast<size_t>(y) * pitch + b0;
+        for (int i = 0; i < n; ++i) out[i] = static_cast<Uint8>(sum[i] * inv + 0.5f);
+        const Uint8* add = src + static_cast<size_t>(std::min(y + r + 1, h - 1)) * pitch + b0;
+        const Uint8* sub = src + static_cast<size_t>(std::max(y - r, 0)) * pitch + b0;
+        for (int i = 0; i < n; ++i) sum[i] += add[i] - sub[i];
+    }
+}
+
+template <int C>
+void blurImpl(Uint8* pixels, int w, int h, int pitch, float sigma) {
+    std::vector<Uint8> tmp(static_cast<size_t>(pitch) * h);
+    Uint8* scratch = tmp.data();
+    const int rowBytes = w * C;
+
+    if (sigma <= SmallSigma) {
+        int r;
+        std::vector<Uint32> k = gaussianKernel(sigma, r);
+
+        // 1) По строкам: pixels -> scratch
+        parallelFor(0, h, 32, [&](int from, int to) {
+            for (int y = from; y < to; ++y) {
+                gaussRow<C>(pixels + static_cast<size_t>(y) * pitch, scratch + static_cast<size_t>(y) * pitch, w, k, r);
+            }
+        });
+        // 2) По столбцам: строка результата накапливается из 2r+1 целых строк scratch
+        parallelFor(0, h, 32, [&](int from, int to) {
+            std::vector<Uint32> acc(rowBytes);
+            for (int y = from; y < to; ++y) {
+                std::fill(acc.begin(), acc.end(), 0);
+                for (int t = -r; t <= r; ++t) {
+                    const Uint8* row = scratch + static_cast<size_t>(std::clamp(y + t, 0, h - 1)) * pitch;
+                    Uint32 wt = k[t + r];
+                    for (int i = 0; i < rowBytes; ++i) acc[i] += wt * row[i];
+                }
+                Uint8* out = pixels + static_cast<size_t>(y) * pitch;
+                for (int i = 0; i < rowBytes; ++i) out[i] = static_cast<Uint8>((acc[i] + 32768) >> 16);
+            }
+        });
+        return;
+    }
+
+    int radii[3];
+    boxRadii(sigma, radii);
+
+    // 1) Три горизонтальных прохода подряд, пока строка в кэше
+    parallelFor(0, h, 32, [&](int from, int to) {
+        std::vector<Uint8> a(rowBytes), b(rowBytes);
+        for (int y = from; y < to; ++y) {
+            Uint8* row = pixels + static_cast<size_t>(y) * pitch;
+            boxRow<C>(row, a.data(), w, radii[0]);
+            boxRow<C>(a.data(), b.data(), w, radii[1]);
+            boxRow<C>(b.data(), row, w, radii[2]);
+        }
+    });
+
+    // 2) Три вертикальных прохода полосами столбцов: pixels -> scratch -> pixels -> scratch
+    const int stripBytes = StripWidth * C;
+    const int strips = (rowBytes + stripBytes - 1) / stripBytes;
+    parallelFor(0, strips, 1, [&](int from, int to) {
+        for (int s = from; s < to; ++s) {
+            int b0 = s * stripBytes;
+            int b1 = std::min(b0 + stripBytes, rowBytes);
+            boxColumns(pixels, scratch, h, pitch, b0, b1, radii[0]);
+            boxColumns(scratch, pixels, h, pitch, b0, b1, radii[1]);
+            boxColumns(pixels, scratch, h, pitch, b0, b1, radii[2]);
+        }
+    });
+    parallelFor(0, h, 64, [&](int from, int to) {
+        for (int y = from; y < to; ++y) {
+            SDL_memcpy(pixels + static_cast<size_t>(y) * pitch, scratch + static_cast<size_t>(y) * pitch, rowBytes);
+        }
+    });
+}
+
+SDL_Rect inflate(const SDL_Rect& r, int by, int w, int h) {
+    int x0 = std::max(0, r.x - by), y0 = std::max(0, r.y - by);
+    int x1 = std::min(w, r.x + r.w + by), y1 = std::min(h, r.y + r.h + by);
+    return SDL_Rect{ x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Размывает область target слоя (с запасом 3 sigma для контекста) и передаёт
+// каждую строку результата в combine(исходная строка, размытая строка, покрытие)
+using CombineRow = std::function<void(Uint8* dst, const Uint8* blurred, const Uint8* coverage, int w)>;
+
+SDL_Rect filterWithBlur(SDL_Surface* surface, float sigma, const SelectionMask* selection,
+                        const CombineRow& combine) {
+    if (!surface || sigma <= 0.0f) return SDL_Rect{0, 0, 0, 0};
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("blurSurface: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return SDL_Rect{0, 0, 0, 0};
+    }
+
+    bool clipped = selection && selection->active();
+    SDL_Rect target = clipped ? selection->clipRect(surface->w, surface->h)
+                              : SDL_Rect{0, 0, surface->w, surface->h};
+    if (SDL_RectEmpty(&target)) return target;
+    SDL_Rect area = inflate(target, static_cast<int>(ceilf(3.0f * sigma)), surface->w, surface->h);
+
+    SDL_LockSurface(surface);
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+    const int pitch = surface->pitch;
+    const int bufPitch = area.w * 4;
+
+    // 1) Премультиплицированная копия области
+    std::vector<Uint8> buf(static_cast<size_t>(bufPitch) * area.h);
+    parallelFor(0, area.h, 64, [&](int from, int to) {
+        for (int yy = from; yy < to; ++yy) {
+            const Uint8* src = pixels + (area.y + yy) * pitch + area.x * 4;
+            Uint8* dst = buf.data() + static_cast<size_t>(yy) * bufPitch;
+            for (int xx = 0; xx < area.w; ++xx) {
+                const Uint8* s = src + xx * 4;
+                Uint8* d = dst + xx * 4;
+                d[0] = static_cast<Uint8>(s[0] * s[3] / 255);
+                d[1] = static_cast<Uint8>(s[1] * s[3] / 255);
+                d[2] = static_cast<Uint8>(s[2] * s[3] / 255);
+                d[3] = s[3];
+            }
+        }
+    });
+
+    blurBuffer(buf.data(), area.w, area.h, bufPitch, 4, sigma);
+
+    // 2) Обратно без умножения, только в target
+    parallelFor(0, target.h, 64, [&](int from, int to) {
+        std::vector<Uint8> coverage(target.w, 255);
+        std::vector<Uint8> blurred(target.w * 4);
+        for (int yy = from; yy < to; ++yy) {
+            int y = target.y + yy;
+            const Uint8* src = buf.data() + static_cast<size_t>(y - area.y) * bufPitch + (target.x - area.x) * 4;
+            for (int xx = 0; xx < target.w; ++xx) {
+                const Uint8* s = src + xx * 4;
+                Uint8* d = blurred.data() + xx * 4;
+                if (s[3] == 0) {
+                    d[0] = d[1] = d[2] = d[3] = 0;
+                    continue;
+                }
+                d[0] = static_cast<Uint8>(std::min(255, s[0] * 255 / s[3]));
+                d[1] = static_cast<Uint8>(std::min(255, s[1] * 255 / s[3]));
+                d[2] = static_cast<Uint8>(std::min(255, s[2] * 255 / s[3]));
+                d[3] = s[3];
+            }
+            if (clipped) selection->readRow(y, target.x, target.w, coverage.data());
+            combine(pixels + y * pitch + target.x * 4, blurred.data(), coverage.data(), target.w);
+        }
+    });
+
+    SDL_UnlockSurface(surface);
+    return target;
+}
+
+}
+
+void blurBuffer(Uint8* pixels, int w, int h, int pitch, int channels, float sigma) {
+    if (!pixels || w <= 0 || h <= 0 || sigma <= 0.0f) return;
+    if (channels == 4) {
+        blurImpl<4>(pixels, w, h, pitch, sigma);
+    } else if (channels == 1) {
+        blurImpl<1>(pixels, w, h, pitch, sigma);
+    } else {
+        SDL_Log("blurBuffer: unsupported channel count %d", channels);
+    }
+}
+
+SDL_Rect blurSurface(SDL_Surface* surface, float sigma, const SelectionMask* selection) {
+    return filterWithBlur(surface, sigma, selection,
+        [](Uint8* dst, const Uint8* blurred, const Uint8* coverage, int w) {
+            for (int i = 0; i < w * 4; ++i) {
+                int a = coverage[i / 4];
+                dst[i] = static_cast<Uint8>((blurred[i] * a + dst[i] * (255 - a)) / 255);
+            }
+        });
+}
+
+SDL_Rect unsharpMask(SDL_Surface* surface, float sigma, float amount, int threshold,
+                     const SelectionMask* selection) {
+    return filterWithBlur(surface, sigma, selection,
+        [amount, threshold](Uint8* dst, const Uint8* blurred, const Uint8* coverage, int w) {
+            for (int x = 0; x < w; ++x) {
+                Uint8* p = dst + x * 4;
+                const Uint8* b = blurred + x * 4;
+                int a = coverage[x];
+                for (int c = 0; c < 3; ++c) {
+                    int diff = p[c] - b[c];
+                    if (abs(diff) <= threshold) continue;
+                    int sharp = std::clamp(static_cast<int>(p[c] + amount * diff + 0.5f), 0, 255);
+                    p[c] = static_cast<Uint8>((sharp * a + p[c] * (255 - a)) / 255);
+                }
+            }
+        });
+}
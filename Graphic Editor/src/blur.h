@@ -0,0 +1,18 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "selection.h"
+
+// Размытие по Гауссу буфера с 1 или 4 каналами на месте (края — повтор крайнего пикселя).
+// При sigma <= 3 — точное сепарабельное ядро, иначе три прохода box-фильтра
+// скользящей суммой: стоимость на пиксель не зависит от радиуса.
+// Строки обрабатываются параллельно, столбцы — полосами по 64 пикселя.
+void blurBuffer(Uint8* pixels, int w, int h, int pitch, int channels, float sigma);
+
+// Размытие слоя RGBA32 (в премультиплицированной альфе, без тёмных ореолов).
+// Если выделение активно, обрабатываются только его bounds, результат
+// смешивается с исходником по покрытию. Возвращает изменённый прямоугольник.
+SDL_Rect blurSurface(SDL_Surface* surface, float sigma, const SelectionMask* selection = nullptr);
+
+// Нерезкая маска: исходник + amount * (исходник - размытие), если разница больше threshold
+SDL_Rect unsharpMask(SDL_Surface* surface, float sigma, float amount, int threshold,
+                     const SelectionMask* selection = nullptr);
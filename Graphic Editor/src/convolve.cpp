@@ -0,0 +1,345 @@
+#include "convolve.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr int Tile = 64;   // сторона выходного тайла; с полями 15x15 тайл ~100 КБ float
+
+int edgeIndex(int i, int n, EdgeMode mode) {
+    if (i >= 0 && i < n) return i;
+    switch (mode) {
+        case EdgeMode::Clamp:
+            return std::clamp(i, 0, n - 1);
+        case EdgeMode::Mirror: {
+            int period = 2 * n;
+            i %= period;
+            if (i < 0) i += period;
+            return i < n ? i : period - 1 - i;
+        }
+        case EdgeMode::Wrap:
+            i %= n;
+            return i < 0 ? i + n : i;
+        case EdgeMode::Transparent:
+            return -1;
+    }
+    return -1;
+}
+
+inline void loadPremultiplied(const Uint8* s, float* d) {
+    float a = s[3] / 255.0f;
+    d[0] = s[0] * a;
+    d[1] = s[1] * a;
+    d[2] = s[2] * a;
+    d[3] = s[3];
+}
+
+// Премультиплицированный цвет -> прямой с учётом исходной альфы и bias
+inline void storePixel(const float* sum, Uint8 alpha, float bias, Uint8* d) {
+    if (alpha == 0) {
+        d[0] = d[1] = d[2] = d[3] = 0;
+        return;
+    }
+    float k = 255.0f / alpha;
+    for (int c = 0; c < 3; ++c) {
+        d[c] = static_cast<Uint8>(std::clamp(sum[c] * k + bias + 0.5f, 0.0f, 255.0f));
+    }
+    d[3] = alpha;
+}
+
+// acc += w * row для n чисел
+void multiplyAdd(float* acc, const float* row, float w, int n) {
+    int i = 0;
+#if defined(SDL_SSE_INTRINSICS)
+    const __m128 vw = _mm_set1_ps(w);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(vw, _mm_loadu_ps(row + i))));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(vw, _mm_loadu_ps(row + i + 4))));
+    }
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(vw, _mm_loadu_ps(row + i))));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), vld1q_f32(row + i), w));
+    }
+#endif
+    for (; i < n; ++i) acc[i] += w * row[i];
+}
+
+// Тайл tw x th с полями r со всех сторон, в премультиплицированных float RGBA
+void fillPadded(const SDL_Surface* surface, int x0, int y0, int tw, int th, int r, EdgeMode edges,
+                std::vector<float>& padded) {
+    const int pw = tw + 2 * r, ph = th + 2 * r;
+    padded.resize(static_cast<size_t>(pw) * ph * 4);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    for (int py = 0; py < ph; ++py) {
+        float* d = &padded[static_cast<size_t>(py) * pw * 4];
+        int sy = edgeIndex(y0 - r + py, surface->h, edges);
+        if (sy < 0) {
+            std::fill(d, d + pw * 4, 0.0f);
+            continue;
+        }
+        const Uint8* row = pixels + sy * surface->pitch;
+        for (int px = 0; px < pw; ++px) {
+            int sx = edgeIndex(x0 - r + px, surface->w, edges);
+            if (sx < 0) {
+                d[px * 4] = d[px * 4 + 1] = d[px * 4 + 2] = d[px * 4 + 3] = 0.0f;
+            } else {
+                loadPremultiplied(row + sx * 4, d + px * 4);
+            }
+        }
+    }
+}
+
+// Веса с учётом divisor; для разделимого ядра — столбец и строка
+struct CompiledKernel {
+    int size = 0;
+    bool separable = false;
+    std::vector<float> weights, column, row;
+    float bias = 0.0f;
+};
+
+CompiledKernel compile(const Kernel& kernel) {
+    CompiledKernel ck;
+    ck.size = kernel.size;
+    ck.bias = kernel.bias;
+    const float scale = kernel.divisor != 0.0f ? 1.0f / kernel.divisor : 1.0f;
+    ck.separable = kernel.separate(ck.column, ck.row);
+    if (ck.separable) {
+        for (float& v : ck.column) v *= scale;
+    } else {
+        ck.weights = kernel.weights;
+        for (float& v : ck.weights) v *= scale;
+    }
+    return ck;
+}
+
+// Свёртка одного тайла: out (tw x th x 4) = padded * ядро
+void convolveTile(const std::vector<float>& padded, int tw, int th, const CompiledKernel& k,
+                  std::vector<float>& tmp, std::vector<float>& out) {
+    const int r = k.size / 2;
+    const int pw = tw + 2 * r, ph = th + 2 * r;
+    const int rowFloats = tw * 4;
+    out.assign(static_cast<size_t>(th) * rowFloats, 0.0f);
+
+    if (k.separable) {
+        // горизонтальный проход по всем строкам с полями, затем вертикальный
+        tmp.assign(static_cast<size_t>(ph) * rowFloats, 0.0f);
+        for (int py = 0; py < ph; ++py) {
+            const float* src = &padded[static_cast<size_t>(py) * pw * 4];
+            float* dst = &tmp[static_cast<size_t>(py) * rowFloats];
+            for (int kx = 0; kx < k.size; ++kx) {
+                if (k.row[kx] != 0.0f) multiplyAdd(dst, src + kx * 4, k.row[kx], rowFloats);
+            }
+        }
+        for (int y = 0; y < th; ++y) {
+            float* dst = &out[static_cast<size_t>(y) * rowFloats];
+            for (int ky = 0; ky < k.size; ++ky) {
+                if (k.column[ky] != 0.0f) multiplyAdd(dst, &tmp[static_cast<size_t>(y + ky) * rowFloats], k.column[ky], rowFloats);
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < th; ++y) {
+        float* dst = &out[static_cast<size_t>(y) * rowFloats];
+        for (int ky = 0; ky < k.size; ++ky) {
+            const float* src = &padded[static_cast<size_t>(y + ky) * pw * 4];
+            const float* w = &k.weights[ky * k.size];
+            for (int kx = 0; kx < k.size; ++kx) {
+                if (w[kx] != 0.0f) multiplyAdd(dst, src + kx * 4, w[kx], rowFloats);
+            }
+        }
+    }
+}
+
+SDL_Surface* copySurface(SDL_Surface* src) {
+    SDL_Surface* dst = SDL_CreateSurface(src->w, src->h, src->format);
+    if (!dst) return nullptr;
+    for (int y = 0; y < src->h; ++y) {
+        SDL_memcpy(static_cast<Uint8*>(dst->pixels) + y * dst->pitch,
+                   static_cast<const Uint8*>(src->pixels) + y * src->pitch, src->w * 4);
+    }
+    return dst;
+}
+
+}
+
+const char* edgeModeName(EdgeMode mode) {
+    switch (mode) {
+        case EdgeMode::Clamp:       return "clamp";
+        case EdgeMode::Mirror:      return "mirror";
+        case EdgeMode::Wrap:        return "wrap";
+        case EdgeMode::Transparent: return "transparent";
+    }
+    return "";
+}
+
+bool Kernel::separate(std::vector<float>& column, std::vector<float>& row) const {
+    // опорный элемент — наибольший по модулю; ранг 1, если все элементы равны
+    // произведению его столбца и строки
+    int pivot = 0;
+    for (int i = 1; i < size * size; ++i) {
+        if (fabsf(weights[i]) > fabsf(weights[pivot])) pivot = i;
+    }
+    const float p = weights[pivot];
+    if (p == 0.0f) return false;
+    const int pr = pivot / size, pc = pivot % size;
+
+    column.resize(size);
+    row.resize(size);
+    for (int i = 0; i < size; ++i) {
+        column[i] = weights[i * size + pc];
+        row[i] = weights[pr * size + i] / p;
+    }
+    const float eps = 1e-5f * fabsf(p);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (fabsf(weights[y * size + x] - column[y] * row[x]) > eps) return false;
+        }
+    }
+    return true;
+}
+
+bool Kernel::fromWeights(const std::vector<float>& weights, Kernel& out, float divisor, float bias) {
+    int n = static_cast<int>(sqrtf(static_cast<float>(weights.size())) + 0.5f);
+    if (n * n != static_cast<int>(weights.size()) || n % 2 == 0 || n < 3 || n > 15) return false;
+
+    if (divisor == 0.0f) {
+        for (float w : weights) divisor += w;
+        if (fabsf(divisor) < 1e-6f) divisor = 1.0f;   // сумма 0 — выделение краёв
+    }
+    out.size = n;
+    out.weights = weights;
+    out.divisor = divisor;
+    out.bias = bias;
+    return true;
+}
+
+Kernel Kernel::sharpen() {
+    Kernel k;
+    fromWeights({ 0, -1, 0, -1, 5, -1, 0, -1, 0 }, k);
+    return k;
+}
+
+Kernel Kernel::emboss() {
+    Kernel k;
+    fromWeights({ -2, -1, 0, -1, 1, 1, 0, 1, 2 }, k);
+    return k;
+}
+
+Kernel Kernel::edgeDetect() {
+    Kernel k;
+    fromWeights({ -1, -1, -1, -1, 8, -1, -1, -1, -1 }, k);
+    return k;
+}
+
+Kernel Kernel::box(int size) {
+    size = std::clamp(size | 1, 3, 15);
+    Kernel k;
+    fromWeights(std::vector<float>(size * size, 1.0f), k);
+    return k;
+}
+
+SDL_Rect convolveSurface(SDL_Surface* surface, const Kernel& kernel, EdgeMode edges,
+                         const SelectionMask* selection) {
+    SDL_Rect empty = { 0, 0, 0, 0 };
+    if (!surface || kernel.weights.size() != static_cast<size_t>(kernel.size * kernel.size)) return empty;
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("convolveSurface: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return empty;
+    }
+
+    const bool clipped = selection && selection->active();
+    SDL_Rect target = clipped ? selection->clipRect(surface->w, surface->h)
+                              : SDL_Rect{ 0, 0, surface->w, surface->h };
+    if (SDL_RectEmpty(&target)) return empty;
+
+    const CompiledKernel ck = compile(kernel);
+    const int r = ck.size / 2;
+    const int tilesX = (target.w + Tile - 1) / Tile;
+    const int tilesY = (target.h + Tile - 1) / Tile;
+
+    SDL_LockSurface(surface);
+
+    // 1) Тайлы читают слой и пишут в отдельный буфер результата — соседние
+    // тайлы видят исходные пиксели
+    std::vector<Uint8> result(static_cast<size_t>(target.w) * target.h * 4);
+    parallelFor(0, tilesX * tilesY, 1, [&](int from, int to) {
+        std::vector<float> padded, tmp, out;
+        for (int t = from; t < to; ++t) {
+            int x0 = target.x + (t % tilesX) * Tile;
+            int y0 = target.y + (t / tilesX) * Tile;
+            int tw = std::min(Tile, target.x + target.w - x0);
+            int th = std::min(Tile, target.y + target.h - y0);
+            fillPadded(surface, x0, y0, tw, th, r, edges, padded);
+            convolveTile(padded, tw, th, ck, tmp, out);
+
+            const int pw = tw + 2 * r;
+            for (int y = 0; y < th; ++y) {
+                Uint8* d = &result[(static_cast<size_t>(y0 - target.y + y) * target.w + (x0 - target.x)) * 4];
+                const float* center = &padded[(static_cast<size_t>(y + r) * pw + r) * 4];
+                const float* sum = &out[static_cast<size_t>(y) * tw * 4];
+                for (int x = 0; x < tw; ++x) {
+                    storePixel(sum + x * 4, static_cast<Uint8>(center[x * 4 + 3]), ck.bias, d + x * 4);
+                }
+            }
+        }
+    });
+
+    // 2) Обратно в слой, с выделением — по покрытию
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+    parallelFor(0, target.h, 64, [&](int from, int to) {
+        std::vector<Uint8> coverage(target.w, 255);
+        for (int yy = from; yy < to; ++yy) {
+            int y = target.y + yy;
+            Uint8* dst = pixels + y * surface->pitch + target.x * 4;
+            const Uint8* src = &result[static_cast<size_t>(yy) * target.w * 4];
+            if (!clipped) {
+                SDL_memcpy(dst, src, target.w * 4);
+                continue;
+            }
+            selection->readRow(y, target.x, target.w, coverage.data());
+            for (int i = 0; i < target.w * 4; ++i) {
+                int a = coverage[i / 4];
+                dst[i] = static_cast<Uint8>((src[i] * a + dst[i] * (255 - a)) / 255);
+            }
+        }
+    });
+
+    SDL_UnlockSurface(surface);
+    return target;
+}
+
+void convolveReference(SDL_Surface* surface, const Kernel& kernel, EdgeMode edges) {
+    if (!surface || surface->format != SDL_PIXELFORMAT_RGBA32) return;
+    SDL_Surface* src = copySurface(surface);
+    if (!src) return;
+
+    const int r = kernel.radius();
+    const Uint8* in = static_cast<const Uint8*>(src->pixels);
+    Uint8* out = static_cast<Uint8*>(surface->pixels);
+    for (int y = 0; y < surface->h; ++y) {
+        for (int x = 0; x < surface->w; ++x) {
+            double sum[3] = { 0, 0, 0 };
+            for (int ky = -r; ky <= r; ++ky) {
+                int sy = edgeIndex(y + ky, surface->h, edges);
+                if (sy < 0) continue;
+                for (int kx = -r; kx <= r; ++kx) {
+                    int sx = edgeIndex(x + kx, surface->w, edges);
+                    if (sx < 0) continue;
+                    const Uint8* p = in + sy * src->pitch + sx * 4;
+                    double w = kernel.weights[(ky + r) * kernel.size + (kx + r)] * (p[3] / 255.0);
+                    for (int c = 0; c < 3; ++c) sum[c] += w * p[c];
+                }
+            }
+            float scaled[3];
+            for (int c = 0; c < 3; ++c) scaled[c] = static_cast<float>(sum[c] / kernel.divisor);
+            storePixel(scaled, in[y * src->pitch + x * 4 + 3], kernel.bias, out + y * surface->pitch + x * 4);
+        }
+    }
+    SDL_DestroySurface(src);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include "selection.h"
+
+// Что подставлять за краем слоя
+enum class EdgeMode {
+    Clamp,        // повтор крайнего пикселя
+    Mirror,       // отражение (край повторяется)
+    Wrap,         // с противоположной стороны
+    Transparent   // прозрачные пиксели
+};
+
+const char* edgeModeName(EdgeMode mode);
+
+// Квадратное ядро нечётного размера от 3x3 до 15x15; результат = сумма / divisor + bias
+struct Kernel {
+    int size = 3;
+    std::vector<float> weights;   // size * size по строкам
+    float divisor = 1.0f;
+    float bias = 0.0f;
+
+    int radius() const { return size / 2; }
+    // Ядро ранга 1 раскладывается в столбец и строку: weights = column * row^T
+    bool separate(std::vector<float>& column, std::vector<float>& row) const;
+
+    // weights.size() должен быть квадратом нечётного числа 3..15; divisor 0 — сумма весов (или 1)
+    static bool fromWeights(const std::vector<float>& weights, Kernel& out, float divisor = 0.0f, float bias = 0.0f);
+    static Kernel sharpen();
+    static Kernel emboss();
+    static Kernel edgeDetect();
+    static Kernel box(int size);
+};
+
+// Свёртка цвета слоя RGBA32 (в премультиплицированном виде, альфа сохраняется).
+// Выход считается тайлами 64x64 с полями на всех ядрах; разделимые ядра — двумя
+// одномерными проходами. С активным выделением результат смешивается по покрытию.
+// Возвращает изменённый прямоугольник.
+SDL_Rect convolveSurface(SDL_Surface* surface, const Kernel& kernel, EdgeMode edges,
+                         const SelectionMask* selection = nullptr);
+
+// Наивная попиксельная свёртка всего слоя (эталон для проверки и замеров,
+// см. bench/convolve_bench.cpp)
+void convolveReference(SDL_Surface* surface, const Kernel& kernel, EdgeMode edges);
@@ -0,0 +1,285 @@
+#include "denoise.h"
+#include "parallel.h"
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr int Fine = 4 * 256;     // точные гистограммы 4 каналов подряд
+constexpr int Coarse = 4 * 16;    // грубые: старшие 4 бита
+
+inline int luma(const Uint8* p) {
+    return (54 * p[0] + 183 * p[1] + 19 * p[2] + 128) >> 8;
+}
+
+// dst += src (add) или dst -= src для n счётчиков
+void accumulate(Uint16* dst, const Uint16* src, int n, bool add) {
+    int i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), add ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t a = vld1q_u16(dst + i), b = vld1q_u16(src + i);
+        vst1q_u16(dst + i, add ? vaddq_u16(a, b) : vsubq_u16(a, b));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = add ? dst[i] + src[i] : dst[i] - src[i];
+}
+
+// Смешивает посчитанный результат области target обратно в слой
+void writeBack(SDL_Surface* surface, const SDL_Rect& target, const std::vector<Uint8>& result,
+               const SelectionMask* selection, bool clipped) {
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+    parallelFor(0, target.h, 64, [&](int from, int to) {
+        std::vector<Uint8> coverage(target.w, 255);
+        for (int yy = from; yy < to; ++yy) {
+            int y = target.y + yy;
+            Uint8* dst = pixels + y * surface->pitch + target.x * 4;
+            const Uint8* src = &result[static_cast<size_t>(yy) * target.w * 4];
+            if (!clipped) {
+                SDL_memcpy(dst, src, target.w * 4);
+                continue;
+            }
+            selection->readRow(y, target.x, target.w, coverage.data());
+            for (int i = 0; i < target.w * 4; ++i) {
+                int a = coverage[i / 4];
+                dst[i] = static_cast<Uint8>((src[i] * a + dst[i] * (255 - a)) / 255);
+            }
+        }
+    });
+}
+
+// Гистограммы столбцов [cx0, cx1) одной полосы строк
+struct ColumnHistograms {
+    int cx0 = 0, count = 0;
+    std::vector<Uint16> fine, coarse;
+
+    void reset(int first, int n) {
+        cx0 = first;
+        count = n;
+        fine.assign(static_cast<size_t>(n) * Fine, 0);
+        coarse.assign(static_cast<size_t>(n) * Coarse, 0);
+    }
+    void addRow(const Uint8* row, int delta) {
+        for (int i = 0; i < count; ++i) {
+            const Uint8* p = row + (cx0 + i) * 4;
+            Uint16* f = &fine[static_cast<size_t>(i) * Fine];
+            Uint16* c = &coarse[static_cast<size_t>(i) * Coarse];
+            for (int ch = 0; ch < 4; ++ch) {
+                f[ch * 256 + p[ch]] += delta;
+                c[ch * 16 + (p[ch] >> 4)] += delta;
+            }
+        }
+    }
+    const Uint16* fineAt(int cx) const { return &fine[static_cast<size_t>(cx - cx0) * Fine]; }
+    const Uint16* coarseAt(int cx) const { return &coarse[static_cast<size_t>(cx - cx0) * Coarse]; }
+};
+
+// Значение с рангом rank (0 — наименьшее) по грубой и точной гистограммам канала
+inline Uint8 findRank(const Uint16* fine, const Uint16* coarse, int rank) {
+    int sum = 0, bucket = 0;
+    while (bucket < 15 && sum + coarse[bucket] <= rank) sum += coarse[bucket++];
+    int v = bucket * 16;
+    const int end = v + 15;
+    while (v < end && sum + fine[v] <= rank) sum += fine[v++];
+    return static_cast<Uint8>(v);
+}
+
+}
+
+SDL_Rect medianFilter(SDL_Surface* surface, int radius, const SelectionMask* selection) {
+    SDL_Rect empty = { 0, 0, 0, 0 };
+    if (!surface || radius < 1) return empty;
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("medianFilter: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return empty;
+    }
+    const int r = std::min(radius, 100);   // (2r+1)^2 должно помещаться в Uint16
+    const bool clipped = selection && selection->active();
+    SDL_Rect target = clipped ? selection->clipRect(surface->w, surface->h)
+                              : SDL_Rect{ 0, 0, surface->w, surface->h };
+    if (SDL_RectEmpty(&target)) return empty;
+
+    SDL_LockSurface(surface);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    const int w = surface->w, h = surface->h;
+    const int cx0 = std::max(0, target.x - r);
+    const int cx1 = std::min(w, target.x + target.w + r);
+    const int rank = (2 * r + 1) * (2 * r + 1) / 2;
+    auto rowAt = [&](int y) { return pixels + std::clamp(y, 0, h - 1) * surface->pitch; };
+
+    // Полосы по числу потоков: каждая заново набирает гистограммы столбцов за 2r+1 строк
+    std::vector<Uint8> result(static_cast<size_t>(target.w) * target.h * 4);
+    const int band = std::max(16, (target.h + workerCount() - 1) / workerCount());
+    parallelFor(0, target.h, band, [&](int from, int to) {
+        ColumnHistograms cols;
+        cols.reset(cx0, cx1 - cx0);
+        for (int k = -r; k <= r; ++k) cols.addRow(rowAt(target.y + from + k), 1);
+
+        Uint16 fine[Fine], coarse[Coarse];
+        for (int yy = from; yy < to; ++yy) {
+            const int y = target.y + yy;
+            if (yy > from) {
+                cols.addRow(rowAt(y - r - 1), -1);
+                cols.addRow(rowAt(y + r), 1);
+            }
+
+            SDL_memset(fine, 0, sizeof(fine));
+            SDL_memset(coarse, 0, sizeof(coarse));
+            for (int k = -r; k <= r; ++k) {
+                int cx = std::clamp(target.x + k, 0, w - 1);
+                accumulate(fine, cols.fineAt(cx), Fine, true);
+                accumulate(coarse, cols.coarseAt(cx), Coarse, true);
+            }
+
+            Uint8* out = &result[static_cast<size_t>(yy) * target.w * 4];
+            for (int x = target.x; x < target.x + target.w; ++x, out += 4) {
+                if (x > target.x) {
+                    int add = std::min(x + r, w - 1);
+                    int sub = std::max(x - r - 1, 0);
+                    if (add != sub) {
+                        accumulate(fine, cols.fineAt(add), Fine, true);
+                        accumulate(fine, cols.fineAt(sub), Fine, false);
+                        accumulate(coarse, cols.coarseAt(add), Coarse, true);
+                        accumulate(coarse, cols.coarseAt(sub), Coarse, false);
+                    }
+                }
+                for (int ch = 0; ch < 4; ++ch) {
+                    out[ch] = findRank(fine + ch * 256, coarse + ch * 16, rank);
+                }
+            }
+        }
+    });
+
+    writeBack(surface, target, result, selection, clipped);
+    SDL_UnlockSurface(surface);
+    return target;
+}
+
+SDL_Rect bilateralFilter(SDL_Surface* surface, float sigmaSpatial, float sigmaRange,
+                         const SelectionMask* selection) {
+    SDL_Rect empty = { 0, 0, 0, 0 };
+    if (!surface || sigmaSpatial < 1.0f || sigmaRange <= 0.0f) return empty;
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("bilateralFilter: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return empty;
+    }
+    const bool clipped = selection && selection->active();
+    SDL_Rect target = clipped ? selection->clipRect(surface->w, surface->h)
+                              : SDL_Rect{ 0, 0, surface->w, surface->h };
+    if (SDL_RectEmpty(&target)) return empty;
+
+    // Сетка строится по области с запасом 2 sigma, чтобы у краёв выделения были соседи
+    const int margin = static_cast<int>(ceilf(2.0f * sigmaSpatial));
+    SDL_Rect area = { target.x - margin, target.y - margin, target.w + 2 * margin, target.h + 2 * margin };
+    SDL_Rect bounds = { 0, 0, surface->w, surface->h };
+    SDL_GetRectIntersection(&area, &bounds, &area);
+
+    constexpr int Pad = 2;   // поля под ядро [1 4 6 4 1]
+    const float s = sigmaSpatial, sr = sigmaRange;
+    const int gw = static_cast<int>((area.w - 1) / s + 0.5f) + 1 + 2 * Pad;
+    const int gh = static_cast<int>((area.h - 1) / s + 0.5f) + 1 + 2 * Pad;
+    const int gd = static_cast<int>(255.0f / sr + 0.5f) + 1 + 2 * Pad;
+    std::vector<float> grid(static_cast<size_t>(gw) * gh * gd * 4, 0.0f);
+    auto cell = [&](int gx, int gy, int gz) { return &grid[((static_cast<size_t>(gy) * gw + gx) * gd + gz) * 4]; };
+
+    SDL_LockSurface(surface);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+
+    // 1) Раскладка в ближайшую ячейку: строки пикселей одной строки сетки
+    // обрабатывает один поток, поэтому записи не пересекаются
+    std::vector<int> firstRow(gh + 1, area.h);
+    for (int yy = area.h - 1; yy >= 0; --yy) firstRow[static_cast<int>(yy / s + 0.5f) + Pad] = yy;
+    for (int g = gh - 1; g >= 0; --g) firstRow[g] = std::min(firstRow[g], firstRow[g + 1]);
+    parallelFor(Pad, gh - Pad, 1, [&](int from, int to) {
+        for (int g = from; g < to; ++g) {
+            for (int yy = firstRow[g]; yy < firstRow[g + 1]; ++yy) {
+                const Uint8* p = pixels + (area.y + yy) * surface->pitch + area.x * 4;
+                for (int xx = 0; xx < area.w; ++xx, p += 4) {
+                    if (p[3] == 0) continue;
+                    float a = p[3] / 255.0f;
+                    float* c = cell(static_cast<int>(xx / s + 0.5f) + Pad, g,
+                                    static_cast<int>(luma(p) / sr + 0.5f) + Pad);
+                    c[0] += p[0] * a;
+                    c[1] += p[1] * a;
+                    c[2] += p[2] * a;
+                    c[3] += a;
+                }
+            }
+        }
+    });
+
+    // 2) Размытие сетки ядром [1 4 6 4 1] / 16 по каждой из трёх осей
+    auto blurLines = [&](int outer, int inner, int length, auto start, size_t step) {
+        parallelFor(0, outer, 1, [&](int from, int to) {
+            std::vector<float> line(static_cast<size_t>(length) * 4);
+            for (int o = from; o < to; ++o) {
+                for (int i = 0; i < inner; ++i) {
+                    float* base = start(o, i);
+                    for (int k = 0; k < length; ++k) {
+                        SDL_memcpy(&line[k * 4], base + k * step, 4 * sizeof(float));
+                    }
+                    for (int k = 0; k < length; ++k) {
+                        float* d = base + k * step;
+                        for (int c = 0; c < 4; ++c) {
+                            float sum = 6.0f * line[k * 4 + c];
+                            if (k >= 1) sum += 4.0f * line[(k - 1) * 4 + c];
+                            if (k >= 2) sum += line[(k - 2) * 4 + c];
+                            if (k + 1 < length) sum += 4.0f * line[(k + 1) * 4 + c];
+                            if (k + 2 < length) sum += line[(k + 2) * 4 + c];
+                            d[c] = sum / 16.0f;
+                        }
+                    }
+                }
+            }
+        });
+    };
+    blurLines(gh, gw, gd, [&](int gy, int gx) { return cell(gx, gy, 0); }, 4);                         // яркость
+    blurLines(gh, gd, gw, [&](int gy, int gz) { return cell(0, gy, gz); }, static_cast<size_t>(gd) * 4); // x
+    blurLines(gw, gd, gh, [&](int gx, int gz) { return cell(gx, 0, gz); }, static_cast<size_t>(gw) * gd * 4); // y
+
+    // 3) Трилинейная выборка из сетки для каждого пикселя target
+    std::vector<Uint8> result(static_cast<size_t>(target.w) * target.h * 4);
+    parallelFor(0, target.h, 32, [&](int from, int to) {
+        for (int yy = from; yy < to; ++yy) {
+            const int y = target.y + yy;
+            const Uint8* p = pixels + y * surface->pitch + target.x * 4;
+            Uint8* out = &result[static_cast<size_t>(yy) * target.w * 4];
+            const float fy = (y - area.y) / s + Pad;
+            const int y0 = static_cast<int>(fy);
+            const float ty = fy - y0;
+            for (int x = target.x; x < target.x + target.w; ++x, p += 4, out += 4) {
+                const float fx = (x - area.x) / s + Pad;
+                const float fz = luma(p) / sr + Pad;
+                const int x0 = static_cast<int>(fx), z0 = static_cast<int>(fz);
+                const float tx = fx - x0, tz = fz - z0;
+
+                float sum[4] = { 0, 0, 0, 0 };
+                for (int corner = 0; corner < 8; ++corner) {
+                    const int dx = corner & 1, dy = (corner >> 1) & 1, dz = corner >> 2;
+                    const float wgt = (dx ? tx : 1.0f - tx) * (dy ? ty : 1.0f - ty) * (dz ? tz : 1.0f - tz);
+                    const float* c = cell(std::min(x0 + dx, gw - 1), std::min(y0 + dy, gh - 1), std::min(z0 + dz, gd - 1));
+                    for (int ch = 0; ch < 4; ++ch) sum[ch] += wgt * c[ch];
+                }
+                if (sum[3] <= 1e-6f || p[3] == 0) {
+                    SDL_memcpy(out, p, 4);
+                    continue;
+                }
+                for (int ch = 0; ch < 3; ++ch) {
+                    out[ch] = static_cast<Uint8>(std::clamp(sum[ch] / sum[3] + 0.5f, 0.0f, 255.0f));
+                }
+                out[3] = p[3];
+            }
+        }
+    });
+
+    writeBack(surface, target, result, selection, clipped);
+    SDL_UnlockSurface(surface);
+    return target;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "selection.h"
+
+// Медианный фильтр окна (2r+1)x(2r+1) по каналам RGBA за O(1) на пиксель
+// (Perreault–Hébert): гистограммы столбцов сдвигаются вниз на строку, гистограмма
+// окна — вправо на столбец; медиана ищется по грубой (16) и точной (256) гистограммам.
+// Полосы строк считаются на всех ядрах. radius 1..100.
+// С активным выделением результат смешивается по покрытию. Возвращает изменённый прямоугольник.
+SDL_Rect medianFilter(SDL_Surface* surface, int radius, const SelectionMask* selection = nullptr);
+
+// Быстрый билатеральный фильтр на билатеральной сетке (Paris–Durand): пиксели
+// раскладываются в ячейки sigmaSpatial x sigmaSpatial x sigmaRange по яркости,
+// сетка размывается и интерполируется обратно. Стоимость почти не зависит от sigma.
+// sigmaRange — в уровнях 0..255. Альфа сохраняется.
+SDL_Rect bilateralFilter(SDL_Surface* surface, float sigmaSpatial, float sigmaRange,
+                         const SelectionMask* selection = nullptr);
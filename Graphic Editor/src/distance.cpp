@@ -0,0 +1,74 @@
+#include "distance.h"
+#include "parallel.h"
+#include <algorithm>
+
+namespace {
+
+// Нижняя огибающая парабол: d[q] = min_p ((q - p)^2 + f[p])
+void transform1D(const float* f, int n, float* d, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -DistanceInf;
+    z[1] = DistanceInf;
+
+    // z[0] = -inf не пересекается: f конечны, поэтому k не уходит ниже нуля
+    for (int q = 1; q < n; ++q) {
+        float s = ((f[q] + float(q) * q) - (f[v[k]] + float(v[k]) * v[k])) / (2.0f * (q - v[k]));
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + float(q) * q) - (f[v[k]] + float(v[k]) * v[k])) / (2.0f * (q - v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = DistanceInf;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) ++k;
+        float dq = float(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+}
+
+void distanceTransform(std::vector<float>& grid, int w, int h) {
+    if (w <= 0 || h <= 0) return;
+
+    // 1) Столбцы: пачками по 16, чтобы чтение строк оставалось последовательным
+    constexpr int Block = 16;
+    parallelFor(0, (w + Block - 1) / Block, 1, [&](int from, int to) {
+        std::vector<float> f(static_cast<size_t>(h) * Block), d(h), z(h + 1);
+        std::vector<int> v(h);
+        for (int b = from; b < to; ++b) {
+            int x0 = b * Block;
+            int cols = std::min(Block, w - x0);
+            for (int y = 0; y < h; ++y) {
+                const float* row = grid.data() + static_cast<size_t>(y) * w + x0;
+                for (int c = 0; c < cols; ++c) f[static_cast<size_t>(c) * h + y] = row[c];
+            }
+            for (int c = 0; c < cols; ++c) {
+                float* col = f.data() + static_cast<size_t>(c) * h;
+                transform1D(col, h, d.data(), v.data(), z.data());
+                std::copy(d.begin(), d.end(), col);
+            }
+            for (int y = 0; y < h; ++y) {
+                float* row = grid.data() + static_cast<size_t>(y) * w + x0;
+                for (int c = 0; c < cols; ++c) row[c] = f[static_cast<size_t>(c) * h + y];
+            }
+        }
+    });
+
+    // 2) Строки
+    parallelFor(0, h, 32, [&](int from, int to) {
+        std::vector<float> f(w), z(w + 1);
+        std::vector<int> v(w);
+        for (int y = from; y < to; ++y) {
+            float* row = grid.data() + static_cast<size_t>(y) * w;
+            std::copy(row, row + w, f.begin());
+            transform1D(f.data(), w, row, v.data(), z.data());
+        }
+    });
+}
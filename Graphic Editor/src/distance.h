@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+
+// Точное евклидово преобразование расстояния (Felzenszwalb–Huttenlocher).
+// На входе grid[i] = 0 для пикселей-источников и DistanceInf для остальных,
+// на выходе — квадрат расстояния до ближайшего источника.
+// Линейное время: два прохода одномерного преобразования (столбцы, затем строки),
+// каждый распараллелен; стоимость не зависит от радиуса, для которого его используют.
+constexpr float DistanceInf = 1e20f;
+
+void distanceTransform(std::vector<float>& grid, int w, int h);
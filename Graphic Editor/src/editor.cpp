@@ -1,4 +1,5 @@
 #include "editor.h"
+#include "tiles.h"
 #include <iostream>
 #include <algorithm>
 #include <math.h>
@@ -8,6 +9,16 @@
 #include "stb_image_write.h"  // БЕЗ define
 #include <cstring>
 #include "tinyfiledialogs.h"
+#include "floodfill.h"
+#include "blur.h"
+#include "adjustment.h"
+#include "resize.h"
+#include "orient.h"
+#include "histogram.h"
+#include "convolve.h"
+#include "denoise.h"
+#include "preview.h"
+#include "jobs.h"
 #include <SDL3/SDL_surface.h>
 #include <cfloat>      // для FLT_MAX
 
@@ -17,14 +28,17 @@ float maxX = -FLT_MAX;
 float maxY = -FLT_MAX;
 
 
-bool point_in_rect(float x, float y, const Rect& r) {
-    return x >= r.rect.x && x <= r.rect.x + r.rect.w && y >= r.rect.y && y <= r.rect.y + r.rect.h;
-}
 bool point_in_rect(float x, float y, const SDL_FRect& r) {
     return x >= r.x && x <= r.x + r.w && y >= r.y && y <= r.y + r.h;
 }
 
 
+// Список слоёв боковой панели: строки по 40 px между кнопкой и инструментами;
+// раскладываются и проверяются на попадание только видимые строки
+constexpr float LayerListTop = 80.0f;
+constexpr float LayerListBottom = 390.0f;
+constexpr float LayerRowHeight = 40.0f;
+
 SDL_FPoint screenToWorld(float screenX, float screenY, float scale, float offsetX, float offsetY) {
     SDL_FPoint world;
     world.x = (screenX - offsetX) / scale;
@@ -39,52 +53,224 @@ SDL_FPoint worldToScreen(float worldX, float worldY, float scale, float offsetX,
     return screen;
 }
 
-bool pointInPolygon(const SDL_FPoint& pt, const std::vector<SDL_FPoint>& polygon) {
-    // Ray Casting alg
-    int count = 0;
-    int n = polygon.size();
-    for (int i = 0; i < n; ++i) {
-        SDL_FPoint a = polygon[i];
-        SDL_FPoint b = polygon[(i + 1) % n];
-
-        if ((a.y > pt.y) != (b.y > pt.y)) {
-            float intersectX = (b.x - a.x) * (pt.y - a.y) / (b.y - a.y) + a.x;
-            if (pt.x < intersectX) {
-                ++count;
-            }
+// Загружает в текстуру изменённый прямоугольник поверхности (или всю поверхность)
+void uploadSurface(SDL_Renderer* renderer, SDL_Texture*& texture, SDL_Surface* surface, const SDL_Rect* dirty) {
+    if (texture && texture->format == surface->format &&
+        texture->w == surface->w && texture->h == surface->h) {
+        const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+        if (dirty) {
+            pixels += dirty->y * surface->pitch + dirty->x * SDL_BYTESPERPIXEL(surface->format);
         }
+        SDL_UpdateTexture(texture, dirty, pixels, surface->pitch);
+        return;
+    }
+
+    if (texture) SDL_DestroyTexture(texture);
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (!texture) {
+        SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
     }
-    return (count % 2) == 1;
 }
 
+SelectionOp selectionOpFromMods(SDL_Keymod mod) {
+    bool shift = (mod & SDL_KMOD_SHIFT);
+    bool alt = (mod & SDL_KMOD_ALT);
+    if (shift && alt) return SelectionOp::Intersect;
+    if (shift) return SelectionOp::Add;
+    if (alt) return SelectionOp::Subtract;
+    return SelectionOp::Replace;
+}
+
+// Копия выделения для фоновой задачи: пока она идёт, выделение можно менять
+std::shared_ptr<const SelectionMask> copySelection(const SelectionMask& selection) {
+    auto mask = std::make_shared<SelectionMask>();
+    mask->reset(selection.width(), selection.height());
+    mask->combine(selection, SelectionOp::Replace);
+    return mask;
+}
 
-void drawCircle(SDL_Renderer* renderer, float centerX, float centerY, float radius) {
-    int x = radius;
-    int y = 0;
-    int err = 0;
+// Запрашивает положительное число в диалоге; false, если пользователь отменил ввод
+bool askNumber(const char* title, const char* message, float& value) {
+    char current[32];
+    SDL_snprintf(current, sizeof(current), "%g", value);
+    const char* answer = tinyfd_inputBox(title, message, current);
+    if (!answer) return false;
+
+    float parsed = static_cast<float>(SDL_atof(answer));
+    if (parsed <= 0.0f) return false;
+    value = parsed;
+    return true;
+}
 
-    while (x >= y) {
-        SDL_RenderPoint(renderer, centerX + x, centerY + y);
-        SDL_RenderPoint(renderer, centerX + y, centerY + x);
-        SDL_RenderPoint(renderer, centerX - y, centerY + x);
-        SDL_RenderPoint(renderer, centerX - x, centerY + y);
-        SDL_RenderPoint(renderer, centerX - x, centerY - y);
-        SDL_RenderPoint(renderer, centerX - y, centerY - x);
-        SDL_RenderPoint(renderer, centerX + y, centerY - x);
-        SDL_RenderPoint(renderer, centerX + x, centerY - y);
+// Запрашивает ядро свёртки: имя (sharpen, emboss, edge, box N) или n*n весов по строкам;
+// последним словом можно задать край (clamp, mirror, wrap, transparent)
+bool askKernel(Kernel& kernel, EdgeMode& edges) {
+    char current[64];
+    SDL_snprintf(current, sizeof(current), "sharpen %s", edgeModeName(edges));
+    const char* answer = tinyfd_inputBox("Свёртка",
+        "sharpen | emboss | edge | box N | веса 3x3..15x15; край: clamp, mirror, wrap, transparent", current);
+    if (!answer) return false;
+
+    std::vector<std::string> words;
+    std::string text = answer;
+    char* save = nullptr;
+    for (char* t = SDL_strtok_r(text.data(), " ,;\t", &save); t; t = SDL_strtok_r(nullptr, " ,;\t", &save)) {
+        words.push_back(t);
+    }
+    for (EdgeMode mode : { EdgeMode::Clamp, EdgeMode::Mirror, EdgeMode::Wrap, EdgeMode::Transparent }) {
+        if (!words.empty() && words.back() == edgeModeName(mode)) {
+            edges = mode;
+            words.pop_back();
+            break;
+        }
+    }
+    if (words.empty()) return false;
+
+    if (words[0] == "sharpen") {
+        kernel = Kernel::sharpen();
+    } else if (words[0] == "emboss") {
+        kernel = Kernel::emboss();
+    } else if (words[0] == "edge") {
+        kernel = Kernel::edgeDetect();
+    } else if (words[0] == "box") {
+        kernel = Kernel::box(words.size() > 1 ? SDL_atoi(words[1].c_str()) : 3);
+    } else {
+        std::vector<float> weights;
+        for (const std::string& w : words) weights.push_back(static_cast<float>(SDL_atof(w.c_str())));
+        return Kernel::fromWeights(weights, kernel);
+    }
+    return true;
+}
 
-        if (err <= 0) {
-            y += 1;
-            err += 2 * y + 1;
+// Запрашивает параметры корректирующего слоя одной строкой; false, если ввод отменён или неверен
+bool askAdjustment(AdjustmentParams& p) {
+    if (p.type == AdjustmentType::Invert) return true;   // параметров нет
+
+    char current[256];
+    const char* message = "";
+    switch (p.type) {
+        case AdjustmentType::Levels:
+            SDL_snprintf(current, sizeof(current), "%d %d %g %d %d",
+                         p.inBlack, p.inWhite, p.gamma, p.outBlack, p.outWhite);
+            message = "Вход: чёрное, белое, гамма; выход: чёрное, белое";
+            break;
+        case AdjustmentType::Curves: {
+            std::string text;
+            for (const SDL_Point& pt : p.curve) {
+                text += std::to_string(pt.x) + " " + std::to_string(pt.y) + " ";
+            }
+            SDL_strlcpy(current, text.c_str(), sizeof(current));
+            message = "Точки кривой парами: вход выход ...";
+            break;
         }
-        if (err > 0) {
-            x -= 1;
-            err -= 2 * x + 1;
+        case AdjustmentType::HueSaturation:
+            SDL_snprintf(current, sizeof(current), "%g %g %g", p.hue, p.saturation, p.lightness);
+            message = "Тон (градусы), насыщенность и яркость (-100..100)";
+            break;
+        case AdjustmentType::Blur:
+            SDL_snprintf(current, sizeof(current), "%g", p.sigma);
+            message = "Sigma (px)";
+            break;
+        case AdjustmentType::BrightnessContrast:
+            SDL_snprintf(current, sizeof(current), "%g %g", p.brightness, p.contrast);
+            message = "Яркость и контраст (-100..100)";
+            break;
+        case AdjustmentType::Posterize:
+            SDL_snprintf(current, sizeof(current), "%d", p.posterizeLevels);
+            message = "Уровней на канал (2..255)";
+            break;
+        case AdjustmentType::Threshold:
+            SDL_snprintf(current, sizeof(current), "%d", p.thresholdLevel);
+            message = "Порог (0..255)";
+            break;
+        case AdjustmentType::Invert:
+            break;
+    }
+
+    const char* answer = tinyfd_inputBox(adjustmentName(p.type), message, current);
+    if (!answer) return false;
+
+    AdjustmentParams parsed = p;
+    bool ok = false;
+    switch (p.type) {
+        case AdjustmentType::Levels:
+            ok = SDL_sscanf(answer, "%d %d %f %d %d", &parsed.inBlack, &parsed.inWhite, &parsed.gamma,
+                            &parsed.outBlack, &parsed.outWhite) == 5 && parsed.gamma > 0.0f;
+            break;
+        case AdjustmentType::Curves: {
+            parsed.curve.clear();
+            const char* cursor = answer;
+            char* end = nullptr;
+            while (true) {
+                long x = SDL_strtol(cursor, &end, 10);
+                if (end == cursor) break;
+                cursor = end;
+                long y = SDL_strtol(cursor, &end, 10);
+                if (end == cursor) break;
+                cursor = end;
+                parsed.curve.push_back({ static_cast<int>(x), static_cast<int>(y) });
+            }
+            ok = parsed.curve.size() >= 2;
+            break;
         }
+        case AdjustmentType::HueSaturation:
+            ok = SDL_sscanf(answer, "%f %f %f", &parsed.hue, &parsed.saturation, &parsed.lightness) == 3;
+            break;
+        case AdjustmentType::Blur:
+            ok = SDL_sscanf(answer, "%f", &parsed.sigma) == 1 && parsed.sigma > 0.0f;
+            break;
+        case AdjustmentType::BrightnessContrast:
+            ok = SDL_sscanf(answer, "%f %f", &parsed.brightness, &parsed.contrast) == 2;
+            break;
+        case AdjustmentType::Posterize:
+            ok = SDL_sscanf(answer, "%d", &parsed.posterizeLevels) == 1 && parsed.posterizeLevels >= 2;
+            break;
+        case AdjustmentType::Threshold:
+            ok = SDL_sscanf(answer, "%d", &parsed.thresholdLevel) == 1;
+            break;
+        case AdjustmentType::Invert:
+            break;
+    }
+    if (!ok) {
+        SDL_Log("askAdjustment: cannot parse \"%s\"", answer);
+        return false;
     }
+    p = parsed;
+    return true;
 }
 
-bool saveCanvasAsJPG(SDL_Renderer* renderer,
+// Запрашивает размер "ширина высота [фильтр]"; filter == nullptr — без фильтра
+bool askSize(const char* title, int& w, int& h, Resample* filter) {
+    char current[64];
+    if (filter) {
+        SDL_snprintf(current, sizeof(current), "%d %d %s", w, h, resampleName(*filter));
+    } else {
+        SDL_snprintf(current, sizeof(current), "%d %d", w, h);
+    }
+    const char* answer = tinyfd_inputBox(title, filter ? "Ширина, высота, фильтр (box, bilinear, bicubic, lanczos3)"
+                                                       : "Ширина, высота", current);
+    if (!answer) return false;
+
+    int newW = 0, newH = 0;
+    char name[32] = "";
+    int fields = SDL_sscanf(answer, "%d %d %31s", &newW, &newH, name);
+    if (fields < 2 || newW <= 0 || newH <= 0 || newW > 32768 || newH > 32768) {
+        SDL_Log("askSize: cannot parse \"%s\"", answer);
+        return false;
+    }
+    if (filter && fields == 3) {
+        for (Resample f : { Resample::Nearest, Resample::Box, Resample::Bilinear, Resample::Bicubic, Resample::Lanczos3 }) {
+            if (SDL_strcasecmp(name, resampleName(f)) == 0) *filter = f;
+        }
+    }
+    w = newW;
+    h = newH;
+    return true;
+}
+
+// Экспорт кадра в JPEG. Запись идёт в пуле задач, поэтому об успехе или ошибке
+// сообщает только обработчик завершения — вызывающий код результата не ждёт
+void saveCanvasAsJPG(SDL_Renderer* renderer,
                      const char* filename = "image.jpg",
                      int quality = 90)
 {
@@ -95,7 +281,7 @@ bool saveCanvasAsJPG(SDL_Renderer* renderer,
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "SDL_RenderReadPixels failed: %s",
                      SDL_GetError());
-        return false;
+        return;
     }
 
     // 2) Конвертируем поверхность в 24-битный RGB (без альфы)
@@ -108,28 +294,25 @@ bool saveCanvasAsJPG(SDL_Renderer* renderer,
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "SDL_ConvertSurfaceFormat(RGB24) failed: %s",
                      SDL_GetError());
-        return false;
+        return;
     }
 
-    // 3) Пишем JPEG с помощью stb_image_write
+    // 3) Пишем JPEG с помощью stb_image_write в пуле задач — обработка событий не ждёт
     //    пиксели идут подряд: R,G,B,R,G,B,...
-    if (!stbi_write_jpg(
-            filename,
-            rgbSurf->w,
-            rgbSurf->h,
-            3,
-            rgbSurf->pixels,
-            quality))
-    {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "stbi_write_jpg failed");
+    std::string path = filename;
+    auto written = std::make_shared<bool>(false);
+    TaskGroupPtr group = createTaskGroup("export " + path);
+    submitTask(group, [rgbSurf, path, quality, written](TaskGroup&) {
+        *written = stbi_write_jpg(path.c_str(), rgbSurf->w, rgbSurf->h, 3, rgbSurf->pixels, quality) != 0;
+    });
+    finishTaskGroup(group, [rgbSurf, path, written](TaskGroup&) {
+        if (*written) {
+            SDL_Log("Canvas successfully saved to '%s'", path.c_str());
+        } else {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "stbi_write_jpg failed: %s", path.c_str());
+        }
         SDL_DestroySurface(rgbSurf);
-        return false;
-    }
-
-    SDL_Log("Canvas successfully saved to '%s'", filename);
-    SDL_DestroySurface(rgbSurf);
-    return true;
+    });
 }
 
 
@@ -175,9 +358,21 @@ Editor::Editor() {
         int centerY = (windowHeight - canvasHeight) / 2;
         canvasRect = {centerX, centerY, canvasWidth, canvasHeight};
     }
+
+    selection.reset(canvasWidth, canvasHeight);
 }
 
 Editor::~Editor() {
+    transformSession.release();
+    filterPreview.cancel();
+    strokeOverlay.release();
+    sidebarPanel.release();
+    histogramPanel.release();
+    shutdownJobs();
+    undoManager.clear();   // история может держать убранные слои
+    // Слои освобождают свои текстуры и объекты пула, пока рендерер ещё жив
+    layers.clear();
+    drawables.reportLeaks("shutdown");
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -191,11 +386,57 @@ void Editor::run() {
             handle_event(e);
         }
         render();
+        autosave();
         SDL_Delay(16);
     }
 }
 
 void Editor::handle_event(SDL_Event& e) {
+    // Завершение фоновой операции — её продолжение выполняется здесь, в потоке UI
+    if (dispatchJobEvent(e)) return;
+
+    // Содержимое целевых текстур потеряно — панели нужно перерисовать.
+    // При сбросе устройства пропадают и сами текстуры, их создаём заново.
+    if (e.type == SDL_EVENT_RENDER_TARGETS_RESET || e.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+        if (e.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+            sidebarPanel.release();
+            histogramPanel.release();
+        }
+        sidebarPanel.invalidate();
+        histogramPanel.invalidate();
+        return;
+    }
+
+    // Живой просмотр фильтра: Enter — применить, Esc — отменить, [ и ] — параметр.
+    // Остальные клавиши сначала применяют фильтр и работают как обычно.
+    if (e.type == SDL_EVENT_KEY_DOWN && filterPreview.active()) {
+        if (!filterPreview.committing() &&
+            (e.key.scancode == SDL_SCANCODE_RETURN || e.key.scancode == SDL_SCANCODE_ESCAPE)) {
+            endFilterPreview(e.key.scancode == SDL_SCANCODE_RETURN, true);
+            return;
+        }
+        if (!filterPreview.committing() &&
+            (e.key.scancode == SDL_SCANCODE_LEFTBRACKET || e.key.scancode == SDL_SCANCODE_RIGHTBRACKET)) {
+            adjustFilterPreview(e.key.scancode == SDL_SCANCODE_RIGHTBRACKET ? 1 : -1);
+            return;
+        }
+        endFilterPreview(true);
+    }
+
+    // Открытая трансформация: Enter — применить, Esc — вернуть пиксели на место.
+    // Остальные клавиши, кроме выбора фильтра, сначала применяют её.
+    if (e.type == SDL_EVENT_KEY_DOWN && transformSession.active && !transformSession.dragging) {
+        if (e.key.scancode == SDL_SCANCODE_RETURN) {
+            commitTransform();
+            return;
+        }
+        if (e.key.scancode == SDL_SCANCODE_ESCAPE) {
+            cancelTransform();
+            return;
+        }
+        if (e.key.scancode != SDL_SCANCODE_F) commitTransform();
+    }
+
     // Обработка событий клавиш
     if (e.type == SDL_EVENT_KEY_DOWN) {
         if (e.key.scancode == SDL_SCANCODE_ESCAPE) {
@@ -234,18 +475,168 @@ void Editor::handle_event(SDL_Event& e) {
             printf("Active layer: %d (%s)\n", active_layer, layers[active_layer].name.c_str());
         } else if (e.key.scancode == SDL_SCANCODE_DELETE) {
             if (active_layer != 0 && active_layer < layers.size()) {
-                layers.erase(layers.begin() + active_layer);
+                layers.erase(active_layer);
                 active_layer = 0;
             }
         } else if (e.key.scancode == SDL_SCANCODE_UP) {
             if (active_layer > 0) {
-                std::swap(layers[active_layer], layers[active_layer - 1]);
+                layers.swap(active_layer, active_layer - 1);
                 active_layer--;
+                Action action{ ActionType::MoveLayerUp, layers.idAt(active_layer) };
+                undoManager.add_action(action);
             }
         } else if (e.key.scancode == SDL_SCANCODE_DOWN) {
             if (active_layer < layers.size() - 1) {
-                std::swap(layers[active_layer], layers[active_layer + 1]);
+                layers.swap(active_layer, active_layer + 1);
                 active_layer++;
+                Action action{ ActionType::MoveLayerDown, layers.idAt(active_layer) };
+                undoManager.add_action(action);
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) &&
+                   (e.key.scancode == SDL_SCANCODE_D || e.key.scancode == SDL_SCANCODE_EQUALS ||
+                    e.key.scancode == SDL_SCANCODE_MINUS)) {
+            if (selection.active() && askNumber("Выделение", "Радиус (px):", selectionRadius)) {
+                if (e.key.scancode == SDL_SCANCODE_D) {
+                    selection.feather(selectionRadius);
+                } else if (e.key.scancode == SDL_SCANCODE_EQUALS) {
+                    selection.grow(selectionRadius);
+                } else {
+                    selection.shrink(selectionRadius);
+                }
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_SHIFT) &&
+                   (e.key.scancode == SDL_SCANCODE_B || e.key.scancode == SDL_SCANCODE_U)) {
+            SDL_Surface* surface = layers[active_layer].surface;
+            if (surface && !layers[active_layer].adjustment && askNumber("Фильтр", "Sigma (px):", blurSigma)) {
+                PreviewFilter filter;
+                filter.value = blurSigma;
+                filter.minValue = 0.3f;
+                filter.maxValue = 250.0f;
+                filter.padding = [](float sigma) { return static_cast<int>(ceilf(3.0f * sigma)); };
+                if (e.key.scancode == SDL_SCANCODE_B) {
+                    filter.name = "blur";
+                    filter.apply = [](SDL_Surface* s, float sigma, float k) { blurSurface(s, std::max(0.3f, sigma * k)); };
+                } else {
+                    filter.name = "unsharp mask";
+                    filter.apply = [](SDL_Surface* s, float sigma, float k) { unsharpMask(s, std::max(0.3f, sigma * k), 1.0f, 2); };
+                }
+                beginFilterPreview(filter);
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) &&
+                   (e.key.scancode == SDL_SCANCODE_M || e.key.scancode == SDL_SCANCODE_N)) {
+            SDL_Surface* surface = layers[active_layer].surface;
+            if (surface && !layers[active_layer].adjustment) {
+                PreviewFilter filter;
+                if (e.key.scancode == SDL_SCANCODE_M) {
+                    if (askNumber("Медиана", "Радиус (px):", medianRadius)) {
+                        filter.name = "median";
+                        filter.value = medianRadius;
+                        filter.minValue = 1.0f;
+                        filter.step = 1.0f;
+                        filter.apply = [](SDL_Surface* s, float radius, float k) {
+                            medianFilter(s, std::max(1, static_cast<int>(radius * k + 0.5f)));
+                        };
+                        filter.padding = [](float radius) { return static_cast<int>(radius + 0.5f); };
+                    }
+                } else if (askNumber("Билатеральный фильтр", "Sigma по пространству (px):", bilateralSpatial) &&
+                           askNumber("Билатеральный фильтр", "Sigma по яркости (0..255):", bilateralRange)) {
+                    // клавишами [ ] меняется sigma по яркости
+                    const float spatial = bilateralSpatial;
+                    filter.name = "bilateral";
+                    filter.value = bilateralRange;
+                    filter.minValue = 1.0f;
+                    filter.maxValue = 255.0f;
+                    filter.apply = [spatial](SDL_Surface* s, float range, float k) {
+                        bilateralFilter(s, std::max(1.0f, spatial * k), range);
+                    };
+                    filter.padding = [spatial](float) { return static_cast<int>(ceilf(2.0f * spatial)); };
+                }
+                if (filter.apply) beginFilterPreview(filter);
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && e.key.scancode == SDL_SCANCODE_K) {
+            Kernel kernel;
+            if (layers[active_layer].surface && !layers[active_layer].adjustment && !layerJobRunning() &&
+                askKernel(kernel, convolveEdges)) {
+                std::shared_ptr<const SelectionMask> mask = copySelection(selection);
+                const EdgeMode edges = convolveEdges;
+                filterLayerAsync("convolve", [kernel, edges, mask](SDL_Surface* surface) {
+                    return convolveSurface(surface, kernel, edges, mask.get());
+                });
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_SHIFT) && e.key.scancode == SDL_SCANCODE_L) {
+            autoLevels();
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && e.key.scancode == SDL_SCANCODE_L) {
+            addAdjustmentLayer(AdjustmentType::Levels);
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && e.key.scancode == SDL_SCANCODE_M) {
+            addAdjustmentLayer(AdjustmentType::Curves);
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && e.key.scancode == SDL_SCANCODE_U) {
+            addAdjustmentLayer(AdjustmentType::HueSaturation);
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) && e.key.scancode == SDL_SCANCODE_B) {
+            addAdjustmentLayer(AdjustmentType::Blur);
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) &&
+                   (e.key.scancode == SDL_SCANCODE_C || e.key.scancode == SDL_SCANCODE_I ||
+                    e.key.scancode == SDL_SCANCODE_P || e.key.scancode == SDL_SCANCODE_T)) {
+            addAdjustmentLayer(e.key.scancode == SDL_SCANCODE_C ? AdjustmentType::BrightnessContrast
+                             : e.key.scancode == SDL_SCANCODE_I ? AdjustmentType::Invert
+                             : e.key.scancode == SDL_SCANCODE_P ? AdjustmentType::Posterize
+                                                                : AdjustmentType::Threshold);
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && e.key.scancode == SDL_SCANCODE_E && layers[active_layer].adjustment) {
+            mergeAdjustmentDown();
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) && e.key.scancode == SDL_SCANCODE_R) {
+            int w = canvasWidth, h = canvasHeight;
+            if (askSize("Размер изображения", w, h, &resizeFilter)) {
+                resizeImage(w, h, resizeFilter);
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_ALT) && e.key.scancode == SDL_SCANCODE_S) {
+            int w = canvasWidth, h = canvasHeight;
+            if (askSize("Размер холста", w, h, nullptr)) {
+                resizeCanvasTo(w, h);
+            }
+        } else if ((e.key.mod & SDL_KMOD_CTRL) &&
+                   (e.key.scancode == SDL_SCANCODE_9 || e.key.scancode == SDL_SCANCODE_8 ||
+                    e.key.scancode == SDL_SCANCODE_0 || e.key.scancode == SDL_SCANCODE_H)) {
+            // Ctrl — весь документ, Ctrl + Alt — только активный слой
+            Orientation o = e.key.scancode == SDL_SCANCODE_9 ? Orientation::Rotate90
+                          : e.key.scancode == SDL_SCANCODE_8 ? Orientation::Rotate180
+                          : e.key.scancode == SDL_SCANCODE_0 ? Orientation::Rotate270
+                          : (e.key.mod & SDL_KMOD_SHIFT)     ? Orientation::FlipVertical
+                                                             : Orientation::FlipHorizontal;
+            if (e.key.mod & SDL_KMOD_ALT) {
+                orientLayer(active_layer, o);
+            } else {
+                orientDocument(o);
+            }
+        } else if (e.key.scancode == SDL_SCANCODE_RETURN && layers[active_layer].adjustment) {
+            // Повторное редактирование корректирующего слоя — кэш сбросится по ревизии
+            AdjustmentParams params = layers[active_layer].adjustment->params();
+            if (askAdjustment(params)) {
+                layers[active_layer].adjustment->setParams(params);
+            }
+        } else if (e.key.scancode == SDL_SCANCODE_F9 && (e.key.mod & SDL_KMOD_SHIFT)) {
+            histogramComposite = !histogramComposite;
+            showHistogram = true;
+        } else if (e.key.scancode == SDL_SCANCODE_F9) {
+            showHistogram = !showHistogram;
+        } else if (e.key.scancode == SDL_SCANCODE_A && (e.key.mod & SDL_KMOD_CTRL)) {
+            selection.selectAll();
+        } else if (e.key.scancode == SDL_SCANCODE_D && (e.key.mod & SDL_KMOD_CTRL)) {
+            selection.clear();
+        } else if (e.key.scancode == SDL_SCANCODE_I && (e.key.mod & SDL_KMOD_CTRL) && (e.key.mod & SDL_KMOD_SHIFT)) {
+            selection.invert();
+        } else if (e.key.scancode == SDL_SCANCODE_I && (e.key.mod & SDL_KMOD_CTRL)) {
+            SDL_Surface* surface = layers[active_layer].writableSurface();
+            if (surface && !layers[active_layer].adjustment) {
+                SDL_Rect changed = applyLut(surface, ColorLut::invert(), &selection);
+                if (!SDL_RectEmpty(&changed)) {
+                    refreshLayerTexture(active_layer, &changed);
+                }
+            }
+        } else if (e.key.scancode == SDL_SCANCODE_J && (e.key.mod & SDL_KMOD_CTRL)) {
+            // Без выделения — копия всего слоя
+            if (selection.active()) {
+                createLayerFromSelection();
+            } else {
+                duplicateLayer();
             }
         } else if (e.key.scancode == SDL_SCANCODE_Z && (e.key.mod & SDL_KMOD_CTRL)) {
             undoManager.undo(*this, layers, active_layer);
@@ -259,6 +650,15 @@ void Editor::handle_event(SDL_Event& e) {
             toggle_tool(Tool::Erase);
         } else if (e.key.scancode == SDL_SCANCODE_B) {
             toggle_tool(Tool::Brush);
+        } else if (e.key.scancode == SDL_SCANCODE_G) {
+            toggle_tool(Tool::Fill);
+        } else if (e.key.scancode == SDL_SCANCODE_W) {
+            toggle_tool(Tool::Wand);
+        } else if (e.key.scancode == SDL_SCANCODE_T) {
+            toggle_tool(Tool::Transform);
+        } else if (e.key.scancode == SDL_SCANCODE_F && current_tool == Tool::Transform) {
+            transformFilter = static_cast<Resample>((static_cast<int>(transformFilter) + 1) % 4);
+            printf("Transform filter: %s\n", resampleName(transformFilter));
         } else if (e.key.scancode == SDL_SCANCODE_P) {
             printf("Pen tool selected!\n");
             toggle_tool(Tool::Pen);
@@ -272,7 +672,14 @@ void Editor::handle_event(SDL_Event& e) {
         const Uint16 mod = SDL_GetModState();
         const bool ctrlHeld = (mod & SDL_KMOD_CTRL);
     
-        if (ctrlHeld) {
+        if (e.wheel.mouse_x < 100.0f && e.wheel.mouse_y >= LayerListTop && e.wheel.mouse_y < LayerListBottom) {
+            // Над списком слоёв колесо прокручивает список
+            layerScroll -= e.wheel.y * LayerRowHeight;
+            clampLayerScroll();
+        } else if (ctrlHeld && (current_tool == Tool::Fill || current_tool == Tool::Wand)) {
+            fillTolerance = std::clamp(fillTolerance + static_cast<int>(e.wheel.y) * 4, 0, 255);
+            printf("Tolerance: %d\n", fillTolerance);
+        } else if (ctrlHeld) {
             brushSize += e.wheel.y;  // e.wheel.y > 0 вверх, < 0 вниз
             if (brushSize < 1.0f) brushSize = 1.0f;
             if (brushSize > 50.0f) brushSize = 50.0f;
@@ -324,20 +731,20 @@ void Editor::handle_event(SDL_Event& e) {
         if (e.type == SDL_EVENT_MOUSE_BUTTON_DOWN && e.button.button == SDL_BUTTON_LEFT) {
             SDL_FPoint pt = {(float)e.button.x, (float)e.button.y};
             penTool.addPoint(pt);
-        }
-    
-        if (penTool.isClosed &&
-            e.type == SDL_EVENT_KEY_DOWN &&
-            e.key.scancode == SDL_SCANCODE_J &&
-            (e.key.mod & SDL_KMOD_CTRL)) {
-            SDL_Log("Pen tool is closed.");
-            createLayerFromSelection(penTool.points);
-            penTool.reset();
+
+            // Замкнутый контур сразу становится выделением (Shift — добавить, Alt — вычесть)
+            if (penTool.isClosed) {
+                SDL_Log("Pen tool is closed.");
+                commitPenSelection(selectionOpFromMods(SDL_GetModState()));
+                penTool.reset();
+            }
         }
     }
 }
 
 void Editor::handle_mouse_button_down(SDL_MouseButtonEvent& button_event) {
+    endFilterPreview(true);
+
     float mx = static_cast<float>(button_event.x);
     float my = static_cast<float>(button_event.y);
 
@@ -349,25 +756,33 @@ void Editor::handle_mouse_button_down(SDL_MouseButtonEvent& button_event) {
     bool in_sidebar = (mx >= sidebar_rect.x && mx <= sidebar_rect.x + sidebar_rect.w &&
                        my >= sidebar_rect.y && my <= sidebar_rect.y + sidebar_rect.h);
 
+    // Щелчок другим инструментом, по панели или на другом слое применяет трансформацию
+    if (transformSession.active &&
+        (current_tool != Tool::Transform || in_sidebar || layers.idAt(active_layer) != transformSession.layer)) {
+        commitTransform();
+    }
+
     if (button_event.button == SDL_BUTTON_LEFT) {
         if (in_button1) {
             button1_pressed = !button1_pressed;
             return;
         }
 
-        // Обработка переключения видимости слоёв и выбора слоя
-        for (int i = 0; i < static_cast<int>(layers.size()); ++i) {
-            SDL_FRect layer_button = { 10.0f, 80.0f + i * 40.0f, 80.0f, 30.0f };
-            SDL_FRect eye_icon = { layer_button.x + 60.0f, layer_button.y + 5.0f, 15.0f, 15.0f };
-
-            if (mx >= eye_icon.x && mx <= eye_icon.x + eye_icon.w &&
-                my >= eye_icon.y && my <= eye_icon.y + eye_icon.h) {
-                layers[i].visible = !layers[i].visible;
-                return;
-            } else if (mx >= layer_button.x && mx <= layer_button.x + layer_button.w &&
-                       my >= layer_button.y && my <= layer_button.y + layer_button.h) {
-                active_layer = i;
-                return;
+        // Обработка переключения видимости слоёв и выбора слоя: строка под курсором
+        // находится по прокрутке, остальные не проверяются
+        if (my >= LayerListTop && my < LayerListBottom) {
+            int i = static_cast<int>((my - LayerListTop + layerScroll) / LayerRowHeight);
+            if (i >= 0 && i < static_cast<int>(layers.size())) {
+                SDL_FRect layer_button = { 10.0f, LayerListTop + i * LayerRowHeight - layerScroll, 80.0f, 30.0f };
+                SDL_FRect eye_icon = { layer_button.x + 60.0f, layer_button.y + 5.0f, 15.0f, 15.0f };
+
+                if (point_in_rect(mx, my, eye_icon)) {
+                    layers[i].visible = !layers[i].visible;
+                    return;
+                } else if (point_in_rect(mx, my, layer_button)) {
+                    active_layer = i;
+                    return;
+                }
             }
         }
 
@@ -401,47 +816,87 @@ void Editor::handle_mouse_button_down(SDL_MouseButtonEvent& button_event) {
             float world_mx = (mx - offsetX) / scale;
             float world_my = (my - offsetY) / scale;
         
-            for (auto& rect : layers[active_layer].rects) {
-                if (point_in_rect(world_mx, world_my, rect)) {
-                    selected_rect = &rect;
-                    drag_offset_x = world_mx - rect.rect.x;
-                    drag_offset_y = world_my - rect.rect.y;
-                    dragging = true;
-                    printf("dragging is true\n");
-                    break;
-                }
+            ObjectHandle hit = layers[active_layer].shapes().hitTest(world_mx, world_my, ObjectType::Rect);
+            if (hit.valid()) {
+                SDL_FRect r = layers[active_layer].shapes().rect(hit);
+                selected_object = hit;
+                selected_layer = layers.idAt(active_layer);
+                drag_offset_x = world_mx - r.x;
+                drag_offset_y = world_my - r.y;
+                dragging = true;
+                printf("dragging is true\n");
             }
         }
         
 
         if (current_tool == Tool::Select) {
-            selected_rect = nullptr;
-            for (auto& rect : layers[active_layer].rects) {
-                if (point_in_rect(mx, my, rect)) {
-                    selected_rect = &rect;
-                }
+            SDL_FPoint world = screenToWorld(mx, my, scale, offsetX, offsetY);
+            selected_object = layers[active_layer].shapes().hitTest(world.x, world.y, ObjectType::Rect);
+            selected_layer = layers.idAt(active_layer);
+
+            // Прямоугольное выделение — только по пустому месту и когда
+            // не включено рисование прямоугольников
+            if (!selected_object.valid() && !button1_pressed) {
+                isMarquee = true;
+                marqueeStart = {mx, my};
+                marqueeRect = {mx, my, 0, 0};
             }
         }
 
         if (current_tool == Tool::Erase) {
-            auto& rects = layers[active_layer].rects;
-            rects.erase(std::remove_if(rects.begin(), rects.end(),
-                [mx, my](const Rect& r) {
-                    return point_in_rect(mx, my, r);
-                }), rects.end());
+            SDL_FPoint world = screenToWorld(mx, my, scale, offsetX, offsetY);
+            layers[active_layer].editShapes().removeAt(world.x, world.y, ObjectType::Rect);
+        }
+
+        if (current_tool == Tool::Fill || current_tool == Tool::Wand) {
+            SDL_FPoint world = screenToWorld(mx, my, scale, offsetX, offsetY);
+            int px = static_cast<int>(floorf(world.x));
+            int py = static_cast<int>(floorf(world.y));
+            SDL_Surface* surface = layers[active_layer].surface;
+
+            if (current_tool == Tool::Fill) {
+                // пиксели корректирующего слоя вычисляются, рисовать по ним нельзя
+                if (!layers[active_layer].adjustment) surface = layers[active_layer].writableSurface();
+                SDL_Rect changed = layers[active_layer].adjustment || !surface ? SDL_Rect{0, 0, 0, 0}
+                                 : floodFill(surface, px, py, fillTolerance, fillColor, &selection);
+                if (!SDL_RectEmpty(&changed)) {
+                    refreshLayerTexture(active_layer, &changed);
+                }
+            } else {
+                CoverageMask region = floodRegion(surface, px, py, fillTolerance);
+                if (!region.empty()) {
+                    selection.combine(region, selectionOpFromMods(SDL_GetModState()));
+                }
+            }
         }
 
-        if (current_tool == Tool::Brush) {
+        if (current_tool == Tool::Transform) {
+            const Uint16 mod = SDL_GetModState();
+            bool shift = (mod & SDL_KMOD_SHIFT), alt = (mod & SDL_KMOD_ALT);
+            TransformMode mode = shift && alt ? TransformMode::Skew
+                               : shift        ? TransformMode::Scale
+                               : alt          ? TransformMode::Rotate
+                                              : TransformMode::Move;
+            SDL_FPoint world = screenToWorld(mx, my, scale, offsetX, offsetY);
+            if (transformSession.active) {
+                continueTransform(world, mode);
+            } else {
+                beginTransform(world, mode);
+            }
+        }
+
+        if (current_tool == Tool::Brush && layers[active_layer].adjustment) {
+            // пиксели корректирующего слоя вычисляются: штрих по ним не сохранится
+            SDL_Log("Brush: cannot paint on an adjustment layer");
+        } else if (current_tool == Tool::Brush && !layers[active_layer].surface) {
+            SDL_Log("Brush: the layer has no pixels to paint on");
+        } else if (current_tool == Tool::Brush) {
             isBrushing = true;
-            //brushStrokes.clear();
         
-            float mouseX, mouseY;
-            SDL_GetMouseState(&mouseX, &mouseY);
-            SDL_FPoint worldMouse = screenToWorld(mouseX, mouseY, scale, offsetX, offsetY);
+            SDL_FPoint worldMouse = screenToWorld(mx, my, scale, offsetX, offsetY);
         
-            BrushStroke stroke;
-            stroke.addCircle(worldMouse.x, worldMouse.y, 4.0f);
-            brushStrokes.push_back(stroke);
+            strokeOverlay.begin(renderer, canvasWidth, canvasHeight, SDL_Color{160, 160, 160, 255});
+            strokeSampler.begin(worldMouse.x, worldMouse.y, brushSize, button_event.timestamp);
         }
 
         // Начало выделения прямоугольной области
@@ -459,56 +914,46 @@ void Editor::handle_mouse_button_down(SDL_MouseButtonEvent& button_event) {
 void Editor::handle_mouse_motion(SDL_MouseMotionEvent& motion_event) {
     float mx = static_cast<float>(motion_event.x);
     float my = static_cast<float>(motion_event.y);
-    if (dragging && current_tool == Tool::Move && selected_rect) {
+    Layer* selectedLayer = layers.find(selected_layer);
+    if (dragging && current_tool == Tool::Move && selectedLayer) {
         // Опять преобразуем мышь в мировые координаты
         float world_mx = (mx - offsetX) / scale;
         float world_my = (my - offsetY) / scale;
     
-        selected_rect->rect.x = world_mx - drag_offset_x;
-        selected_rect->rect.y = world_my - drag_offset_y;
+        ObjectStore& shapes = selectedLayer->editShapes();
+        SDL_FRect r = shapes.rect(selected_object);
+        r.x = static_cast<float>(static_cast<int>(world_mx - drag_offset_x));
+        r.y = static_cast<float>(static_cast<int>(world_my - drag_offset_y));
+        shapes.setRect(selected_object, r);
     }
     
+    if (transformSession.dragging) {
+        updateTransform(screenToWorld(mx, my, scale, offsetX, offsetY));
+    }
+
     SDL_FRect button1 = { 10.0f, 20.0f, 80.0f, 40.0f };
     hovering_button1 = (mx >= button1.x && mx <= button1.x + button1.w &&
                         my >= button1.y && my <= button1.y + button1.h);
 
                         
     if (isBrushing && current_tool == Tool::Brush) {
-        float mouseX, mouseY;
-        SDL_GetMouseState(&mouseX, &mouseY);
-        
-        // Преобразуем экранные координаты в мировые
-        SDL_FPoint worldMouse = screenToWorld(mouseX, mouseY, scale, offsetX, offsetY);
-        BrushStroke& stroke = brushStrokes.back();
-        
-        if (lastBrushX >= 0 && lastBrushY >= 0) {
-            float dx = worldMouse.x - lastBrushX;
-            float dy = worldMouse.y - lastBrushY;
-            float dist = std::hypot(dx, dy);
-            int steps = static_cast<int>(dist / 1.5f);
-        
-            // Расчет промежуточных точек
-            for (int i = 0; i <= steps; ++i) {
-                float t = i / static_cast<float>(steps);
-                float ix = lastBrushX + t * dx;
-                float iy = lastBrushY + t * dy;
-            
-                // Преобразуем мировые координаты обратно в экранные, чтобы рисовать
-                SDL_FPoint screenPos = worldToScreen(ix, iy, scale, offsetX, offsetY);
-            
-                // Теперь рисуем с корректным учетом масштаба и смещения
-                stroke.addCircle(screenPos.x, screenPos.y, brushSize);
-            }
-        }
-    
-        lastBrushX = worldMouse.x;
-        lastBrushY = worldMouse.y;
+        // Каждое событие движения — со своими координатами и временем — уходит
+        // в поток штриха; интерполяция и отпечатки считаются там
+        SDL_FPoint worldMouse = screenToWorld(mx, my, scale, offsetX, offsetY);
+        strokeSampler.addPoint(worldMouse.x, worldMouse.y, motion_event.timestamp);
     }
 
 
 
 
 
+    if (isMarquee) {
+        marqueeRect.x = fminf(marqueeStart.x, mx);
+        marqueeRect.y = fminf(marqueeStart.y, my);
+        marqueeRect.w = fabsf(mx - marqueeStart.x);
+        marqueeRect.h = fabsf(my - marqueeStart.y);
+    }
+
     if (button1_pressed) {
         if (isDragging) {
             float x1 = dragRect.x;
@@ -525,47 +970,59 @@ void Editor::handle_mouse_motion(SDL_MouseMotionEvent& motion_event) {
 }
 
 void Editor::handle_mouse_button_up(SDL_MouseButtonEvent& button_event) {
-    lastBrushX = lastBrushY = -1;
     if (dragging) {
         dragging = false;
     }
 
-    if (current_tool == Tool::Brush && button_event.button == SDL_BUTTON_LEFT && isBrushing) {
-        isBrushing = false;
-        
-        if (!brushStrokes.empty()) {
-            BrushStroke& stroke = brushStrokes.back();
-            int c = 0;
-            for (const auto& circle : stroke.circles) {
-                c += 1;
-                if (c == 1) continue;
-                SDL_FPoint worldPos = screenToWorld(circle.x, circle.y, scale, offsetX, offsetY);
-    
-                SDL_Rect r = {
-                    static_cast<int>(worldPos.x - circle.radius),
-                    static_cast<int>(worldPos.y - circle.radius),
-                    static_cast<int>(2 * circle.radius),
-                    static_cast<int>(2 * circle.radius)
-                };
-    
-                Rect new_rect(r, SDL_Color{160, 160, 160, 255});
-                stroke.rects.push_back(new_rect);
+    // Трансформация остаётся открытой до Enter — следующее перетаскивание
+    // продолжает её без повторной передискретизации
+    if (transformSession.dragging && button_event.button == SDL_BUTTON_LEFT) {
+        transformSession.dragging = false;
+    }
 
-            }
+    if (isMarquee && button_event.button == SDL_BUTTON_LEFT) {
+        isMarquee = false;
+        if (marqueeRect.w >= 2 && marqueeRect.h >= 2) {
+            SDL_FPoint a = screenToWorld(marqueeRect.x, marqueeRect.y, scale, offsetX, offsetY);
+            SDL_FPoint b = screenToWorld(marqueeRect.x + marqueeRect.w, marqueeRect.y + marqueeRect.h,
+                                         scale, offsetX, offsetY);
+            SDL_Rect r = {
+                static_cast<int>(floorf(a.x)),
+                static_cast<int>(floorf(a.y)),
+                static_cast<int>(ceilf(b.x) - floorf(a.x)),
+                static_cast<int>(ceilf(b.y) - floorf(a.y))
+            };
+            selection.combineRect(r, selectionOpFromMods(SDL_GetModState()));
+        }
+        marqueeRect = {0, 0, 0, 0};
+    }
 
-            undoManager.add_action(Action{
-                ActionType::DrawBrushStroke,
-                active_layer,                  
-                Rect{SDL_Rect{10, 10, 10, 10}, SDL_Color{160, 160, 160, 255}},                        
-                layers[active_layer].visible,
-                active_layer,                  
-                stroke                         
-            });
-            stroke.circles.clear();
-            layers[active_layer].strokes.push_back(stroke);
-            lastBrushX = -1;
-            lastBrushY = -1;
+    if (button_event.button == SDL_BUTTON_LEFT && isBrushing) {   // штрих завершается, даже если инструмент сменили
+        isBrushing = false;
+        std::vector<BrushDab> dabs;
+        strokeSampler.end(button_event.timestamp, dabs);
+        appendBrushDabs(dabs);
+        
+        // Пиксели штриха из оверлея переходят в слой; для отмены — прямоугольник до и после
+        Layer& layer = layers[active_layer];
+        SDL_Surface* surface = layer.adjustment ? nullptr : layer.surface.get();
+        SDL_Rect area = strokeOverlay.bounds();
+        const SDL_Rect clip = surface ? SDL_Rect{ 0, 0, surface->w, surface->h } : SDL_Rect{ 0, 0, 0, 0 };
+        if (surface && SDL_GetRectIntersection(&area, &clip, &area)) {
+            surface = layer.writableSurface();
+            auto patch = std::make_shared<PixelPatch>();
+            patch->area = area;
+            patch->generation = layer.surfaceGeneration;
+            patch->before = PixelPatch::read(surface, area);
+            strokeOverlay.composite(surface);
+            patch->after = PixelPatch::read(surface, area);
+            refreshLayerTexture(active_layer, &area);
+
+            Action action{ ActionType::DrawBrushStroke, layers.idAt(active_layer) };
+            action.patch = patch;
+            undoManager.add_action(action);
         }
+        strokeOverlay.end();
     }
     
 
@@ -598,8 +1055,9 @@ void Editor::handle_mouse_button_up(SDL_MouseButtonEvent& button_event) {
                 Rect new_rect(r, SDL_Color({160, 160, 160, 255}));
     
                 if (!layers.empty() && active_layer >= 0 && active_layer < static_cast<int>(layers.size())) {
-                    layers[active_layer].rects.push_back(new_rect);
-                    undoManager.add_action(Action{ ActionType::AddRect, active_layer, new_rect });
+                    Action action{ ActionType::AddRect, layers.idAt(active_layer), new_rect };
+                    action.object = layers[active_layer].addRect(new_rect);
+                    undoManager.add_action(action);
                 }
             }
         }
@@ -629,18 +1087,18 @@ void Editor::render() {
     }
 
     Uint32 now_ms = SDL_GetTicks();
-    float elapsed = (now_ms - start_time) / 1000.0f;
+    if (!background_done) {
+        float elapsed = (now_ms - start_time) / 1000.0f;
 
-    float transition_duration = 2.0f;
-    float t = elapsed / transition_duration;
+        float transition_duration = 2.0f;
+        float t = elapsed / transition_duration;
 
-    if (t >= 1.0f && !background_done) {
-        background_done = true;
-        sidebar_start_time = SDL_GetTicks();
+        if (t >= 1.0f) {
+            background_done = true;
+            sidebar_start_time = SDL_GetTicks();
+        }
     }
 
-    if (t > 1.0f) t = 1.0f;
-
     //SDL_SetRenderDrawColorFloat(renderer, t, t, t, SDL_ALPHA_OPAQUE_FLOAT);
     SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
     SDL_RenderClear(renderer);
@@ -657,7 +1115,41 @@ void Editor::render() {
     float sidebar_max_width = 100.0f;
     float sidebar_current_width = 0.0f;
 
-    for (const Layer& layer : layers) {
+    // Корректирующие слои: досчитываем только видимые тайлы
+    int windowWidth, windowHeight;
+    SDL_GetWindowSize(window, &windowWidth, &windowHeight);
+    SDL_Rect visibleArea = {
+        static_cast<int>(floorf(-offsetX / scale)),
+        static_cast<int>(floorf(-offsetY / scale)),
+        static_cast<int>(ceilf(windowWidth / scale)) + 1,
+        static_cast<int>(ceilf(windowHeight / scale)) + 1
+    };
+    updateAdjustmentLayers(visibleArea);
+    const SDL_FRect visibleWorld = {
+        static_cast<float>(visibleArea.x), static_cast<float>(visibleArea.y),
+        static_cast<float>(visibleArea.w), static_cast<float>(visibleArea.h)
+    };
+
+    // Готовые тайлы фильтра в полном разрешении заменяют прокси
+    if (filterPreview.active()) {
+        std::vector<SDL_Rect> changed;
+        filterPreview.collect(changed);
+        const int previewIndex = layers.indexOf(previewLayer);
+        for (const SDL_Rect& r : changed) refreshLayerTexture(previewIndex, &r);
+        filterPreview.updateView(renderer, visibleArea, scale);
+    }
+
+    // Под непрозрачным корректирующим слоем ничего не видно — не рисуем: пиксели и
+    // объекты нижних слоёв уже растеризованы в его композит
+    int firstDrawn = std::max(0, topAdjustmentLayer(layers));
+    // Новые отпечатки текущего штриха — в оверлей
+    if (strokeOverlay.active()) {
+        std::vector<BrushDab> dabs;
+        strokeSampler.drain(dabs);
+        appendBrushDabs(dabs);
+    }
+    for (size_t li = firstDrawn; li < layers.size(); ++li) {
+        const Layer& layer = layers[li];
         if (!layer.visible) continue;
 
         if (layer.surfFlag) {
@@ -668,44 +1160,35 @@ void Editor::render() {
             };
             SDL_RenderTexture(renderer, layer.texture, nullptr, &dstRect);
         }
+        const LayerId id = layers.idAt(static_cast<int>(li));
+        if (id == previewLayer) {
+            filterPreview.draw(renderer, scale, offsetX, offsetY);
+        }
 
-        for (const Layer& layer : layers) {
-            if (!layer.visible) continue;
-        
-            for (const Drawable* obj : layer.objects) {
-                obj->draw(renderer, scale, offsetX, offsetY);
-            }
+        // Объекты рисуются вместе со своим слоем, иначе они перекрыли бы слои выше
+        for (DrawableHandle h : layer.objects) {
+            const Drawable* obj = drawables.get(h);
+            if (!obj) continue;
+            SDL_FRect b;
+            if (obj->bounds(b) && !SDL_HasRectIntersectionFloat(&b, &visibleWorld)) continue;
+            obj->draw(renderer, scale, offsetX, offsetY);
         }
     
-        for (const Rect& r : layer.rects) {
-            r.draw(renderer, scale, offsetX, offsetY);
-            if (&r == selected_rect) {
-                SDL_FRect scaledRect = {
-                    r.rect.x * scale + offsetX,
-                    r.rect.y * scale + offsetY,
-                    r.rect.w * scale,
-                    r.rect.h * scale
-                };
-    
-                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                SDL_RenderRect(renderer, &scaledRect);  // SDL3 поддерживает SDL_FRect*
-            }
+        layer.shapes().draw(renderer, scale, offsetX, offsetY, visibleWorld);
+        if (id == selected_layer && layer.shapes().alive(selected_object)) {
+            SDL_FRect r = layer.shapes().rect(selected_object);
+            SDL_FRect scaledRect = {
+                r.x * scale + offsetX,
+                r.y * scale + offsetY,
+                r.w * scale,
+                r.h * scale
+            };
+
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+            SDL_RenderRect(renderer, &scaledRect);  // SDL3 поддерживает SDL_FRect*
         }
-        for (const auto& stroke : layer.strokes) {
-            for (const Rect& r : stroke.rects) {
-                r.draw(renderer, scale, offsetX, offsetY);
-                if (&r == selected_rect) {
-                    SDL_FRect scaledRect = {
-                        r.rect.x * scale + offsetX,
-                        r.rect.y * scale + offsetY,
-                        r.rect.w * scale,
-                        r.rect.h * scale
-                    };
-    
-                    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                    SDL_RenderRect(renderer, &scaledRect);  // SDL3 поддерживает SDL_FRect*
-                }
-            }
+        if (static_cast<int>(li) == active_layer) {
+            strokeOverlay.draw(renderer, scale, offsetX, offsetY);
         }
     }
 
@@ -724,17 +1207,30 @@ void Editor::render() {
         SDL_RenderFillRect(renderer, &preview);
     }
 
-    if (isBrushing && current_tool == Tool::Brush) {
-        SDL_SetRenderDrawColor(renderer, 160, 160, 160, 255); // красный
-    
-        for (const auto& stroke : brushStrokes) {
-            int c = 0;
-            for (const auto& circle : stroke.circles) {
-                c += 1;
-                if (c == 1) continue;
-                drawCircle(renderer, circle.x, circle.y, circle.radius);
-            }
-        }
+    // Предпросмотр трансформации (уменьшенная копия, растянутая до размера результата)
+    if (transformSession.active && transformSession.preview) {
+        const SDL_FRect& r = transformSession.previewRect;
+        SDL_FRect dst = { r.x * scale + offsetX, r.y * scale + offsetY, r.w * scale, r.h * scale };
+        SDL_RenderTexture(renderer, transformSession.preview, nullptr, &dst);
+        SDL_SetRenderDrawColor(renderer, 255, 160, 0, 255);
+        SDL_RenderRect(renderer, &dst);
+    }
+
+    // Рамка выделения
+    if (isMarquee && marqueeRect.w > 0 && marqueeRect.h > 0) {
+        SDL_SetRenderDrawColor(renderer, 0, 120, 255, 255);
+        SDL_RenderRect(renderer, &marqueeRect);
+    }
+    if (selection.active()) {
+        const SDL_Rect& b = selection.bounds();
+        SDL_FRect outline = {
+            b.x * scale + offsetX,
+            b.y * scale + offsetY,
+            b.w * scale,
+            b.h * scale
+        };
+        SDL_SetRenderDrawColor(renderer, 0, 200, 255, 255);
+        SDL_RenderRect(renderer, &outline);
     }
 
     if (current_tool == Tool::Pen && !penTool.points.empty()) {
@@ -753,67 +1249,264 @@ void Editor::render() {
 
 
     if (background_done) {
-        float sidebar_elapsed = (now_ms - sidebar_start_time) / 1000.0f;
-        float sidebar_duration = 1.0f; // 1 секунда
-        sidebar_progress = sidebar_elapsed / sidebar_duration;
-        if (sidebar_progress > 1.0f) sidebar_progress = 1.0f;
-        sidebar_current_width = sidebar_max_width * sidebar_progress;
+        if (sidebar_progress < 1.0f) {
+            float sidebar_elapsed = (now_ms - sidebar_start_time) / 1000.0f;
+            float sidebar_duration = 1.0f; // 1 секунда
+            sidebar_progress = sidebar_elapsed / sidebar_duration;
+            if (sidebar_progress > 1.0f) sidebar_progress = 1.0f;
+            sidebar_current_width = sidebar_max_width * sidebar_progress;
+
+            SDL_FRect sidebar = { 0.0f, 0.0f, sidebar_current_width, 720.0f };
+            SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+            SDL_RenderFillRect(renderer, &sidebar);
+        }
+
+        if (sidebar_progress == 1.0f) {
+            drawSidebar();
+        }
+    }
+
+    if (showHistogram) {
+        drawHistogramPanel();
+    }
+
+    // Прогресс фоновых операций — полоски в левом нижнем углу
+    float barY = windowHeight - 14.0f;
+    for (const TaskGroupPtr& group : activeTaskGroups()) {
+        if (!group->hasProgress()) continue;
+        SDL_FRect back = { 110.0f, barY, 200.0f, 6.0f };
+        SDL_FRect done = { 110.0f, barY, 200.0f * group->progress(), 6.0f };
+        SDL_SetRenderDrawColor(renderer, 60, 60, 60, 255);
+        SDL_RenderFillRect(renderer, &back);
+        SDL_SetRenderDrawColor(renderer, 90, 200, 90, 255);
+        SDL_RenderFillRect(renderer, &done);
+        barY -= 10.0f;
+    }
+
+    SDL_RenderPresent(renderer);
+}
+
+// Боковая панель после анимации: кнопка, список слоёв, инструменты. Рисуется в
+// текстуру заново, только когда меняется что-то из показанного
+void Editor::drawSidebar() {
+    // Активный слой, выбранный с клавиатуры, прокручивается в поле зрения
+    if (active_layer != shownActiveLayer) {
+        shownActiveLayer = active_layer;
+        const float rowTop = active_layer * LayerRowHeight;
+        const float listHeight = LayerListBottom - LayerListTop;
+        if (rowTop < layerScroll) layerScroll = rowTop;
+        if (rowTop + LayerRowHeight > layerScroll + listHeight) layerScroll = rowTop + LayerRowHeight - listHeight;
+    }
+    clampLayerScroll();
+    int first = 0, last = 0;
+    visibleLayerRows(first, last);
+
+    PanelState state;
+    state.add(button1_pressed).add(hovering_button1).add(active_layer).add(layers.size())
+         .add(static_cast<Uint64>(current_tool)).add(static_cast<Uint64>(layerScroll));
+    for (int i = first; i < last; ++i) {
+        Layer& layer = layers[i];
+        updateThumbnail(layer);
+        state.add(layer.visible);
+        if (layer.thumbnail) {
+            state.add(reinterpret_cast<uintptr_t>(layer.thumbnail->texture)).add(layer.thumbnail->revision);
+        }
+    }
 
-        SDL_FRect sidebar = { 0.0f, 0.0f, sidebar_current_width, 720.0f };
+    if (sidebarPanel.begin(renderer, 100, 720, state.value())) {
+        SDL_FRect sidebar = { 0.0f, 0.0f, 100.0f, 720.0f };
         SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
         SDL_RenderFillRect(renderer, &sidebar);
 
-        if (sidebar_progress == 1.0f) {
-            SDL_FRect button1 = { 10.0f, 20.0f, 80.0f, 40.0f };
-            if (button1_pressed) {
-                SDL_SetRenderDrawColor(renderer, 100, 100, 255, 255);  // нажатая
-            } else if (hovering_button1) {
-                SDL_SetRenderDrawColor(renderer, 180, 180, 255, 255);  // при наведении
+        SDL_FRect button1 = { 10.0f, 20.0f, 80.0f, 40.0f };
+        if (button1_pressed) {
+            SDL_SetRenderDrawColor(renderer, 100, 100, 255, 255);  // нажатая
+        } else if (hovering_button1) {
+            SDL_SetRenderDrawColor(renderer, 180, 180, 255, 255);  // при наведении
+        } else {
+            SDL_SetRenderDrawColor(renderer, 150, 150, 255, 255);  // обычная
+        }
+        SDL_RenderFillRect(renderer, &button1);
+
+        // Рисуем видимые строки списка слоёв
+        SDL_Rect listClip = { 0, static_cast<int>(LayerListTop), 100, static_cast<int>(LayerListBottom - LayerListTop) };
+        SDL_SetRenderClipRect(renderer, &listClip);
+        for (int i = first; i < last; ++i) {
+            SDL_FRect layer_button = { 10.0f, LayerListTop + i * LayerRowHeight - layerScroll, 80.0f, 30.0f };
+            if (i == active_layer) {
+                SDL_SetRenderDrawColor(renderer, 100, 200, 100, 255);
             } else {
-                SDL_SetRenderDrawColor(renderer, 150, 150, 255, 255);  // обычная
+                SDL_SetRenderDrawColor(renderer, 180, 180, 180, 255);
+            }
+            SDL_RenderFillRect(renderer, &layer_button);
+
+            // Миниатюра на белом фоне
+            const LayerThumbnail* thumb = layers[i].thumbnail.get();
+            if (thumb && thumb->texture) {
+                SDL_FRect back = { layer_button.x + 3.0f, layer_button.y + 3.0f, 24.0f, 24.0f };
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDL_RenderFillRect(renderer, &back);
+                SDL_FRect image = {
+                    back.x + (ThumbnailSize - thumb->w) / 2, back.y + (ThumbnailSize - thumb->h) / 2,
+                    static_cast<float>(thumb->w), static_cast<float>(thumb->h)
+                };
+                SDL_RenderTexture(renderer, thumb->texture, nullptr, &image);
             }
-            SDL_RenderFillRect(renderer, &button1);
-
-            // Рисуем список слоёв
-            int y = 80;
-            for (int i = 0; i < (int)layers.size(); ++i) {
-                SDL_FRect layer_button = { 10.0f, (float)y, 80.0f, 30.0f };
-                if (i == active_layer) {
-                    SDL_SetRenderDrawColor(renderer, 100, 200, 100, 255);
-                } else {
-                    SDL_SetRenderDrawColor(renderer, 180, 180, 180, 255);
-                }
-                SDL_RenderFillRect(renderer, &layer_button);
-
-                // Нарисовать индикатор видимости
-                if (layers[i].visible) {
-                    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // зелёный
-                } else {
-                    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // красный
-                }
-                SDL_FRect eye = { layer_button.x + 60.0f, layer_button.y + 5.0f, 15.0f, 15.0f };
-                SDL_RenderFillRect(renderer, &eye);
 
-                y += 40;
+            // Нарисовать индикатор видимости
+            if (layers[i].visible) {
+                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // зелёный
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // красный
             }
-            for (int i = 1; i < tool_count + 1; ++i) {
-                SDL_FRect button = { 10.0f, 360.0f + i * 40.0f, 80.0f, 30.0f };
-        
-                SDL_SetRenderDrawColor(renderer,
-                    (int)current_tool == i ? 180 : 100,
-                    (int)current_tool == i ? 180 : 100,
-                    (int)current_tool == i ? 180 : 100,
-                    255);
-                SDL_RenderFillRect(renderer, &button);
-        
-                // Optionally draw text labels
-                //DrawText(renderer, font, tool_names[i], button.x + 5, button.y + 5);
+            SDL_FRect eye = { layer_button.x + 60.0f, layer_button.y + 5.0f, 15.0f, 15.0f };
+            SDL_RenderFillRect(renderer, &eye);
+        }
+        SDL_SetRenderClipRect(renderer, nullptr);
+        for (int i = 1; i < tool_count + 1; ++i) {
+            SDL_FRect button = { 10.0f, 360.0f + i * 40.0f, 80.0f, 30.0f };
+
+            SDL_SetRenderDrawColor(renderer,
+                (int)current_tool == i ? 180 : 100,
+                (int)current_tool == i ? 180 : 100,
+                (int)current_tool == i ? 180 : 100,
+                255);
+            SDL_RenderFillRect(renderer, &button);
+
+            // Optionally draw text labels
+            //DrawText(renderer, font, tool_names[i], button.x + 5, button.y + 5);
+        }
+        sidebarPanel.end(renderer);
+    }
+    sidebarPanel.draw(renderer, 0.0f, 0.0f);
+}
+
+void Editor::visibleLayerRows(int& first, int& last) const {
+    const int count = static_cast<int>(layers.size());
+    first = std::min(count, static_cast<int>(layerScroll / LayerRowHeight));
+    last = std::min(count, static_cast<int>(std::ceil((layerScroll + LayerListBottom - LayerListTop) / LayerRowHeight)));
+}
+
+void Editor::clampLayerScroll() {
+    const float content = layers.size() * LayerRowHeight;
+    const float maxScroll = std::max(0.0f, content - (LayerListBottom - LayerListTop));
+    layerScroll = std::clamp(layerScroll, 0.0f, maxScroll);
+}
+
+// Миниатюра слоя: первая строится сразу, после правок — когда слой не меняется
+// ThumbnailDelay мс (не на каждый отпечаток кисти). Уменьшение идёт фоновой задачей;
+// правка слоя во время её работы даст новую ревизию и ещё один проход.
+void Editor::updateThumbnail(Layer& layer) {
+    constexpr Uint64 ThumbnailDelay = 300;
+    if (!layer.surface) return;
+    if (!layer.thumbnail) layer.thumbnail = std::make_shared<LayerThumbnail>();
+    std::shared_ptr<LayerThumbnail> thumb = layer.thumbnail;
+    if (thumb->built && thumb->revision == layer.revision) return;
+    if (thumb->job && !thumb->job->finished()) return;
+
+    const Uint64 now = SDL_GetTicks();
+    if (thumb->built) {
+        if (thumb->staleSince == 0 || thumb->seenRevision != layer.revision) {
+            thumb->seenRevision = layer.revision;
+            thumb->staleSince = now;
+        }
+        if (now - thumb->staleSince < ThumbnailDelay) return;
+    }
+    thumb->staleSince = 0;
+
+    // Отсчёты (не больше 24 * 24 * 16 пикселей) берутся здесь из surface слоя:
+    // живой surface в фоновый поток не уходит, а полный снимок ради миниатюры не нужен
+    auto samples = std::make_shared<ThumbnailSamples>(gatherThumbnailSamples(layer.surface));
+    if (samples->pixels.empty()) return;
+    auto result = std::make_shared<ThumbnailPixels>();
+    const Uint32 revision = layer.revision;
+
+    thumb->job = createTaskGroup("thumbnail", JobPriority::Background);
+    submitTask(thumb->job, [samples, result](TaskGroup&) {
+        *result = buildThumbnail(*samples);
+    });
+    finishTaskGroup(thumb->job, [this, thumb, result, revision](TaskGroup&) {
+        if (result->pixels.empty()) return;
+        if (!thumb->texture || thumb->w != result->w || thumb->h != result->h) {
+            if (thumb->texture) SDL_DestroyTexture(thumb->texture);
+            thumb->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                               result->w, result->h);
+            if (!thumb->texture) {
+                SDL_Log("updateThumbnail: SDL_CreateTexture failed: %s", SDL_GetError());
+                return;
             }
+            SDL_SetTextureBlendMode(thumb->texture, SDL_BLENDMODE_BLEND);
         }
+        SDL_UpdateTexture(thumb->texture, nullptr, result->pixels.data(), result->w * 4);
+        thumb->w = result->w;
+        thumb->h = result->h;
+        thumb->revision = revision;
+        thumb->built = true;
+    });
+}
+
+// Гистограмма активного слоя (Shift+F9 — всего видимого изображения) в правом
+// верхнем углу: яркость серым, R/G/B поверх, границы яркости — белыми линиями.
+// Для слоя между кадрами пересчитываются только изменённые тайлы; панель
+// перерисовывается, только когда источник изменился.
+void Editor::drawHistogramPanel() {
+    const Layer& layer = layers[active_layer];
+    if (!histogramComposite && (!layer.surface || layer.adjustment)) return;
+
+    int winW = 0, winH = 0;
+    SDL_GetWindowSize(window, &winW, &winH);
+    const float panelH = 100.0f;
+
+    PanelState state;
+    state.add(histogramComposite);
+    if (histogramComposite) {
+        for (const Layer& l : layers) {
+            state.add(l.visible).add(l.revision).add(reinterpret_cast<uintptr_t>(l.surface.get()))
+                 .add(l.shapes().revision()).add(l.adjustment ? l.adjustment->revision() : 0);
+        }
+    } else {
+        state.add(active_layer).add(layer.revision).add(reinterpret_cast<uintptr_t>(layer.surface.get()));
     }
+    if (!histogramPanel.begin(renderer, 256, static_cast<int>(panelH), state.value())) {
+        histogramPanel.draw(renderer, winW - 266.0f, 10.0f);
+        return;
+    }
+    Histogram composite;
+    if (histogramComposite) {
+        const SDL_Rect canvas = { 0, 0, canvasWidth, canvasHeight };
+        updateAdjustmentLayers(canvas);
+        composite = computeCompositeHistogram(layers, canvas);
+    }
+    const Histogram& hist = histogramComposite ? composite : histogramCache.update(layer);
+    SDL_FRect panel = { 0.0f, 0.0f, 256.0f, panelH };
 
+    SDL_SetRenderDrawColor(renderer, 30, 30, 30, 200);
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-    SDL_RenderPresent(renderer);
+    Uint32 peak = 1;
+    for (int c = Histogram::Red; c <= Histogram::Luma; ++c) {
+        peak = std::max(peak, hist.peak(static_cast<Histogram::Channel>(c)));
+    }
+    const SDL_Color colors[] = { {255, 60, 60, 110}, {60, 255, 60, 110}, {80, 80, 255, 110}, {200, 200, 200, 160} };
+    for (int c = Histogram::Luma; c >= Histogram::Red; --c) {
+        SDL_SetRenderDrawColor(renderer, colors[c].r, colors[c].g, colors[c].b, colors[c].a);
+        for (int i = 0; i < 256; ++i) {
+            float height = panelH * hist.bins[c][i] / float(peak);
+            if (height < 0.5f) continue;
+            float x = panel.x + i + 0.5f;
+            SDL_RenderLine(renderer, x, panel.y + panelH, x, panel.y + panelH - height);
+        }
+    }
+    if (hist.pixels) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
+        for (float x : { hist.minimum(Histogram::Luma) + 0.5f, hist.maximum(Histogram::Luma) + 0.5f }) {
+            SDL_RenderLine(renderer, panel.x + x, panel.y, panel.x + x, panel.y + panelH);
+        }
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    histogramPanel.end(renderer);
+    histogramPanel.draw(renderer, winW - 266.0f, 10.0f);
 }
 
 SDL_Surface* ConvertToBMP(int width, int height, unsigned char* data) {
@@ -858,22 +1551,29 @@ void Editor::importImage(const std::string& pathOverride) {
         path = filename;
     }
 
-    int width, height, channels;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // RGBA
-
-    if (!data) {
-        SDL_Log("stb_image load failed: %s", stbi_failure_reason());
-        return;
-    }
-
-    SDL_Surface* surface = ConvertToBMP(width, height, data);
-    stbi_image_free(data);
-
-    if (!surface) {
-        SDL_Log("Surface creation failed!");
-        return;
-    }
+    // Декодирование — в пуле задач; слой добавится по событию завершения
+    auto loaded = std::make_shared<SDL_Surface*>(nullptr);
+    TaskGroupPtr group = createTaskGroup("import " + path);
+    submitTask(group, [path, loaded](TaskGroup&) {
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4); // RGBA
+        if (!data) {
+            SDL_Log("stb_image load failed: %s", stbi_failure_reason());
+            return;
+        }
+        *loaded = ConvertToBMP(width, height, data);
+        stbi_image_free(data);
+    });
+    finishTaskGroup(group, [this, loaded](TaskGroup&) {
+        if (!*loaded) {
+            SDL_Log("Surface creation failed!");
+            return;
+        }
+        addImageLayer(*loaded);
+    });
+}
 
+void Editor::addImageLayer(SDL_Surface* surface) {
     SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
     if (!texture) {
         SDL_Log("Texture creation failed!");
@@ -901,8 +1601,8 @@ void Editor::importImage(const std::string& pathOverride) {
     //newLayer.surfFlag = true;
     //newLayer.texture = texture;
 
-    Drawable* bg = new DrawableImageBackground(texture, imgWidth, imgHeight);
-    newLayer.objects.push_back(bg);
+    newLayer.drawables = &drawables;
+    newLayer.objects.push_back(drawables.create<DrawableImageBackground>(texture, imgWidth, imgHeight));
 
     layers.push_back(std::move(newLayer));
     active_layer = layers.size() - 1;
@@ -910,12 +1610,29 @@ void Editor::importImage(const std::string& pathOverride) {
     scale = 1.0f;
     offsetX = centerX;
     offsetY = centerY;
+
+    selection.reset(canvasWidth, canvasHeight);
 }
 
 
 
-void Editor::createLayerFromSelection(const std::vector<SDL_FPoint>& polygon) {
-    if (polygon.size() < 3) return;
+void Editor::commitPenSelection(SelectionOp op) {
+    if (penTool.points.size() < 3) return;
+
+    // Контур пера задан в экранных координатах, маска — в координатах холста
+    std::vector<SDL_FPoint> polygon;
+    polygon.reserve(penTool.points.size());
+    for (const SDL_FPoint& p : penTool.points) {
+        polygon.push_back(screenToWorld(p.x, p.y, scale, offsetX, offsetY));
+    }
+    selection.combinePolygon(polygon, op);
+}
+
+void Editor::createLayerFromSelection() {
+    if (!selection.active()) {
+        SDL_Log("createLayerFromSelection: nothing selected");
+        return;
+    }
 
     SDL_Surface* src = layers[active_layer].surface;
     if (!src) {
@@ -924,35 +1641,19 @@ void Editor::createLayerFromSelection(const std::vector<SDL_FPoint>& polygon) {
         return;
     }
 
-    // 1) Рассчитываем bounding box по polygon
-    float minX =  FLT_MAX, minY =  FLT_MAX;
-    float maxX = -FLT_MAX, maxY = -FLT_MAX;
-    for (const auto& p : polygon) {
-        minX = std::min(minX, p.x);
-        minY = std::min(minY, p.y);
-        maxX = std::max(maxX, p.x);
-        maxY = std::max(maxY, p.y);
-    }
-
-    // 2) Приводим к int и обрезаем по [0..src->w], [0..src->h]
-    int x0 = static_cast<int>(std::floor(minX));
-    int y0 = static_cast<int>(std::floor(minY));
-    int x1 = static_cast<int>(std::ceil (maxX));
-    int y1 = static_cast<int>(std::ceil (maxY));
-
-    x0 = std::clamp(x0, 0, src->w);
-    y0 = std::clamp(y0, 0, src->h);
-    x1 = std::clamp(x1, 0, src->w);
-    y1 = std::clamp(y1, 0, src->h);
-
-    int w = x1 - x0;
-    int h = y1 - y0;
-    if (w <= 0 || h <= 0) {
+    // 1) Работаем только внутри bounding box выделения
+    SDL_Rect area = selection.clipRect(src->w, src->h);
+    if (SDL_RectEmpty(&area)) {
         SDL_Log("createLayerFromSelection: empty bounding box");
         return;
     }
 
-    // 3) Создаём новую поверхность ровно w×h пикселей
+    int x0 = area.x;
+    int y0 = area.y;
+    int w = area.w;
+    int h = area.h;
+
+    // 2) Создаём новую поверхность ровно w×h пикселей
     SDL_Surface* newSurf = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
     if (!newSurf) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -960,41 +1661,37 @@ void Editor::createLayerFromSelection(const std::vector<SDL_FPoint>& polygon) {
         return;
     }
 
-    // 4) Блокируем обе поверхности для прямого доступа к pixels
+    // 3) Блокируем обе поверхности для прямого доступа к pixels
     SDL_LockSurface(src);
     SDL_LockSurface(newSurf);
 
-    // 5) Рассчитываем отступы (pitch) в элементах Uint32
-    int srcPitch = src->pitch / sizeof(Uint32);
-    int dstPitch = newSurf->pitch / sizeof(Uint32);
-
-    Uint32* srcPixels = static_cast<Uint32*>(src->pixels);
-    Uint32* dstPixels = static_cast<Uint32*>(newSurf->pixels);
-
-    // 6) Копируем только те пиксели, что внутри polygon
+    // 4) Копируем пиксели, умножая альфу на покрытие (сглаженная граница)
+    std::vector<Uint8> coverage(w);
     for (int yy = 0; yy < h; ++yy) {
-        for (int xx = 0; xx < w; ++xx) {
-            int sx = x0 + xx;
-            int sy = y0 + yy;
-
-            SDL_FPoint pt = { float(sx), float(sy) };
+        selection.readRow(y0 + yy, x0, w, coverage.data());
+        const Uint8* srcRow = static_cast<const Uint8*>(src->pixels) + (y0 + yy) * src->pitch + x0 * 4;
+        Uint8* dstRow = static_cast<Uint8*>(newSurf->pixels) + yy * newSurf->pitch;
 
-            Uint32* srcRow = srcPixels + sy * srcPitch;
-            Uint32* dstRow = dstPixels + yy * dstPitch;
-
-            if (pointInPolygon(pt, polygon)) {
-                dstRow[xx] = srcRow[sx];
+        for (int xx = 0; xx < w; ++xx) {
+            Uint8 a = coverage[xx];
+            const Uint8* s = srcRow + xx * 4;
+            Uint8* d = dstRow + xx * 4;
+            if (a == 0) {
+                d[0] = d[1] = d[2] = d[3] = 0;  // полностью прозрачный
             } else {
-                dstRow[xx] = 0;  // полностью прозрачный
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+                d[3] = static_cast<Uint8>(s[3] * a / 255);
             }
         }
     }
 
-    // 7) Разблокируем
+    // 5) Разблокируем
     SDL_UnlockSurface(src);
     SDL_UnlockSurface(newSurf);
 
-    // 8) Формируем объект Layer
+    // 6) Формируем объект Layer
     Layer newLayer;
     newLayer.canvasWidth     = w;
     newLayer.canvasHeight    = h;
@@ -1010,6 +1707,753 @@ void Editor::createLayerFromSelection(const std::vector<SDL_FPoint>& polygon) {
             w, h, x0, y0);
 }
 
+// Копия активного слоя над ним. Пиксели, кэш тайлов и объекты общие с исходным
+// слоем и копируются при первой записи, поэтому копия не зависит от размера слоя
+void Editor::duplicateLayer() {
+    endFilterPreview(true);
+    commitTransform();
+
+    Layer& src = layers[active_layer];
+    Layer copy;
+    copy.name = src.name + " copy";
+    copy.shapeStore = src.shapeStore;
+    copy.canvasWidth = src.canvasWidth;
+    copy.canvasHeight = src.canvasHeight;
+    copy.visible = src.visible;
+    copy.drawables = &drawables;
+    copy.surface = src.surface;
+    copy.surfaceGeneration = src.surfaceGeneration;
+    // Параметры и отпечатки тайлов корректирующего слоя копируются: кэш общий
+    if (src.adjustment) copy.adjustment = std::make_shared<Adjustment>(*src.adjustment);
+    copy.revision = src.revision;
+    copy.tileRevisions = src.tileRevisions;
+    copy.tiles = src.tiles;
+    // Миниатюра своя: у копии будут свои ревизии
+    if (copy.surface) {
+        uploadSurface(renderer, copy.texture, copy.surface, nullptr);
+        copy.surfFlag = copy.texture != nullptr;
+    }
+
+    const int pos = active_layer + 1;
+    LayerId id = layers.insert(pos, std::move(copy));
+    active_layer = pos;
+
+    Action action{ ActionType::DuplicateLayer, id };
+    undoManager.add_action(action);
+}
+
+void Editor::refreshLayerTexture(int index, const SDL_Rect* dirty) {
+    if (index < 0 || index >= static_cast<int>(layers.size())) return;
+    Layer& layer = layers[index];
+    if (!layer.surface) return;
+    layer.markDirty(dirty);
+
+    // Слой изображения показывается через DrawableImageBackground — обновляем её текстуру
+    for (DrawableHandle h : layer.objects) {
+        auto* bg = dynamic_cast<DrawableImageBackground*>(drawables.get(h));
+        if (bg && bg->width == layer.surface->w && bg->height == layer.surface->h) {
+            uploadSurface(renderer, bg->texture, layer.surface, dirty);
+            return;
+        }
+    }
+
+    uploadSurface(renderer, layer.texture, layer.surface, dirty);
+    layer.surfFlag = true;
+}
+
+void Editor::addAdjustmentLayer(AdjustmentType type) {
+    AdjustmentParams params;
+    params.type = type;
+    if (type == AdjustmentType::Threshold && layers[active_layer].surface && !layers[active_layer].adjustment) {
+        // порог по умолчанию — по Оцу для активного слоя
+        params.thresholdLevel = histogramCache.update(layers[active_layer]).otsuThreshold(Histogram::Luma);
+    }
+    if (!askAdjustment(params)) return;
+
+    SDL_Surface* surf = SDL_CreateSurface(canvasWidth, canvasHeight, SDL_PIXELFORMAT_RGBA32);
+    if (!surf) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "addAdjustmentLayer: %s", SDL_GetError());
+        return;
+    }
+
+    Layer layer;
+    layer.name = std::string(adjustmentName(type)) + " " + std::to_string(layers.size() + 1);
+    layer.surface = surf;
+    layer.canvasWidth = canvasWidth;
+    layer.canvasHeight = canvasHeight;
+    layer.visible = true;
+    layer.adjustment = std::make_shared<Adjustment>(params);
+
+    layers.push_back(std::move(layer));
+    active_layer = layers.size() - 1;
+}
+
+// Отпечатки от потока штриха — в оверлей; в слой они попадают пикселями при отпускании кнопки
+void Editor::appendBrushDabs(std::vector<BrushDab>& dabs) {
+    strokeOverlay.addDabs(dabs);
+    dabs.clear();
+}
+
+// Раз в минуту, если документ изменился: снимки растровых слоёв (tiles.h) пишутся
+// фоновыми задачами в каталог документа (autosaveDir) как layer_<LayerId>.png;
+// слой тем временем можно менять дальше. Файлы удалённых слоёв стираются.
+void Editor::autosave() {
+    constexpr Uint64 AutosaveInterval = 60000;
+    const Uint64 now = SDL_GetTicks();
+    if (lastAutosave == 0) lastAutosave = now;
+    if (now - lastAutosave < AutosaveInterval) return;
+    if (autosaveJobs && !autosaveJobs->finished()) return;   // прошлое ещё пишется
+    lastAutosave = now;
+
+    Uint32 stamp = static_cast<Uint32>(layers.size());
+    for (const Layer& layer : layers) stamp = stamp * 31 + layer.revision;
+    if (stamp == autosaveStamp) return;
+    autosaveStamp = stamp;
+
+    if (autosaveDir.empty()) {
+        char* pref = SDL_GetPrefPath("GraphicEditor", "GraphicEditor");
+        if (!pref) {
+            SDL_Log("autosave: %s", SDL_GetError());
+            return;
+        }
+        SDL_Time now = 0;
+        SDL_GetCurrentTime(&now);
+        std::string dir = std::string(pref) + "autosave-" + std::to_string(SDL_NS_TO_SECONDS(now));
+        SDL_free(pref);
+        if (!SDL_CreateDirectory(dir.c_str())) {
+            SDL_Log("autosave: cannot create %s: %s", dir.c_str(), SDL_GetError());
+            return;
+        }
+        autosaveDir = dir + "/";
+        SDL_Log("Autosave folder: %s", autosaveDir.c_str());
+    }
+
+    autosaveJobs = createTaskGroup("autosave", JobPriority::Background);
+    std::vector<LayerId> saved;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Layer& layer = layers[i];
+        if (!layer.surface || layer.adjustment) continue;
+        // Снимок живёт только до конца записи файла; при общем слое тайлы у него
+        // общие со снимками, которые ещё держат другие задачи
+        std::shared_ptr<const TileSnapshot> pixels = snapshotLayer(layer);
+        if (!pixels) continue;
+        const LayerId id = layers.idAt(static_cast<int>(i));
+        saved.push_back(id);
+        std::string path = autosaveDir + "layer_" + std::to_string(id) + ".png";
+        autosaveJobs->addWork(1);
+        submitTask(autosaveJobs, [pixels, path](TaskGroup& group) {
+            std::vector<Uint8> flat = flattenTiles(*pixels);
+            if (!stbi_write_png(path.c_str(), pixels->w, pixels->h, 4, flat.data(), pixels->w * 4)) {
+                SDL_Log("autosave: cannot write %s", path.c_str());
+            }
+            group.advance();
+        });
+    }
+    std::vector<std::string> stale;
+    for (LayerId id : autosavedLayers) {
+        if (std::find(saved.begin(), saved.end(), id) == saved.end()) {
+            stale.push_back(autosaveDir + "layer_" + std::to_string(id) + ".png");
+        }
+    }
+    autosavedLayers = std::move(saved);
+    if (!stale.empty()) {
+        submitTask(autosaveJobs, [stale](TaskGroup&) {
+            for (const std::string& path : stale) SDL_RemovePath(path.c_str());
+        });
+    }
+    finishTaskGroup(autosaveJobs, [](TaskGroup& group) {
+        if (!group.cancelled()) SDL_Log("Autosave done");
+    });
+}
+
+void Editor::beginFilterPreview(const PreviewFilter& filter) {
+    endFilterPreview(true);
+    if (filterPreview.begin(layers[active_layer].writableSurface(), filter, &selection)) {
+        previewLayer = layers.idAt(active_layer);
+        SDL_Log("%s: %g (Enter - apply, Esc - cancel, [ ] - change)", filter.name, filterPreview.value());
+    }
+}
+
+void Editor::adjustFilterPreview(int direction) {
+    const PreviewFilter& filter = filterPreview.currentFilter();
+    float v = filterPreview.value();
+    if (filter.step > 0.0f) {
+        v += direction * filter.step;
+    } else {
+        v *= direction > 0 ? 1.25f : 0.8f;
+    }
+    std::vector<SDL_Rect> changed;
+    filterPreview.setValue(v, changed);
+    const int previewIndex = layers.indexOf(previewLayer);
+    for (const SDL_Rect& r : changed) refreshLayerTexture(previewIndex, &r);
+    SDL_Log("%s: %g", filter.name, filterPreview.value());
+}
+
+// Применение в фоне досчитывает оставшиеся тайлы в пуле задач. Если слой нужно
+// менять раньше (щелчок, другая операция), оно завершается здесь же;
+// отменить начатое применение уже нельзя.
+void Editor::endFilterPreview(bool apply, bool background) {
+    if (!filterPreview.active()) return;
+    if (filterPreview.committing()) {
+        filterPreview.finishCommit();
+        return;
+    }
+    if (!apply) {
+        SDL_Rect changed = filterPreview.cancel();
+        const int previewIndex = layers.indexOf(previewLayer);
+        if (previewIndex >= 0 && !SDL_RectEmpty(&changed)) {
+            refreshLayerTexture(previewIndex, &changed);
+        }
+        previewLayer = NoLayer;
+        return;
+    }
+    filterPreview.commit([this](SDL_Rect changed) {
+        const int previewIndex = layers.indexOf(previewLayer);
+        if (previewIndex >= 0 && !SDL_RectEmpty(&changed)) {
+            refreshLayerTexture(previewIndex, &changed);
+        }
+        previewLayer = NoLayer;
+    });
+    if (!background) filterPreview.finishCommit();
+}
+
+// Автоуровни: каждый канал растягивается так, чтобы 0.1% самых тёмных и самых
+// светлых пикселей (в пределах выделения) ушли в 0 и 255
+void Editor::autoLevels() {
+    if (!layers[active_layer].surface || layers[active_layer].adjustment) return;
+
+    std::shared_ptr<const SelectionMask> mask = copySelection(selection);
+    filterLayerAsync("auto levels", [mask](SDL_Surface* surface) {
+        const Histogram hist = computeHistogram(surface, mask->clipRect(surface->w, surface->h), mask.get());
+        if (hist.pixels == 0) return SDL_Rect{ 0, 0, 0, 0 };
+
+        ColorLut lut = ColorLut::identity();
+        for (int c = 0; c < 3; ++c) {
+            const Histogram::Channel channel = static_cast<Histogram::Channel>(c);
+            int lo = hist.percentile(channel, 0.001f);
+            int hi = hist.percentile(channel, 0.999f);
+            if (hi <= lo) continue;   // однотонный канал не трогаем
+            SDL_memcpy(lut.table[c], ColorLut::levels(lo, hi, 1.0f, 0, 255).table[c], 256);
+        }
+        if (lut.isIdentity()) return SDL_Rect{ 0, 0, 0, 0 };
+        return applyLut(surface, lut, mask.get());
+    });
+}
+
+bool Editor::layerJobRunning() const {
+    if (!layerJob || layerJob->finished()) return false;
+    SDL_Log("%s is still running", layerJob->name().c_str());
+    return true;
+}
+
+// Фильтр активного слоя в пуле задач: работает над копией пикселей из снимка
+// тайлов и возвращает изменённый прямоугольник; по завершении он переносится
+// в слой, если тот не менялся с начала операции
+void Editor::filterLayerAsync(const std::string& name, std::function<SDL_Rect(SDL_Surface*)> filter) {
+    if (layerJobRunning()) return;
+    Layer& layer = layers[active_layer];
+    std::shared_ptr<const TileSnapshot> input = snapshotLayer(layer);
+    if (!input) return;
+
+    struct Result {
+        SDL_Surface* surface = nullptr;
+        SDL_Rect changed = { 0, 0, 0, 0 };
+        ~Result() { if (surface) SDL_DestroySurface(surface); }
+    };
+    auto result = std::make_shared<Result>();
+    const LayerId id = layers.idAt(active_layer);
+    const Uint32 revision = layer.revision;
+
+    layerJob = createTaskGroup(name);
+    submitTask(layerJob, [input, filter, result](TaskGroup& group) {
+        result->surface = surfaceFromSnapshot(*input);
+        if (result->surface && !group.cancelled()) result->changed = filter(result->surface);
+    });
+    finishTaskGroup(layerJob, [this, id, revision, result](TaskGroup& group) {
+        const int index = layers.indexOf(id);
+        if (group.cancelled() || !result->surface || SDL_RectEmpty(&result->changed)) return;
+        if (index < 0 || layers[index].revision != revision) {
+            SDL_Log("%s: the layer changed meanwhile, result discarded", group.name().c_str());
+            return;
+        }
+        SDL_Surface* surface = layers[index].writableSurface();
+        if (!surface) return;
+        const SDL_Rect& r = result->changed;
+        for (int y = r.y; y < r.y + r.h; ++y) {
+            SDL_memcpy(static_cast<Uint8*>(surface->pixels) + y * surface->pitch + r.x * 4,
+                       static_cast<const Uint8*>(result->surface->pixels) + y * result->surface->pitch + r.x * 4,
+                       r.w * 4);
+        }
+        refreshLayerTexture(index, &r);
+    });
+}
+
+// Новые surface растровых слоёв indices: transform получает снимок тайлов слоя
+// (единственную ссылку на него у задачи — его можно отпускать по ходу) и
+// возвращает новый surface. По задаче на слой; по завершении, если документ
+// не менялся, surface подменяются и вызывается finish
+void Editor::replaceLayersAsync(const std::string& name, const std::vector<int>& indices,
+                                std::function<SDL_Surface*(std::shared_ptr<const TileSnapshot>)> transform,
+                                std::function<void()> finish) {
+    if (layerJobRunning()) return;
+
+    struct Entry {
+        LayerId id;
+        Uint32 revision;
+        std::shared_ptr<const TileSnapshot> input;
+        SDL_Surface* output = nullptr;
+    };
+    struct Results {
+        std::vector<Entry> entries;
+        ~Results() {
+            for (Entry& e : entries) if (e.output) SDL_DestroySurface(e.output);
+        }
+    };
+    auto results = std::make_shared<Results>();
+    for (int i : indices) {
+        Layer& layer = layers[i];
+        if (!layer.surface || layer.adjustment) continue;
+        std::shared_ptr<const TileSnapshot> input = snapshotLayer(layer);
+        if (!input) {
+            SDL_Log("%s: layer %d was not changed", name.c_str(), i);
+            continue;
+        }
+        results->entries.push_back({ layers.idAt(i), layer.revision, input });
+    }
+
+    const int w = canvasWidth, h = canvasHeight;
+    const size_t count = layers.size();
+    layerJob = createTaskGroup(name);
+    layerJob->addWork(static_cast<int>(results->entries.size()));
+    for (size_t i = 0; i < results->entries.size(); ++i) {
+        submitTask(layerJob, [results, i, transform](TaskGroup& group) {
+            Entry& e = results->entries[i];
+            if (!group.cancelled()) e.output = transform(std::move(e.input));
+            e.input.reset();
+            group.advance();
+        });
+    }
+    finishTaskGroup(layerJob, [this, results, finish, w, h, count](TaskGroup& group) {
+        if (group.cancelled()) return;
+        bool unchanged = canvasWidth == w && canvasHeight == h && layers.size() == count;
+        for (const Entry& e : results->entries) {
+            const int index = layers.indexOf(e.id);
+            unchanged = unchanged && index >= 0 && layers[index].revision == e.revision;
+        }
+        if (!unchanged) {
+            SDL_Log("%s: the document changed meanwhile, result discarded", group.name().c_str());
+            return;
+        }
+        for (Entry& e : results->entries) {
+            if (!e.output) {
+                SDL_Log("%s: layer %d was not changed", group.name().c_str(), layers.indexOf(e.id));
+                continue;
+            }
+            replaceLayerSurface(layers.indexOf(e.id), e.output);
+            e.output = nullptr;
+        }
+        finish();
+    });
+}
+
+// Запекает подряд идущие табличные корректирующие слои (от активного вниз)
+// одной слитой таблицей в растровый слой под ними и удаляет их
+void Editor::mergeAdjustmentDown() {
+    int top = active_layer;
+    int target = top;
+    ColorLut fused = ColorLut::identity();
+    while (target >= 0 && layers[target].adjustment) {
+        const Adjustment& adj = *layers[target].adjustment;
+        if (!adj.isLut()) {
+            SDL_Log("mergeAdjustmentDown: %s cannot be baked into a table", adjustmentName(adj.params().type));
+            return;
+        }
+        if (layers[target].visible) fused = adj.lut().then(fused);   // нижний применяется первым
+        --target;
+    }
+    if (target < 0 || !layers[target].writableSurface()) return;
+
+    SDL_Rect changed = applyLut(layers[target].surface, fused, &selection);
+    if (!SDL_RectEmpty(&changed)) {
+        refreshLayerTexture(target, &changed);
+    }
+    layers.erase(target + 1, top + 1);
+    active_layer = target;
+}
+
+// Ставит слою новый surface (старый освобождается) и перезаливает текстуру
+void Editor::replaceLayerSurface(int index, SDL_Surface* surface) {
+    Layer& layer = layers[index];
+    layer.surface = surface;   // прежний освободится, когда его отпустят все копии
+    ++layer.surfaceGeneration;   // пиксельные патчи отмены к новому surface не относятся
+    layer.canvasWidth = surface->w;
+    layer.canvasHeight = surface->h;
+    layer.tileRevisions.clear();
+    if (layer.adjustment) layer.adjustment->tileStamps.clear();
+    histogramCache.reset();   // новый surface может занять адрес старого
+
+    for (DrawableHandle h : layer.objects) {
+        if (auto* bg = dynamic_cast<DrawableImageBackground*>(drawables.get(h))) {
+            bg->width = surface->w;
+            bg->height = surface->h;
+        }
+    }
+    refreshLayerTexture(index);
+}
+
+// Пиксели масштабируются в пуле задач; объекты, корректирующие слои и размер
+// холста меняются по завершении вместе с подменой surface
+void Editor::resizeImage(int newW, int newH, Resample filter) {
+    if (newW == canvasWidth && newH == canvasHeight) return;
+    commitTransform();
+
+    const float sx = float(newW) / canvasWidth;
+    const float sy = float(newH) / canvasHeight;
+
+    std::vector<int> indices(layers.size());
+    for (int i = 0; i < static_cast<int>(indices.size()); ++i) indices[i] = i;
+    replaceLayersAsync("resize", indices, [sx, sy, filter](std::shared_ptr<const TileSnapshot> pixels) {
+        SDL_Surface* surface = surfaceFromSnapshot(*pixels);
+        pixels.reset();
+        if (!surface) return static_cast<SDL_Surface*>(nullptr);
+        int w = std::max(1, static_cast<int>(lroundf(surface->w * sx)));
+        int h = std::max(1, static_cast<int>(lroundf(surface->h * sy)));
+        SDL_Surface* resized = resizeSurface(surface, w, h, filter);
+        SDL_DestroySurface(surface);
+        return resized;
+    }, [this, newW, newH, sx, sy, filter]() {
+        for (int i = 0; i < static_cast<int>(layers.size()); ++i) {
+            Layer& layer = layers[i];
+            if (layer.surface && layer.adjustment) {
+                // Корректирующий слой пересчитается из нижних — масштабировать нечего
+                int w = std::max(1, static_cast<int>(lroundf(layer.surface->w * sx)));
+                int h = std::max(1, static_cast<int>(lroundf(layer.surface->h * sy)));
+                SDL_Surface* blank = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+                if (blank) replaceLayerSurface(i, blank);
+            }
+            layer.editShapes().scale(sx, sy);
+        }
+
+        canvasWidth = newW;
+        canvasHeight = newH;
+        canvasRect.w = newW;
+        canvasRect.h = newH;
+        selection.reset(newW, newH);
+        printf("Image resized to %dx%d (%s)\n", newW, newH, resampleName(filter));
+    });
+}
+
+// Новые surface собираются из снимков тайлов в пуле задач, сразу со сдвигом;
+// объекты, корректирующие слои и размер холста меняются по завершении
+void Editor::resizeCanvasTo(int newW, int newH) {
+    if (newW == canvasWidth && newH == canvasHeight) return;
+    commitTransform();
+
+    // Содержимое остаётся по центру
+    const int dx = (newW - canvasWidth) / 2;
+    const int dy = (newH - canvasHeight) / 2;
+
+    std::vector<int> indices(layers.size());
+    for (int i = 0; i < static_cast<int>(indices.size()); ++i) indices[i] = i;
+    replaceLayersAsync("canvas size", indices, [newW, newH, dx, dy](std::shared_ptr<const TileSnapshot> pixels) {
+        return surfaceFromSnapshot(*pixels, newW, newH, dx, dy);
+    }, [this, newW, newH, dx, dy]() {
+        for (int i = 0; i < static_cast<int>(layers.size()); ++i) {
+            Layer& layer = layers[i];
+            if (layer.surface && layer.adjustment) {
+                // Кэш корректирующего слоя пересчитается из нижних слоёв
+                SDL_Surface* blank = SDL_CreateSurface(newW, newH, SDL_PIXELFORMAT_RGBA32);
+                if (blank) replaceLayerSurface(i, blank);
+            }
+            layer.editShapes().translate(static_cast<float>(dx), static_cast<float>(dy));
+        }
+
+        canvasWidth = newW;
+        canvasHeight = newH;
+        canvasRect.w = newW;
+        canvasRect.h = newH;
+        selection.reset(newW, newH);
+        printf("Canvas resized to %dx%d\n", newW, newH);
+    });
+}
+
+// Поворачивает или отражает объекты слоя в системе координат холста w x h и
+// заменяет кэш корректирующего слоя пустым newW x newH; пиксели растровых слоёв
+// поворачивает orientSnapshot в пуле задач. Для 90° и 270° результат
+// центрируется в холсте newW x newH.
+void Editor::orientLayerShapes(int index, Orientation o, int w, int h, int newW, int newH) {
+    Layer& layer = layers[index];
+    const int dx = swapsAxes(o) ? (newW - h) / 2 : 0;
+    const int dy = swapsAxes(o) ? (newH - w) / 2 : 0;
+    ObjectStore& shapes = layer.editShapes();
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        SDL_FRect f = shapes.rectAt(i);
+        SDL_Rect r = orientRect(SDL_Rect{ int(f.x), int(f.y), int(f.w), int(f.h) }, w, h, o);
+        shapes.setRectAt(i, SDL_FRect{ float(r.x + dx), float(r.y + dy), float(r.w), float(r.h) });
+    }
+
+    if (layer.surface && layer.adjustment) {
+        // Кэш корректирующего слоя пересчитается из нижних слоёв
+        SDL_Surface* blank = SDL_CreateSurface(newW, newH, SDL_PIXELFORMAT_RGBA32);
+        if (blank) replaceLayerSurface(index, blank);
+    }
+}
+
+
+void Editor::orientLayer(int index, Orientation o) {
+    if (index < 0 || index >= static_cast<int>(layers.size())) return;
+    commitTransform();
+    // Слой поворачивается вокруг центра холста, размер холста не меняется
+    const Layer& layer = layers[index];
+    int w = layer.surface ? layer.surface->w : canvasWidth;
+    int h = layer.surface ? layer.surface->h : canvasHeight;
+    const LayerId id = layers.idAt(index);
+    replaceLayersAsync("orient layer", { index }, [o, w, h](std::shared_ptr<const TileSnapshot> pixels) {
+        return orientSnapshot(std::move(pixels), o, w, h);
+    }, [this, id, o, w, h]() {
+        const int i = layers.indexOf(id);
+        if (i < 0) return;
+        orientLayerShapes(i, o, w, h, w, h);
+    });
+}
+
+void Editor::orientDocument(Orientation o) {
+    commitTransform();
+    const int w = canvasWidth, h = canvasHeight;
+    const int newW = swapsAxes(o) ? h : w;
+    const int newH = swapsAxes(o) ? w : h;
+    std::vector<int> indices(layers.size());
+    for (int i = 0; i < static_cast<int>(indices.size()); ++i) indices[i] = i;
+    replaceLayersAsync("orient image", indices, [o, newW, newH](std::shared_ptr<const TileSnapshot> pixels) {
+        return orientSnapshot(std::move(pixels), o, newW, newH);
+    }, [this, o, w, h, newW, newH]() {
+        for (int i = 0; i < static_cast<int>(layers.size()); ++i) {
+            orientLayerShapes(i, o, w, h, newW, newH);
+        }
+
+        canvasWidth = newW;
+        canvasHeight = newH;
+        canvasRect.w = newW;
+        canvasRect.h = newH;
+        selection.reset(newW, newH);
+    });
+}
+
+// Устаревшие тайлы корректирующего слоя считаются в пуле задач; до завершения
+// показывается прежний кэш. Пока идёт один пересчёт, новый не начинается —
+// оставшиеся устаревшими тайлы попадут в следующий кадр после него.
+void Editor::updateAdjustmentLayers(SDL_Rect area) {
+    if (adjustmentJob && !adjustmentJob->finished()) return;
+    std::shared_ptr<AdjustmentJob> job = prepareAdjustments(layers, area);
+    if (!job) return;
+
+    adjustmentJob = createTaskGroup("adjustments", JobPriority::Normal);
+    for (size_t i = 0; i < job->tiles.size(); ++i) {
+        submitTask(adjustmentJob, [job, i](TaskGroup& group) {
+            if (!group.cancelled()) renderAdjustmentTile(*job, i);
+        });
+    }
+    finishTaskGroup(adjustmentJob, [this, job](TaskGroup& group) {
+        if (group.cancelled()) return;
+        SDL_Rect changed;
+        const int index = applyAdjustments(layers, *job, changed);
+        if (index >= 0 && !SDL_RectEmpty(&changed)) refreshLayerTexture(index, &changed);
+    });
+}
+
+void Editor::beginTransform(SDL_FPoint world, TransformMode mode) {
+    Layer& layer = layers[active_layer];
+    SDL_Surface* surface = layer.writableSurface();
+    if (!surface || layer.adjustment) return;
+
+    SDL_Rect area = selection.clipRect(surface->w, surface->h);
+    if (SDL_RectEmpty(&area)) return;
+
+    TransformSession& ts = transformSession;
+    ts.release();
+    ts.floating = SDL_CreateSurface(area.w, area.h, SDL_PIXELFORMAT_RGBA32);
+    ts.original = SDL_CreateSurface(area.w, area.h, SDL_PIXELFORMAT_RGBA32);
+    if (!ts.floating || !ts.original) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "beginTransform: %s", SDL_GetError());
+        ts.release();
+        return;
+    }
+
+    // 1) Вырезаем пиксели: в floating — с покрытием выделения, в слое остаётся остаток.
+    // Покрытия частей в сумме дают исходную альфу; original — нетронутая копия для отмены
+    bool clipped = selection.active();
+    std::vector<Uint8> coverage(area.w, 255);
+    SDL_LockSurface(surface);
+    SDL_LockSurface(ts.floating);
+    for (int yy = 0; yy < area.h; ++yy) {
+        if (clipped) selection.readRow(area.y + yy, area.x, area.w, coverage.data());
+        Uint8* src = static_cast<Uint8*>(surface->pixels) + (area.y + yy) * surface->pitch + area.x * 4;
+        Uint8* dst = static_cast<Uint8*>(ts.floating->pixels) + yy * ts.floating->pitch;
+        SDL_memcpy(static_cast<Uint8*>(ts.original->pixels) + yy * ts.original->pitch, src, area.w * 4);
+        for (int xx = 0; xx < area.w; ++xx) {
+            Uint8* s = src + xx * 4;
+            Uint8* d = dst + xx * 4;
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = static_cast<Uint8>(s[3] * coverage[xx] / 255);
+            s[3] = static_cast<Uint8>(s[3] * (255 - coverage[xx]) / 255);
+        }
+    }
+    SDL_UnlockSurface(ts.floating);
+    SDL_UnlockSurface(surface);
+    refreshLayerTexture(active_layer, &area);
+
+    // 2) Прокси для интерактивного предпросмотра: длинная сторона не больше 512
+    ts.proxyScale = std::min(1.0f, 512.0f / std::max(area.w, area.h));
+    int pw = std::max(1, static_cast<int>(ceilf(area.w * ts.proxyScale)));
+    int ph = std::max(1, static_cast<int>(ceilf(area.h * ts.proxyScale)));
+    ts.proxy = SDL_CreateSurface(pw, ph, SDL_PIXELFORMAT_RGBA32);
+    if (ts.proxy) {
+        warpAffine(ts.floating, ts.proxy, Affine::scale(ts.proxyScale, ts.proxyScale),
+                   Resample::Bilinear, SDL_Rect{0, 0, pw, ph});
+    }
+
+    ts.active = true;
+    ts.layer = layers.idAt(active_layer);
+    ts.mode = mode;
+    ts.origin = { area.x, area.y };
+    ts.pivot = { area.x + area.w * 0.5f, area.y + area.h * 0.5f };
+    ts.dragStart = world;
+    ts.matrix = Affine();
+    ts.base = Affine();
+    ts.dragging = true;
+    updateTransformPreview();
+}
+
+// Новое перетаскивание в открытой сессии: матрица накапливается,
+// центр вращения и масштаба — центр уже преобразованной области
+void Editor::continueTransform(SDL_FPoint world, TransformMode mode) {
+    TransformSession& ts = transformSession;
+    ts.base = ts.matrix;
+    ts.mode = mode;
+    ts.pivot = ts.matrix.apply(ts.origin.x + ts.floating->w * 0.5f, ts.origin.y + ts.floating->h * 0.5f);
+    ts.dragStart = world;
+    ts.dragging = true;
+}
+
+void Editor::updateTransform(SDL_FPoint world) {
+    TransformSession& ts = transformSession;
+    const SDL_FPoint p = ts.pivot;
+    float dx = world.x - ts.dragStart.x;
+    float dy = world.y - ts.dragStart.y;
+
+    // Все преобразования, кроме переноса, — вокруг центра вырезанной области
+    Affine around;
+    Affine drag;
+    switch (ts.mode) {
+        case TransformMode::Move:
+            drag = Affine::translate(dx, dy);
+            break;
+        case TransformMode::Scale: {
+            float d0 = std::hypot(ts.dragStart.x - p.x, ts.dragStart.y - p.y);
+            float d1 = std::hypot(world.x - p.x, world.y - p.y);
+            float s = d0 > 1.0f ? std::max(d1 / d0, 0.01f) : 1.0f;
+            around = Affine::scale(s, s);
+            break;
+        }
+        case TransformMode::Rotate: {
+            float a0 = atan2f(ts.dragStart.y - p.y, ts.dragStart.x - p.x);
+            float a1 = atan2f(world.y - p.y, world.x - p.x);
+            around = Affine::rotate(a1 - a0);
+            break;
+        }
+        case TransformMode::Skew:
+            around = Affine::skew(dx / std::max(1, ts.floating->h), dy / std::max(1, ts.floating->w));
+            break;
+    }
+    if (ts.mode != TransformMode::Move) {
+        drag = Affine::translate(p.x, p.y) * around * Affine::translate(-p.x, -p.y);
+    }
+    ts.matrix = drag * ts.base;
+    updateTransformPreview();
+}
+
+void Editor::updateTransformPreview() {
+    TransformSession& ts = transformSession;
+    if (!ts.proxy) return;
+
+    // floating -> холст; превью строится из прокси в его собственном масштабе
+    Affine full = ts.matrix * Affine::translate(static_cast<float>(ts.origin.x), static_cast<float>(ts.origin.y));
+    SDL_FRect bounds = transformedBounds(SDL_FRect{0, 0, (float)ts.floating->w, (float)ts.floating->h}, full);
+
+    float ps = ts.proxyScale;
+    int pw = std::max(1, static_cast<int>(ceilf(bounds.w * ps)));
+    int ph = std::max(1, static_cast<int>(ceilf(bounds.h * ps)));
+    SDL_Surface* frame = SDL_CreateSurface(pw, ph, SDL_PIXELFORMAT_RGBA32);
+    if (!frame) return;
+
+    Affine proxyToFrame = Affine::scale(ps, ps) * Affine::translate(-bounds.x, -bounds.y) *
+                          full * Affine::scale(1.0f / ps, 1.0f / ps);
+    warpAffine(ts.proxy, frame, proxyToFrame, Resample::Bilinear, SDL_Rect{0, 0, pw, ph});
+    uploadSurface(renderer, ts.preview, frame, nullptr);
+    SDL_DestroySurface(frame);
+
+    ts.previewRect = { bounds.x, bounds.y, pw / ps, ph / ps };
+}
+
+void Editor::commitTransform() {
+    TransformSession& ts = transformSession;
+    if (!ts.active) return;
+
+    const int index = layers.indexOf(ts.layer);
+    SDL_Surface* surface = index >= 0 ? layers[index].writableSurface() : nullptr;
+    if (surface) {
+        Affine full = ts.matrix * Affine::translate(static_cast<float>(ts.origin.x), static_cast<float>(ts.origin.y));
+        SDL_FRect b = transformedBounds(SDL_FRect{0, 0, (float)ts.floating->w, (float)ts.floating->h}, full);
+        SDL_Rect area = {
+            static_cast<int>(floorf(b.x)),
+            static_cast<int>(floorf(b.y)),
+            static_cast<int>(ceilf(b.x + b.w) - floorf(b.x)),
+            static_cast<int>(ceilf(b.y + b.h) - floorf(b.y))
+        };
+
+        if (ts.matrix.identity()) {
+            restoreTransformArea(surface);
+        } else {
+            // Полное разрешение и выбранный фильтр — один раз из исходных пикселей
+            // с итоговой матрицей всех перетаскиваний. Покрытия складываются с
+            // остатком: там, где части снова совпали, альфа исходная, а не source-over
+            warpAffine(ts.floating, surface, full, transformFilter, area, WarpBlend::Add);
+        }
+        refreshLayerTexture(index);
+
+        // Маска выделения осталась на старом месте
+        if (selection.active()) selection.clear();
+    }
+    ts.release();
+}
+
+// Возвращает область в точности такой, какой она была до вырезания
+void Editor::cancelTransform() {
+    TransformSession& ts = transformSession;
+    if (!ts.active) return;
+    const int index = layers.indexOf(ts.layer);
+    SDL_Surface* surface = index >= 0 ? layers[index].writableSurface() : nullptr;
+    if (surface) {
+        SDL_Rect area = { ts.origin.x, ts.origin.y, ts.original->w, ts.original->h };
+        restoreTransformArea(surface);
+        refreshLayerTexture(index, &area);
+    }
+    ts.release();
+}
+
+void Editor::restoreTransformArea(SDL_Surface* surface) {
+    const TransformSession& ts = transformSession;
+    if (ts.origin.x + ts.original->w > surface->w || ts.origin.y + ts.original->h > surface->h) return;
+    SDL_LockSurface(surface);
+    for (int y = 0; y < ts.original->h; ++y) {
+        SDL_memcpy(static_cast<Uint8*>(surface->pixels) + (ts.origin.y + y) * surface->pitch + ts.origin.x * 4,
+                   static_cast<const Uint8*>(ts.original->pixels) + y * ts.original->pitch, ts.original->w * 4);
+    }
+    SDL_UnlockSurface(surface);
+}
+
 //void Editor::updateLayerSurface(int index) {
 //    if (index < 0 || index >= static_cast<int>(layers.size())) return;
 //    Layer& layer = layers[index];
@@ -1,17 +1,30 @@
 #pragma once
 #include <SDL3/SDL.h>
+#include <functional>
 #include <vector>
 #include <string>
-#include "layer.h"
+#include "layerstack.h"
 #include "types.h"
 #include "tools.h"
+#include "selection.h"
+#include "transform.h"
+#include "adjustment.h"
+#include "orient.h"
+#include "histogram.h"
+#include "convolve.h"
+#include "preview.h"
+#include "jobs.h"
+#include "stroke.h"
+#include "panel.h"
+#include "thumbnail.h"
+#include "pool.h"
 
 class UndoManager;
 
 class Editor {
+    friend class UndoManager;   // отмена обновляет текстуры слоёв
+
 public:
-    std::vector<BrushStroke> brushStrokes;
-    
     Editor();
     ~Editor();
     void run();
@@ -26,22 +39,62 @@ private:
     bool hovering_button1 = false;
     int tool_count = 4;
 
-    std::vector<Layer> layers;
-    int active_layer = 0;
+    DrawablePool drawables;         // объекты слоёв; объявлен до layers, чтобы пережить их
+    LayerStack layers;
+    int active_layer = 0;           // позиция в стопке
     int canvasWidth = 800;
     int canvasHeight = 600;
     SDL_Rect canvasRect = {0, 0, 800, 600};
-    Rect* selected_rect = nullptr;
+    ObjectHandle selected_object;   // прямоугольник слоя selected_layer
+    LayerId selected_layer = NoLayer;
 
     float drag_offset_x = 0, drag_offset_y = 0;
     bool dragging = false;
     bool isDragging = false;
     SDL_FRect dragRect = {0}; // временный прямоугольник
 
+    SelectionMask selection;      // маска выделения в координатах холста
+    bool isMarquee = false;
+    SDL_FPoint marqueeStart = {0, 0};
+    SDL_FRect marqueeRect = {0}; // прямоугольное выделение в экранных координатах
+    float selectionRadius = 8.0f; // радиус растушёвки / расширения / сужения
+
     bool isBrushing = false;
-    float lastBrushX = -1, lastBrushY = -1;
+    StrokeSampler strokeSampler;   // точки кисти из событий движения -> отпечатки
+    StrokeOverlay strokeOverlay;   // текущий штрих до отпускания кнопки
     float brushSize = 4.0f;
 
+    SDL_Color fillColor = {160, 160, 160, 255};
+    int fillTolerance = 32;       // допуск по каналу для заливки и волшебной палочки
+    float blurSigma = 4.0f;       // sigma размытия и нерезкой маски
+    EdgeMode convolveEdges = EdgeMode::Mirror;
+    float medianRadius = 2.0f;
+    float bilateralSpatial = 8.0f, bilateralRange = 20.0f;   // px и уровни яркости
+
+    TransformSession transformSession;
+    Resample transformFilter = Resample::Bicubic;
+    Resample resizeFilter = Resample::Lanczos3;
+
+    bool showHistogram = false;
+    bool histogramComposite = false;   // панель по видимому изображению, а не по слою
+    CachedPanel sidebarPanel;      // боковая панель после анимации
+    CachedPanel histogramPanel;
+    float layerScroll = 0.0f;      // прокрутка списка слоёв, px
+    int shownActiveLayer = -1;     // активный слой, до которого список уже прокручен
+    HistogramCache histogramCache;   // гистограмма активного слоя для панели
+
+    FilterPreview filterPreview;
+    LayerId previewLayer = NoLayer;
+
+    Uint64 lastAutosave = 0;
+    Uint32 autosaveStamp = 0;     // состояние документа при последнем автосохранении
+    TaskGroupPtr autosaveJobs;
+    std::string autosaveDir;      // свой каталог у каждого документа; файлы — по LayerId
+    std::vector<LayerId> autosavedLayers;
+
+    TaskGroupPtr layerJob;        // свёртка, автоуровни, размер, поворот слоёв
+    TaskGroupPtr adjustmentJob;   // пересчёт кэша корректирующего слоя
+
     Tool current_tool = Tool::None;
     //BrushState brushState;
     UndoManager undoManager;
@@ -56,6 +109,44 @@ private:
     void toggle_tool(Tool tool);
     void render();
     void importImage(const std::string& path);
-    void createLayerFromSelection(const std::vector<SDL_FPoint>& polygon);
+    void appendBrushDabs(std::vector<BrushDab>& dabs);
+    void addImageLayer(SDL_Surface* surface);
+    void autosave();
+    void createLayerFromSelection();
+    void duplicateLayer();
+    void commitPenSelection(SelectionOp op);
     void updateLayerSurface(int index);
+    void refreshLayerTexture(int index, const SDL_Rect* dirty = nullptr);
+    void addAdjustmentLayer(AdjustmentType type);
+    void updateAdjustmentLayers(SDL_Rect area);
+    void mergeAdjustmentDown();
+    void autoLevels();
+    bool layerJobRunning() const;
+    void filterLayerAsync(const std::string& name, std::function<SDL_Rect(SDL_Surface*)> filter);
+    void replaceLayersAsync(const std::string& name, const std::vector<int>& indices,
+                            std::function<SDL_Surface*(std::shared_ptr<const TileSnapshot>)> transform,
+                            std::function<void()> finish);
+    void beginFilterPreview(const PreviewFilter& filter);
+    void adjustFilterPreview(int direction);
+    // Enter: применение досчитывается в пуле задач (background = true).
+    // Остальные вызовы дожидаются его — перед ними слой должен быть готов.
+    void endFilterPreview(bool apply, bool background = false);
+    void drawHistogramPanel();
+    void drawSidebar();
+    void updateThumbnail(Layer& layer);
+    void visibleLayerRows(int& first, int& last) const;
+    void clampLayerScroll();
+    void replaceLayerSurface(int index, SDL_Surface* surface);
+    void resizeImage(int newW, int newH, Resample filter);
+    void resizeCanvasTo(int newW, int newH);
+    void orientLayerShapes(int index, Orientation o, int w, int h, int newW, int newH);
+    void orientLayer(int index, Orientation o);
+    void orientDocument(Orientation o);
+    void beginTransform(SDL_FPoint world, TransformMode mode);
+    void continueTransform(SDL_FPoint world, TransformMode mode);
+    void updateTransform(SDL_FPoint world);
+    void updateTransformPreview();
+    void commitTransform();
+    void cancelTransform();
+    void restoreTransformArea(SDL_Surface* surface);   // копия original обратно на место
 };
@@ -0,0 +1,321 @@
+#include "floodfill.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+// Начиная с этого размера заливка идёт через параллельную разметку компонент
+constexpr Sint64 ParallelThreshold = 4 * 1024 * 1024;
+
+struct Run {
+    int x0, x1;   // [x0, x1)
+};
+
+struct Band {
+    int y0 = 0, y1 = 0;
+    std::vector<Run> runs;
+    std::vector<int> rowStart;   // runs строки y0 + r: [rowStart[r], rowStart[r + 1])
+    std::vector<int> parent;
+    SDL_Rect bounds = {0, 0, 0, 0};
+};
+
+inline bool matchPixel(const Uint8* p, const Uint8* seed, int tolerance) {
+    return abs(p[0] - seed[0]) <= tolerance && abs(p[1] - seed[1]) <= tolerance &&
+           abs(p[2] - seed[2]) <= tolerance && abs(p[3] - seed[3]) <= tolerance;
+}
+
+// out[x] = 1, если пиксель строки близок к затравке
+void matchRow(const Uint8* row, int w, const Uint8* seed, int tolerance, Uint8* out) {
+    int x = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    Uint32 seedValue;
+    SDL_memcpy(&seedValue, seed, 4);
+    const __m128i seedv = _mm_set1_epi32(static_cast<int>(seedValue));
+    const __m128i tolv = _mm_set1_epi8(static_cast<char>(tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= w; x += 4) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(p, seedv), _mm_subs_epu8(seedv, p));
+        __m128i ok = _mm_cmpeq_epi32(_mm_subs_epu8(diff, tolv), zero);
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(ok));
+        out[x + 0] = bits & 1;
+        out[x + 1] = (bits >> 1) & 1;
+        out[x + 2] = (bits >> 2) & 1;
+        out[x + 3] = (bits >> 3) & 1;
+    }
+#endif
+    for (; x < w; ++x) {
+        out[x] = matchPixel(row + x * 4, seed, tolerance) ? 1 : 0;
+    }
+}
+
+int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+void unite(std::vector<int>& parent, int a, int b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a == b) return;
+    if (a < b) std::swap(a, b);
+    parent[a] = b;   // корень — меньший индекс, деревья остаются неглубокими
+}
+
+// Объединяет отрезки двух соседних строк, перекрывающиеся по x
+void uniteRows(std::vector<int>& parent,
+               const Run* prev, int prevBase, int prevCount,
+               const Run* cur, int curBase, int curCount) {
+    int i = 0, j = 0;
+    while (i < prevCount && j < curCount) {
+        if (prev[i].x0 < cur[j].x1 && cur[j].x0 < prev[i].x1) {
+            unite(parent, prevBase + i, curBase + j);
+        }
+        if (prev[i].x1 < cur[j].x1) ++i; else ++j;
+    }
+}
+
+void growBounds(SDL_Rect& r, int x0, int y0, int x1, int y1) {
+    if (r.w <= 0 || r.h <= 0) {
+        r = { x0, y0, x1 - x0, y1 - y0 };
+        return;
+    }
+    int rx1 = std::max(r.x + r.w, x1);
+    int ry1 = std::max(r.y + r.h, y1);
+    r.x = std::min(r.x, x0);
+    r.y = std::min(r.y, y0);
+    r.w = rx1 - r.x;
+    r.h = ry1 - r.y;
+}
+
+CoverageMask cropMask(const std::vector<Uint8>& inside, int w, SDL_Rect bounds) {
+    CoverageMask mask;
+    if (bounds.w <= 0 || bounds.h <= 0) return mask;
+    mask.x = bounds.x;
+    mask.y = bounds.y;
+    mask.w = bounds.w;
+    mask.h = bounds.h;
+    mask.alpha.resize(static_cast<size_t>(mask.w) * mask.h);
+    for (int yy = 0; yy < mask.h; ++yy) {
+        SDL_memcpy(mask.alpha.data() + static_cast<size_t>(yy) * mask.w,
+                   inside.data() + static_cast<size_t>(bounds.y + yy) * w + bounds.x, mask.w);
+    }
+    return mask;
+}
+
+// Классическая заливка стеком отрезков: без рекурсии, каждый пиксель читается O(1) раз
+CoverageMask spanFill(const Uint8* pixels, int pitch, int w, int h, int sx, int sy, int tolerance) {
+    const Uint8* seed = pixels + sy * pitch + sx * 4;
+    Uint8 seedColor[4] = { seed[0], seed[1], seed[2], seed[3] };
+
+    std::vector<Uint8> inside(static_cast<size_t>(w) * h, 0);
+    auto fillable = [&](int x, int y) {
+        return !inside[static_cast<size_t>(y) * w + x] &&
+               matchPixel(pixels + y * pitch + x * 4, seedColor, tolerance);
+    };
+
+    SDL_Rect bounds = {0, 0, 0, 0};
+    std::vector<SDL_Point> stack;
+    stack.push_back({sx, sy});
+
+    while (!stack.empty()) {
+        SDL_Point p = stack.back();
+        stack.pop_back();
+        if (inside[static_cast<size_t>(p.y) * w + p.x]) continue;
+
+        int xl = p.x, xr = p.x;
+        while (xl > 0 && fillable(xl - 1, p.y)) --xl;
+        while (xr < w - 1 && fillable(xr + 1, p.y)) ++xr;
+        SDL_memset(inside.data() + static_cast<size_t>(p.y) * w + xl, 255, xr - xl + 1);
+        growBounds(bounds, xl, p.y, xr + 1, p.y + 1);
+
+        // По одной затравке на каждый новый отрезок сверху и снизу
+        for (int ny = p.y - 1; ny <= p.y + 1; ny += 2) {
+            if (ny < 0 || ny >= h) continue;
+            bool inSpan = false;
+            for (int x = xl; x <= xr; ++x) {
+                if (fillable(x, ny)) {
+                    if (!inSpan) {
+                        stack.push_back({x, ny});
+                        inSpan = true;
+                    }
+                } else {
+                    inSpan = false;
+                }
+            }
+        }
+    }
+    return cropMask(inside, w, bounds);
+}
+
+// Параллельная разметка: полосы строк размечаются независимо (отрезки + union-find),
+// затем склеиваются по границам полос, и в маску пишется компонента затравки.
+CoverageMask labelFill(const Uint8* pixels, int pitch, int w, int h, int sx, int sy, int tolerance) {
+    const Uint8* seed = pixels + sy * pitch + sx * 4;
+    Uint8 seedColor[4] = { seed[0], seed[1], seed[2], seed[3] };
+
+    int bandRows = std::max(64, h / (workerCount() * 4));
+    int bandCount = (h + bandRows - 1) / bandRows;
+    std::vector<Band> bands(bandCount);
+
+    // 1) Отрезки и локальные компоненты внутри каждой полосы
+    parallelFor(0, bandCount, 1, [&](int from, int to) {
+        std::vector<Uint8> match(w);
+        for (int b = from; b < to; ++b) {
+            Band& band = bands[b];
+            band.y0 = b * bandRows;
+            band.y1 = std::min(h, band.y0 + bandRows);
+            band.rowStart.push_back(0);
+
+            for (int y = band.y0; y < band.y1; ++y) {
+                matchRow(pixels + y * pitch, w, seedColor, tolerance, match.data());
+                int rowBegin = static_cast<int>(band.runs.size());
+                for (int x = 0; x < w;) {
+                    if (!match[x]) { ++x; continue; }
+                    int x0 = x;
+                    while (x < w && match[x]) ++x;
+                    band.runs.push_back({x0, x});
+                    band.parent.push_back(static_cast<int>(band.parent.size()));
+                }
+                int rowEnd = static_cast<int>(band.runs.size());
+                band.rowStart.push_back(rowEnd);
+
+                if (y > band.y0) {
+                    int prevBegin = band.rowStart[y - band.y0 - 1];
+                    uniteRows(band.parent,
+                              band.runs.data() + prevBegin, prevBegin, rowBegin - prevBegin,
+                              band.runs.data() + rowBegin, rowBegin, rowEnd - rowBegin);
+                }
+            }
+            for (int i = 0; i < static_cast<int>(band.parent.size()); ++i) {
+                band.parent[i] = findRoot(band.parent, i);
+            }
+        }
+    });
+
+    // 2) Глобальный union-find и склейка по границам полос
+    std::vector<int> offsets(bandCount + 1, 0);
+    for (int b = 0; b < bandCount; ++b) {
+        offsets[b + 1] = offsets[b] + static_cast<int>(bands[b].runs.size());
+    }
+    std::vector<int> parent(offsets[bandCount]);
+    for (int b = 0; b < bandCount; ++b) {
+        for (size_t i = 0; i < bands[b].parent.size(); ++i) {
+            parent[offsets[b] + i] = offsets[b] + bands[b].parent[i];
+        }
+    }
+    for (int b = 1; b < bandCount; ++b) {
+        const Band& up = bands[b - 1];
+        const Band& down = bands[b];
+        int upRow = up.y1 - up.y0 - 1;
+        int upBegin = up.rowStart[upRow], upEnd = up.rowStart[upRow + 1];
+        int downBegin = down.rowStart[0], downEnd = down.rowStart[1];
+        uniteRows(parent,
+                  up.runs.data() + upBegin, offsets[b - 1] + upBegin, upEnd - upBegin,
+                  down.runs.data() + downBegin, offsets[b] + downBegin, downEnd - downBegin);
+    }
+
+    // 3) Компонента, содержащая затравку
+    const Band& seedBand = bands[sy / bandRows];
+    int seedRow = sy - seedBand.y0;
+    int seedRun = -1;
+    for (int i = seedBand.rowStart[seedRow]; i < seedBand.rowStart[seedRow + 1]; ++i) {
+        if (seedBand.runs[i].x0 <= sx && sx < seedBand.runs[i].x1) {
+            seedRun = offsets[sy / bandRows] + i;
+            break;
+        }
+    }
+    if (seedRun < 0) return CoverageMask();
+
+    // После сплющивания parent[i] — корень, и четвёртый шаг только читает массив
+    for (int i = 0; i < static_cast<int>(parent.size()); ++i) {
+        parent[i] = findRoot(parent, i);
+    }
+    int seedRoot = parent[seedRun];
+
+    // 4) Запись маски по полосам
+    std::vector<Uint8> inside(static_cast<size_t>(w) * h, 0);
+    parallelFor(0, bandCount, 1, [&](int from, int to) {
+        for (int b = from; b < to; ++b) {
+            Band& band = bands[b];
+            for (int r = 0; r < band.y1 - band.y0; ++r) {
+                int y = band.y0 + r;
+                for (int i = band.rowStart[r]; i < band.rowStart[r + 1]; ++i) {
+                    if (parent[offsets[b] + i] != seedRoot) continue;
+                    const Run& run = band.runs[i];
+                    SDL_memset(inside.data() + static_cast<size_t>(y) * w + run.x0, 255, run.x1 - run.x0);
+                    growBounds(band.bounds, run.x0, y, run.x1, y + 1);
+                }
+            }
+        }
+    });
+
+    SDL_Rect bounds = {0, 0, 0, 0};
+    for (const Band& band : bands) {
+        if (band.bounds.w > 0) {
+            growBounds(bounds, band.bounds.x, band.bounds.y,
+                       band.bounds.x + band.bounds.w, band.bounds.y + band.bounds.h);
+        }
+    }
+    return cropMask(inside, w, bounds);
+}
+
+}
+
+CoverageMask floodRegion(SDL_Surface* surface, int x, int y, int tolerance) {
+    if (!surface || x < 0 || y < 0 || x >= surface->w || y >= surface->h) return CoverageMask();
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("floodRegion: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return CoverageMask();
+    }
+    tolerance = std::clamp(tolerance, 0, 255);
+
+    SDL_LockSurface(surface);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    CoverageMask mask;
+    if (static_cast<Sint64>(surface->w) * surface->h >= ParallelThreshold && workerCount() > 1) {
+        mask = labelFill(pixels, surface->pitch, surface->w, surface->h, x, y, tolerance);
+    } else {
+        mask = spanFill(pixels, surface->pitch, surface->w, surface->h, x, y, tolerance);
+    }
+    SDL_UnlockSurface(surface);
+    return mask;
+}
+
+SDL_Rect floodFill(SDL_Surface* surface, int x, int y, int tolerance,
+                   SDL_Color color, const SelectionMask* selection) {
+    SDL_Rect changed = {0, 0, 0, 0};
+    if (selection && selection->active() && selection->at(x, y) == 0) return changed;
+
+    CoverageMask region = floodRegion(surface, x, y, tolerance);
+    if (region.empty()) return changed;
+
+    bool clipped = selection && selection->active();
+    SDL_LockSurface(surface);
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+    const int pitch = surface->pitch;
+
+    parallelFor(0, region.h, 64, [&](int from, int to) {
+        std::vector<Uint8> sel(clipped ? region.w : 0);
+        for (int yy = from; yy < to; ++yy) {
+            const Uint8* coverage = region.row(yy);
+            if (clipped) selection->readRow(region.y + yy, region.x, region.w, sel.data());
+            Uint8* row = pixels + (region.y + yy) * pitch + region.x * 4;
+            for (int xx = 0; xx < region.w; ++xx) {
+                int a = coverage[xx];
+                if (clipped) a = a * sel[xx] / 255;
+                blendPixel(row + xx * 4, color, a);
+            }
+        }
+    });
+
+    SDL_UnlockSurface(surface);
+    changed = { region.x, region.y, region.w, region.h };
+    return changed;
+}
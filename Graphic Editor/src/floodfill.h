@@ -0,0 +1,16 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "raster.h"
+#include "selection.h"
+
+// Связная (4-соседство) область вокруг (x, y), цвет которой отличается от
+// цвета затравки не больше чем на tolerance по каждому каналу RGBA.
+// Результат — маска 0/255, обрезанная по bounding box области.
+// Мелкие изображения заливаются стеком отрезков, крупные — параллельной
+// разметкой связных компонент по полосам.
+CoverageMask floodRegion(SDL_Surface* surface, int x, int y, int tolerance);
+
+// Заливка области цветом; selection (если активно) ограничивает и сглаживает заливку.
+// Возвращает изменённый прямоугольник (пустой, если ничего не залито).
+SDL_Rect floodFill(SDL_Surface* surface, int x, int y, int tolerance,
+                   SDL_Color color, const SelectionMask* selection = nullptr);
@@ -0,0 +1,229 @@
+#include "histogram.h"
+#include "adjustment.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+constexpr int BandRows = 64;
+
+void accumulateRow(Histogram& h, const Uint8* p, const Uint8* coverage, int n) {
+    for (int x = 0; x < n; ++x, p += 4) {
+        if (coverage && coverage[x] < 128) continue;
+        ++h.bins[Histogram::Alpha][p[3]];
+        if (p[3] == 0) continue;
+        ++h.bins[Histogram::Red][p[0]];
+        ++h.bins[Histogram::Green][p[1]];
+        ++h.bins[Histogram::Blue][p[2]];
+        ++h.bins[Histogram::Luma][(54 * p[0] + 183 * p[1] + 19 * p[2] + 128) >> 8];
+        ++h.pixels;
+    }
+}
+
+void accumulateArea(Histogram& h, SDL_Surface* surface, SDL_Rect area) {
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+    for (int y = area.y; y < area.y + area.h; ++y) {
+        accumulateRow(h, pixels + y * surface->pitch + area.x * 4, nullptr, area.w);
+    }
+}
+
+}
+
+void Histogram::add(const Histogram& other) {
+    for (int c = 0; c < ChannelCount; ++c) {
+        for (int i = 0; i < 256; ++i) bins[c][i] += other.bins[c][i];
+    }
+    pixels += other.pixels;
+}
+
+void Histogram::subtract(const Histogram& other) {
+    for (int c = 0; c < ChannelCount; ++c) {
+        for (int i = 0; i < 256; ++i) bins[c][i] -= other.bins[c][i];
+    }
+    pixels -= other.pixels;
+}
+
+int Histogram::percentile(Channel c, float fraction) const {
+    Uint64 total = 0;
+    for (int i = 0; i < 256; ++i) total += bins[c][i];
+    if (total == 0) return 0;
+
+    const double target = std::clamp(fraction, 0.0f, 1.0f) * double(total);
+    Uint64 sum = 0;
+    for (int i = 0; i < 256; ++i) {
+        sum += bins[c][i];
+        if (sum > target) return i;
+    }
+    return 255;
+}
+
+int Histogram::minimum(Channel c) const {
+    for (int i = 0; i < 256; ++i) {
+        if (bins[c][i]) return i;
+    }
+    return 0;
+}
+
+int Histogram::maximum(Channel c) const {
+    for (int i = 255; i >= 0; --i) {
+        if (bins[c][i]) return i;
+    }
+    return 0;
+}
+
+float Histogram::mean(Channel c) const {
+    Uint64 total = 0, weighted = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += bins[c][i];
+        weighted += Uint64(bins[c][i]) * i;
+    }
+    return total ? float(double(weighted) / double(total)) : 0.0f;
+}
+
+Uint32 Histogram::peak(Channel c) const {
+    return *std::max_element(bins[c], bins[c] + 256);
+}
+
+int Histogram::otsuThreshold(Channel c) const {
+    double total = 0, sumAll = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += bins[c][i];
+        sumAll += double(i) * bins[c][i];
+    }
+    if (total == 0) return 128;
+
+    // на пустых бинах между классами дисперсия не меняется — берём середину плато
+    double weightBg = 0, sumBg = 0, best = -1.0;
+    int first = 127, last = 127;
+    for (int t = 0; t < 256; ++t) {
+        weightBg += bins[c][t];
+        if (weightBg == 0) continue;
+        double weightFg = total - weightBg;
+        if (weightFg == 0) break;
+        sumBg += double(t) * bins[c][t];
+        double meanBg = sumBg / weightBg;
+        double meanFg = (sumAll - sumBg) / weightFg;
+        double between = weightBg * weightFg * (meanBg - meanFg) * (meanBg - meanFg);
+        if (between > best) {
+            best = between;
+            first = last = t;
+        } else if (between == best) {
+            last = t;
+        }
+    }
+    return (first + last) / 2 + 1;   // пиксели >= порога — передний план
+}
+
+Histogram computeHistogram(SDL_Surface* surface, SDL_Rect area, const SelectionMask* selection) {
+    Histogram result;
+    if (!surface) return result;
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("computeHistogram: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return result;
+    }
+
+    SDL_Rect bounds = { 0, 0, surface->w, surface->h };
+    if (!SDL_GetRectIntersection(&area, &bounds, &area)) return result;
+    const bool clipped = selection && selection->active();
+
+    SDL_LockSurface(surface);
+    const Uint8* pixels = static_cast<const Uint8*>(surface->pixels);
+
+    // Своя частичная гистограмма на каждую полосу — без атомиков и блокировок
+    std::vector<Histogram> partial((area.h + BandRows - 1) / BandRows);
+    parallelFor(0, area.h, BandRows, [&](int from, int to) {
+        Histogram& h = partial[from / BandRows];
+        std::vector<Uint8> coverage(clipped ? area.w : 0);
+        for (int yy = from; yy < to; ++yy) {
+            int y = area.y + yy;
+            if (clipped) selection->readRow(y, area.x, area.w, coverage.data());
+            accumulateRow(h, pixels + y * surface->pitch + area.x * 4, clipped ? coverage.data() : nullptr, area.w);
+        }
+    });
+    SDL_UnlockSurface(surface);
+
+    for (const Histogram& h : partial) result.add(h);
+    return result;
+}
+
+Histogram computeCompositeHistogram(const LayerStack& layers, SDL_Rect area, const SelectionMask* selection) {
+    Histogram result;
+    if (layers.empty() || area.w <= 0 || area.h <= 0) return result;
+    const bool clipped = selection && selection->active();
+    // Рамки объектов строятся здесь, до параллельной растеризации
+    for (const Layer& layer : layers) layer.shapes().bounds();
+
+    std::vector<Histogram> partial((area.h + BandRows - 1) / BandRows);
+    parallelFor(0, area.h, BandRows, [&](int from, int to) {
+        Histogram& h = partial[from / BandRows];
+        const SDL_Rect band = { area.x, area.y + from, area.w, to - from };
+        const int pitch = band.w * 4;
+        std::vector<Uint8> buf(static_cast<size_t>(pitch) * band.h);
+        compositeArea(layers, band, buf.data(), pitch);
+        std::vector<Uint8> coverage(clipped ? area.w : 0);
+        for (int yy = 0; yy < band.h; ++yy) {
+            if (clipped) selection->readRow(band.y + yy, band.x, band.w, coverage.data());
+            accumulateRow(h, &buf[static_cast<size_t>(yy) * pitch], clipped ? coverage.data() : nullptr, band.w);
+        }
+    });
+
+    for (const Histogram& h : partial) result.add(h);
+    return result;
+}
+
+void HistogramCache::reset() {
+    surface = nullptr;
+    tiles.clear();
+    revisions.clear();
+    valid.clear();
+    total = Histogram();
+}
+
+const Histogram& HistogramCache::update(const Layer& layer) {
+    SDL_Surface* s = layer.surface;
+    if (!s || s->format != SDL_PIXELFORMAT_RGBA32) {
+        reset();
+        return total;
+    }
+
+    const int tilesX = (s->w + LayerTileSize - 1) / LayerTileSize;
+    const int tilesY = (s->h + LayerTileSize - 1) / LayerTileSize;
+    if (s != surface || tiles.size() != static_cast<size_t>(tilesX * tilesY)) {
+        reset();
+        surface = s;
+        tiles.resize(tilesX * tilesY);
+        revisions.assign(tilesX * tilesY, 0);
+        valid.assign(tilesX * tilesY, false);
+    }
+
+    std::vector<int> stale;
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (!valid[t] || revisions[t] != layer.tileRevision(t % tilesX, t / tilesX)) stale.push_back(t);
+    }
+    if (stale.empty()) return total;
+
+    for (int t : stale) {
+        if (valid[t]) total.subtract(tiles[t]);
+    }
+
+    SDL_LockSurface(s);
+    parallelFor(0, static_cast<int>(stale.size()), 1, [&](int from, int to) {
+        for (int i = from; i < to; ++i) {
+            int t = stale[i];
+            SDL_Rect rect = { (t % tilesX) * LayerTileSize, (t / tilesX) * LayerTileSize, LayerTileSize, LayerTileSize };
+            SDL_Rect bounds = { 0, 0, s->w, s->h };
+            SDL_GetRectIntersection(&rect, &bounds, &rect);
+            tiles[t] = Histogram();
+            accumulateArea(tiles[t], s, rect);
+        }
+    });
+    SDL_UnlockSurface(s);
+
+    for (int t : stale) {
+        total.add(tiles[t]);
+        revisions[t] = layer.tileRevision(t % tilesX, t / tilesX);
+        valid[t] = true;
+    }
+    return total;
+}
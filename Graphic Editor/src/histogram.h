@@ -0,0 +1,52 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include "layerstack.h"
+#include "selection.h"
+
+// Гистограммы R, G, B, яркости (Rec. 709) и альфы. Полностью прозрачные
+// пиксели в цветовые каналы и яркость не попадают.
+struct Histogram {
+    enum Channel { Red, Green, Blue, Luma, Alpha, ChannelCount };
+
+    Uint32 bins[ChannelCount][256] = {};
+    Uint64 pixels = 0;   // непрозрачных пикселей (сумма по любому цветовому каналу)
+
+    void add(const Histogram& other);
+    void subtract(const Histogram& other);
+
+    // Наименьшее значение, ниже которого лежит доля fraction пикселей канала
+    int percentile(Channel c, float fraction) const;
+    // Наименьшее и наибольшее значение канала (0, если пикселей нет)
+    int minimum(Channel c) const;
+    int maximum(Channel c) const;
+    float mean(Channel c) const;
+    Uint32 peak(Channel c) const;
+    // Порог Оцу: лучше всего делит канал на два класса
+    int otsuThreshold(Channel c) const;
+};
+
+// Гистограмма области слоя RGBA32; с активным выделением учитываются пиксели
+// с покрытием от 50%. Полосы строк считаются в частичные гистограммы на всех ядрах
+// и складываются в конце.
+Histogram computeHistogram(SDL_Surface* surface, SDL_Rect area, const SelectionMask* selection = nullptr);
+
+// Гистограмма видимого изображения (все слои, см. compositeArea) в области area.
+// Полосы строк сводятся и считаются на всех ядрах, альфа всегда 255.
+Histogram computeCompositeHistogram(const LayerStack& layers, SDL_Rect area,
+                                    const SelectionMask* selection = nullptr);
+
+// Гистограмма всего слоя, обновляемая по тайлам: пересчитываются только тайлы,
+// ревизия которых изменилась с прошлого вызова (старая часть вычитается, новая прибавляется)
+class HistogramCache {
+public:
+    const Histogram& update(const Layer& layer);
+    void reset();
+
+private:
+    const SDL_Surface* surface = nullptr;
+    std::vector<Histogram> tiles;
+    std::vector<Uint32> revisions;
+    std::vector<bool> valid;
+    Histogram total;
+};
@@ -0,0 +1,271 @@
+#include "jobs.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+namespace {
+
+struct Task {
+    TaskGroupPtr group;            // nullptr — задача без группы
+    std::function<void()> run;
+};
+
+// Очереди одного потока, по приоритетам
+struct WorkerQueues {
+    std::mutex mutex;
+    std::deque<Task> tasks[3];
+};
+
+thread_local int currentWorker = -1;
+
+}
+
+class JobQueue {
+public:
+    static JobQueue& instance() {
+        static JobQueue queue;
+        return queue;
+    }
+
+    JobQueue() {
+        // Вызывающий поток тоже работает внутри parallelFor — фоновых на один меньше
+        const int threads = std::max(1, workerCount() - 1);
+        for (int i = 0; i < threads; ++i) workers.push_back(std::make_unique<WorkerQueues>());
+        for (int i = 0; i < threads; ++i) pool.emplace_back([this, i] { workerLoop(i); });
+        eventType = SDL_RegisterEvents(1);
+    }
+
+    ~JobQueue() { shutdown(); }
+
+    void push(JobPriority priority, Task task) {
+        if (stopped) {
+            // после остановки пула — синхронно
+            execute(task);
+            return;
+        }
+        int index = currentWorker >= 0 ? currentWorker
+                                       : static_cast<int>(nextWorker++ % workers.size());
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->tasks[static_cast<int>(priority)].push_back(std::move(task));
+        }
+        ++queued;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        sleepCv.notify_one();
+    }
+
+    // Выполняет одну задачу группы из любой очереди; false — в очередях их нет
+    bool runOneOf(const TaskGroup* group) {
+        for (auto& w : workers) {
+            Task task;
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+                for (auto& q : w->tasks) {
+                    auto it = std::find_if(q.begin(), q.end(), [group](const Task& t) { return t.group.get() == group; });
+                    if (it != q.end()) {
+                        task = std::move(*it);
+                        q.erase(it);
+                        break;
+                    }
+                }
+            }
+            if (task.run) {
+                --queued;
+                execute(task);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void registerGroup(const TaskGroupPtr& group) {
+        std::lock_guard<std::mutex> lock(groupsMutex);
+        groups.push_back(group);
+    }
+
+    std::vector<TaskGroupPtr> active() {
+        std::lock_guard<std::mutex> lock(groupsMutex);
+        std::vector<TaskGroupPtr> result;
+        groups.erase(std::remove_if(groups.begin(), groups.end(), [&](const std::weak_ptr<TaskGroup>& weak) {
+            TaskGroupPtr g = weak.lock();
+            if (!g || g->finished()) return true;
+            result.push_back(g);
+            return false;
+        }), groups.end());
+        return result;
+    }
+
+    void shutdown() {
+        if (stopped) return;
+        for (const TaskGroupPtr& g : active()) g->cancel();
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+        for (auto& t : pool) t.join();
+        pool.clear();
+        stopped = true;
+        // оставшиеся задачи (отменённые группы пропустят работу) — здесь же
+        while (runAny()) {}
+    }
+
+    Uint32 eventType = 0;
+
+private:
+    static void execute(Task& task) {
+        if (!task.group || !task.group->cancelled()) task.run();
+        if (task.group) task.group->taskDone(task.group);
+    }
+
+    // Своя очередь — с начала (в порядке постановки), чужие — с конца; по приоритетам
+    bool take(int self, Task& task) {
+        const int n = static_cast<int>(workers.size());
+        for (int p = 0; p < 3; ++p) {
+            for (int k = 0; k < n; ++k) {
+                WorkerQueues& w = *workers[(self + k) % n];
+                std::lock_guard<std::mutex> lock(w.mutex);
+                std::deque<Task>& q = w.tasks[p];
+                if (q.empty()) continue;
+                if (k == 0) {
+                    task = std::move(q.front());
+                    q.pop_front();
+                } else {
+                    task = std::move(q.back());
+                    q.pop_back();
+                }
+                --queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runAny() {
+        Task task;
+        if (!take(0, task)) return false;
+        execute(task);
+        return true;
+    }
+
+    void workerLoop(int index) {
+        currentWorker = index;
+        while (true) {
+            Task task;
+            if (take(index, task)) {
+                execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCv.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueues>> workers;
+    std::vector<std::thread> pool;
+    std::atomic<unsigned> nextWorker{ 0 };
+    std::atomic<int> queued{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;
+    std::atomic<bool> stopped{ false };
+
+    std::mutex groupsMutex;
+    std::vector<std::weak_ptr<TaskGroup>> groups;
+};
+
+float TaskGroup::progress() const {
+    int total = total_;
+    return total > 0 ? std::min(1.0f, float(done_) / total) : 0.0f;
+}
+
+void TaskGroup::wait() {
+    while (pending_ > 0) {
+        if (JobQueue::instance().runOneOf(this)) continue;
+        std::unique_lock<std::mutex> lock(waitMutex_);
+        waitCv_.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending_ == 0; });
+    }
+}
+
+void TaskGroup::taskDone(const std::shared_ptr<TaskGroup>& self) {
+    if (--pending_ == 0) {
+        {
+            std::lock_guard<std::mutex> lock(waitMutex_);
+        }
+        waitCv_.notify_all();
+        if (sealed_) complete(self);
+    }
+}
+
+void TaskGroup::complete(const std::shared_ptr<TaskGroup>& self) {
+    if (completed_.exchange(true)) return;
+    if (!onComplete_) {
+        finished_ = true;
+        return;
+    }
+
+    // В поток UI — через очередь событий SDL
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = JobQueue::instance().eventType;
+    e.user.data1 = new TaskGroupPtr(self);
+    if (e.type == 0 || !SDL_PushEvent(&e)) {
+        SDL_Log("TaskGroup '%s': cannot deliver completion: %s", name_.c_str(), SDL_GetError());
+        delete static_cast<TaskGroupPtr*>(e.user.data1);
+        finished_ = true;
+    }
+}
+
+TaskGroupPtr createTaskGroup(const std::string& name, JobPriority priority) {
+    auto group = std::make_shared<TaskGroup>(name, priority);
+    JobQueue::instance().registerGroup(group);
+    return group;
+}
+
+void submitTask(const TaskGroupPtr& group, std::function<void(TaskGroup&)> task) {
+    ++group->pending_;
+    TaskGroup* g = group.get();
+    JobQueue::instance().push(group->priority(), Task{ group, [g, task = std::move(task)] { task(*g); } });
+}
+
+void finishTaskGroup(const TaskGroupPtr& group, std::function<void(TaskGroup&)> onComplete) {
+    group->onComplete_ = std::move(onComplete);
+    group->sealed_ = true;
+    if (group->pending_ == 0) group->complete(group);
+}
+
+void submitDetached(JobPriority priority, std::function<void()> task) {
+    JobQueue::instance().push(priority, Task{ nullptr, std::move(task) });
+}
+
+Uint32 jobCompletionEvent() {
+    return JobQueue::instance().eventType;
+}
+
+bool dispatchJobEvent(const SDL_Event& e) {
+    if (e.type == 0 || e.type != JobQueue::instance().eventType) return false;
+    auto* holder = static_cast<TaskGroupPtr*>(e.user.data1);
+    if (!holder) return true;
+    TaskGroupPtr group = *holder;
+    delete holder;
+    if (group->onComplete_) {
+        auto onComplete = std::move(group->onComplete_);
+        group->onComplete_ = nullptr;
+        onComplete(*group);
+    }
+    group->finished_ = true;
+    return true;
+}
+
+std::vector<TaskGroupPtr> activeTaskGroups() {
+    return JobQueue::instance().active();
+}
+
+void shutdownJobs() {
+    JobQueue::instance().shutdown();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Общий пул потоков с перехватом работы: у каждого потока своя очередь по
+// приоритетам, свободный поток забирает задачи из чужих очередей.
+// Всё тяжёлое (загрузка, сохранение, фильтры, композитинг, автосохранение) идёт через него.
+
+enum class JobPriority {
+    High,        // parallelFor: кто-то ждёт результата прямо сейчас
+    Normal,      // фоновые операции, результат которых пользователь ждёт
+    Background   // автосохранение и прочее, что может подождать
+};
+
+// Группа задач одной операции: общий флаг отмены, прогресс и завершение.
+// Когда группа закрыта (finishTaskGroup) и все её задачи выполнены, onComplete
+// вызывается в потоке UI из обработчика событий (dispatchJobEvent).
+class TaskGroup {
+public:
+    TaskGroup(std::string name, JobPriority priority) : name_(std::move(name)), priority_(priority) {}
+
+    const std::string& name() const { return name_; }
+    JobPriority priority() const { return priority_; }
+
+    // Отменённая группа не запускает оставшиеся задачи; уже идущие проверяют cancelled() сами
+    void cancel() { cancelled_ = true; }
+    bool cancelled() const { return cancelled_; }
+
+    // Прогресс в условных единицах работы
+    void addWork(int units) { total_ += units; }
+    void advance(int units = 1) { done_ += units; }
+    float progress() const;
+    bool hasProgress() const { return total_ > 0; }
+
+    // Задачи выполнены и onComplete уже отработал в потоке UI (результат применён)
+    bool finished() const { return finished_; }
+    // Ждёт окончания всех задач группы, выполняя их в вызывающем потоке, если они ещё в очереди
+    void wait();
+
+private:
+    friend class JobQueue;
+    friend void submitTask(const std::shared_ptr<TaskGroup>&, std::function<void(TaskGroup&)>);
+    friend void finishTaskGroup(const std::shared_ptr<TaskGroup>&, std::function<void(TaskGroup&)>);
+    friend bool dispatchJobEvent(const SDL_Event&);
+
+    void taskDone(const std::shared_ptr<TaskGroup>& self);
+    void complete(const std::shared_ptr<TaskGroup>& self);
+
+    std::string name_;
+    JobPriority priority_;
+    std::atomic<bool> cancelled_{ false };
+    std::atomic<bool> sealed_{ false };
+    std::atomic<bool> completed_{ false };   // задачи выполнены, завершение отправлено
+    std::atomic<bool> finished_{ false };    // и обработано
+    std::atomic<int> pending_{ 0 };
+    std::atomic<int> total_{ 0 };
+    std::atomic<int> done_{ 0 };
+    std::function<void(TaskGroup&)> onComplete_;
+    std::mutex waitMutex_;
+    std::condition_variable waitCv_;
+};
+
+using TaskGroupPtr = std::shared_ptr<TaskGroup>;
+
+TaskGroupPtr createTaskGroup(const std::string& name, JobPriority priority = JobPriority::Normal);
+// Ставит задачу группы в очередь (из любого потока)
+void submitTask(const TaskGroupPtr& group, std::function<void(TaskGroup&)> task);
+// Больше задач не будет; onComplete выполнится в потоке UI после последней задачи
+void finishTaskGroup(const TaskGroupPtr& group, std::function<void(TaskGroup&)> onComplete = {});
+// Задача без группы (для parallelFor)
+void submitDetached(JobPriority priority, std::function<void()> task);
+
+// Тип пользовательского события SDL, которым доставляются завершения
+Uint32 jobCompletionEvent();
+// Вызывает onComplete группы, если это событие завершения; true — событие обработано
+bool dispatchJobEvent(const SDL_Event& e);
+
+// Незавершённые группы (для индикатора прогресса)
+std::vector<TaskGroupPtr> activeTaskGroups();
+// Отменяет все группы и останавливает потоки (при выходе)
+void shutdownJobs();
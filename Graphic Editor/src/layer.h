@@ -1,27 +1,183 @@
 #pragma once
+#include <atomic>
 #include <vector>
 #include <string>
+#include <memory>
 #include "types.h"
+#include "objects.h"
+#include "pool.h"
+
+class Adjustment;
+struct LayerThumbnail;
+struct TileSnapshot;
+
+constexpr int LayerTileSize = 256;   // шаг сетки ревизий и кэша корректирующих слоёв
+
+// Владелец surface слоя. Копия слоя и история отмены делят один surface через
+// shared_ptr: его счётчик атомарный, так что shared() надёжно решает, нужна ли
+// копия перед записью. Присваивание SDL_Surface* забирает владение.
+class SharedSurface {
+public:
+    SharedSurface() = default;
+    SharedSurface(SDL_Surface* surface) { reset(surface); }
+    SharedSurface& operator=(SDL_Surface* surface) {
+        reset(surface);
+        return *this;
+    }
+
+    void reset(SDL_Surface* surface = nullptr) {
+        if (surface) {
+            owner.reset(surface, SDL_DestroySurface);
+        } else {
+            owner.reset();
+        }
+    }
+
+    SDL_Surface* get() const { return owner.get(); }
+    operator SDL_Surface*() const { return owner.get(); }
+    SDL_Surface* operator->() const { return owner.get(); }
+
+    bool shared() const {
+        if (owner.use_count() > 1) return true;
+        // Чужие ссылки уже отпущены: их чтения пикселей завершены до нашей записи
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return false;
+    }
+
+private:
+    std::shared_ptr<SDL_Surface> owner;
+};
 
 struct Layer {
-    std::vector<Rect> rects;
-    std::vector<BrushStroke> strokes;
-    std::vector<Drawable*> objects;
+    // Прямоугольники и отпечатки штрихов; общие с копиями слоя до первого изменения
+    std::shared_ptr<ObjectStore> shapeStore = std::make_shared<ObjectStore>();
+    std::vector<DrawableHandle> objects;   // объекты в пуле drawables, слой ими владеет
+    DrawablePool* drawables = nullptr;
     int canvasWidth = 0;
     int canvasHeight = 0;
     bool visible = true;
     std::string name;
 
-    SDL_Surface* surface = nullptr;
+    // surface может быть общим с копией слоя или отменённым дублированием:
+    // писать в пиксели можно только через writableSurface()
+    SharedSurface surface;
+    Uint32 surfaceGeneration = 0;   // растёт, когда surface подменяют целиком (размер, поворот)
     SDL_Texture* texture = nullptr;
     bool surfFlag = false;
 
+    std::shared_ptr<Adjustment> adjustment;   // не пусто — корректирующий слой
+    std::shared_ptr<LayerThumbnail> thumbnail; // миниатюра для панели слоёв (создаётся лениво)
+
+    // Счётчик изменений пикселей по тайлам LayerTileSize x LayerTileSize
+    Uint32 revision = 0;
+    std::vector<Uint32> tileRevisions;
+    // Последний снимок пикселей (tiles.h), пока его держит хоть одна задача:
+    // следующий снимок берёт из него неизменённые тайлы. Слой сам снимок не
+    // держит, иначе каждый слой хранился бы в памяти дважды.
+    std::weak_ptr<const TileSnapshot> tiles;
+
+    const ObjectStore& shapes() const { return *shapeStore; }
+
+    // Объекты для изменения: общий с копией слоя набор сначала копируется.
+    // Дескрипторы объектов в копии остаются прежними.
+    ObjectStore& editShapes() {
+        if (shapeStore.use_count() > 1) shapeStore = std::make_shared<ObjectStore>(*shapeStore);
+        return *shapeStore;
+    }
+
+    // Пиксели для записи: общий surface сначала копируется — целиком, а не по
+    // тайлам, поэтому первая запись в копию слоя (первый мазок после
+    // дублирования) стоит времени и памяти на весь слой
+    SDL_Surface* writableSurface() {
+        if (surface && surface.shared()) {
+            SDL_Surface* own = SDL_DuplicateSurface(surface);
+            if (!own) {
+                SDL_Log("Layer: SDL_DuplicateSurface failed: %s", SDL_GetError());
+                return nullptr;
+            }
+            surface = own;
+        }
+        return surface;
+    }
+
+    void markDirty(const SDL_Rect* area = nullptr) {
+        int tilesX = (canvasWidth + LayerTileSize - 1) / LayerTileSize;
+        int tilesY = (canvasHeight + LayerTileSize - 1) / LayerTileSize;
+        if (tileRevisions.size() != static_cast<size_t>(tilesX * tilesY)) {
+            tileRevisions.assign(tilesX * tilesY, revision);
+        }
+        ++revision;
+
+        int tx0 = 0, ty0 = 0, tx1 = tilesX, ty1 = tilesY;
+        if (area) {
+            tx0 = SDL_max(0, area->x / LayerTileSize);
+            ty0 = SDL_max(0, area->y / LayerTileSize);
+            tx1 = SDL_min(tilesX, (area->x + area->w + LayerTileSize - 1) / LayerTileSize);
+            ty1 = SDL_min(tilesY, (area->y + area->h + LayerTileSize - 1) / LayerTileSize);
+        }
+        for (int ty = ty0; ty < ty1; ++ty) {
+            for (int tx = tx0; tx < tx1; ++tx) {
+                tileRevisions[ty * tilesX + tx] = revision;
+            }
+        }
+    }
+
+    Uint32 tileRevision(int tx, int ty) const {
+        int tilesX = (canvasWidth + LayerTileSize - 1) / LayerTileSize;
+        size_t i = static_cast<size_t>(ty) * tilesX + tx;
+        return i < tileRevisions.size() ? tileRevisions[i] : revision;
+    }
+
+    ObjectHandle addRect(const Rect& r) {
+        return editShapes().add(ObjectType::Rect, SDL_FRect{ float(r.rect.x), float(r.rect.y), float(r.rect.w), float(r.rect.h) }, r.color);
+    }
+
+    // Слой владеет surface, texture и объектами, поэтому только перемещается:
+    // копия освободила бы их второй раз
     Layer() = default;
-    Layer(const Layer&) = default;
-    Layer& operator=(const Layer&) = default;
+    Layer(const Layer&) = delete;
+    Layer& operator=(const Layer&) = delete;
+    Layer(Layer&& o) noexcept { moveFrom(o); }
+    Layer& operator=(Layer&& o) noexcept {
+        if (this != &o) {
+            releaseResources();
+            moveFrom(o);
+        }
+        return *this;
+    }
 
-    ~Layer() {
-        if (surface) SDL_DestroySurface(surface);
+    ~Layer() { releaseResources(); }
+
+private:
+    void releaseResources() {
+        if (drawables) {
+            for (DrawableHandle h : objects) drawables->release(h);
+        }
+        objects.clear();
         if (texture) SDL_DestroyTexture(texture);
+        surface.reset();
+        texture = nullptr;
+    }
+
+    void moveFrom(Layer& o) {
+        shapeStore = std::move(o.shapeStore);
+        objects = std::move(o.objects);
+        drawables = o.drawables;
+        canvasWidth = o.canvasWidth;
+        canvasHeight = o.canvasHeight;
+        visible = o.visible;
+        name = std::move(o.name);
+        surface = std::move(o.surface);
+        surfaceGeneration = o.surfaceGeneration;
+        texture = o.texture;
+        surfFlag = o.surfFlag;
+        adjustment = std::move(o.adjustment);
+        thumbnail = std::move(o.thumbnail);
+        revision = o.revision;
+        tileRevisions = std::move(o.tileRevisions);
+        tiles = std::move(o.tiles);
+        o.objects.clear();
+        o.surface.reset();
+        o.texture = nullptr;
     }
 };
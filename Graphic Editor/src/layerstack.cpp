@@ -0,0 +1,49 @@
+#include "layerstack.h"
+
+int LayerStack::indexOf(LayerId id) const {
+    auto it = positions.find(id);
+    return it != positions.end() ? it->second : -1;
+}
+
+void LayerStack::reindex(int from) {
+    for (size_t i = from; i < order.size(); ++i) positions[order[i].id] = static_cast<int>(i);
+}
+
+Layer* LayerStack::find(LayerId id) {
+    auto it = registry.find(id);
+    return it != registry.end() ? it->second.get() : nullptr;
+}
+
+LayerId LayerStack::insert(int pos, Layer&& layer, LayerId id) {
+    if (id == NoLayer || registry.count(id)) id = ++lastId;
+    pos = SDL_clamp(pos, 0, static_cast<int>(order.size()));
+    auto owned = std::make_unique<Layer>(std::move(layer));
+    order.insert(order.begin() + pos, Slot{ id, owned.get() });
+    registry.emplace(id, std::move(owned));
+    reindex(pos);
+    return id;
+}
+
+void LayerStack::erase(int first, int last) {
+    if (first < 0) first = 0;
+    if (last > static_cast<int>(order.size())) last = static_cast<int>(order.size());
+    if (first >= last) return;
+    for (int i = first; i < last; ++i) {
+        registry.erase(order[i].id);
+        positions.erase(order[i].id);
+    }
+    order.erase(order.begin() + first, order.begin() + last);
+    reindex(first);
+}
+
+void LayerStack::swap(int a, int b) {
+    std::swap(order[a], order[b]);
+    positions[order[a].id] = a;
+    positions[order[b].id] = b;
+}
+
+void LayerStack::clear() {
+    order.clear();
+    positions.clear();
+    registry.clear();
+}
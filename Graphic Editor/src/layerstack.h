@@ -0,0 +1,71 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "layer.h"
+
+// Постоянный номер слоя: не меняется при перестановке и удалении других слоёв
+// и не используется повторно. 0 — нет слоя.
+using LayerId = Uint32;
+constexpr LayerId NoLayer = 0;
+
+// Стопка слоёв. Сами слои лежат в реестре по номеру и никогда не перемещаются
+// в памяти; порядок отрисовки задаётся массивом (номер, указатель) снизу вверх.
+// Перестановка меняет два элемента порядка, удаление сдвигает только этот
+// массив — стоимость не зависит от содержимого слоёв. Позиции слоёв по номеру
+// хранятся отдельно, чтобы indexOf не перебирал стопку.
+class LayerStack {
+public:
+    LayerStack() = default;
+    LayerStack(const LayerStack&) = delete;
+    LayerStack& operator=(const LayerStack&) = delete;
+
+    size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+
+    // Доступ по позиции 0..size()-1 (0 — нижний слой)
+    Layer& operator[](int pos) { return *order[pos].layer; }
+    const Layer& operator[](int pos) const { return *order[pos].layer; }
+    LayerId idAt(int pos) const { return order[pos].id; }
+
+    // Позиция слоя или -1, если его нет (удалён); O(1)
+    int indexOf(LayerId id) const;
+    Layer* find(LayerId id);
+
+    // Кладёт слой наверх; возвращает его номер
+    LayerId push_back(Layer&& layer) { return insert(static_cast<int>(order.size()), std::move(layer)); }
+    // Вставляет слой на позицию pos; id — номер удалённого ранее слоя, который
+    // возвращается (отмена удаления), иначе слою выдаётся новый
+    LayerId insert(int pos, Layer&& layer, LayerId id = NoLayer);
+    void erase(int pos) { erase(pos, pos + 1); }
+    void erase(int first, int last);   // позиции [first, last)
+    void swap(int a, int b);
+    void clear();
+
+    // Обход снизу вверх: for (const Layer& layer : layers)
+    template <typename Entry, typename L>
+    struct Iterator {
+        Entry* it;
+        L& operator*() const { return *it->layer; }
+        Iterator& operator++() { ++it; return *this; }
+        bool operator!=(const Iterator& o) const { return it != o.it; }
+    };
+    struct Slot {
+        LayerId id;
+        Layer* layer;
+    };
+    Iterator<Slot, Layer> begin() { return { order.data() }; }
+    Iterator<Slot, Layer> end() { return { order.data() + order.size() }; }
+    Iterator<const Slot, const Layer> begin() const { return { order.data() }; }
+    Iterator<const Slot, const Layer> end() const { return { order.data() + order.size() }; }
+
+private:
+    std::unordered_map<LayerId, std::unique_ptr<Layer>> registry;
+    std::vector<Slot> order;
+    std::unordered_map<LayerId, int> positions;   // номер -> позиция в order
+    LayerId lastId = NoLayer;
+
+    // Пересчитывает позиции слоёв начиная с from
+    void reindex(int from);
+};
@@ -0,0 +1,301 @@
+#include "lut.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr float Pi = 3.14159265358979f;
+
+// Сдвиг байта k пикселя RGBA32 внутри Uint32
+constexpr int byteShift(int k) {
+    return SDL_BYTEORDER == SDL_LIL_ENDIAN ? 8 * k : 24 - 8 * k;
+}
+
+// Таблицы сразу со сдвигом на место канала: пиксель собирается тремя
+// выборками и OR без побайтовых записей
+struct PackedLut {
+    Uint32 channel[3][256];
+    Uint32 alphaMask;
+
+    explicit PackedLut(const ColorLut& lut) {
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < 256; ++i) {
+                channel[c][i] = static_cast<Uint32>(lut.table[c][i]) << byteShift(c);
+            }
+        }
+        alphaMask = 0xFFu << byteShift(3);
+    }
+
+    void apply(const Uint32* src, Uint32* dst, int n) const {
+        const int s1 = byteShift(0), s2 = byteShift(1), s3 = byteShift(2);
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            Uint32 p0 = src[i], p1 = src[i + 1], p2 = src[i + 2], p3 = src[i + 3];
+            dst[i]     = channel[0][(p0 >> s1) & 255] | channel[1][(p0 >> s2) & 255] | channel[2][(p0 >> s3) & 255] | (p0 & alphaMask);
+            dst[i + 1] = channel[0][(p1 >> s1) & 255] | channel[1][(p1 >> s2) & 255] | channel[2][(p1 >> s3) & 255] | (p1 & alphaMask);
+            dst[i + 2] = channel[0][(p2 >> s1) & 255] | channel[1][(p2 >> s2) & 255] | channel[2][(p2 >> s3) & 255] | (p2 & alphaMask);
+            dst[i + 3] = channel[0][(p3 >> s1) & 255] | channel[1][(p3 >> s2) & 255] | channel[2][(p3 >> s3) & 255] | (p3 & alphaMask);
+        }
+        for (; i < n; ++i) {
+            Uint32 p = src[i];
+            dst[i] = channel[0][(p >> s1) & 255] | channel[1][(p >> s2) & 255] | channel[2][(p >> s3) & 255] | (p & alphaMask);
+        }
+    }
+};
+
+// dst = dst + (mapped - dst) * coverage / 255, покрытие — байт на пиксель
+void blendCoverage(Uint8* dst, const Uint8* mapped, const Uint8* coverage, int n) {
+    int x = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    for (; x + 4 <= n; x += 4) {
+        Uint32 c4;
+        SDL_memcpy(&c4, coverage + x, 4);
+        __m128i c = _mm_cvtsi32_si128(static_cast<int>(c4));
+        c = _mm_unpacklo_epi8(c, c);
+        c = _mm_unpacklo_epi16(c, c);       // покрытие каждого пикселя на все 4 байта
+        __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + x * 4));
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mapped + x * 4));
+
+        __m128i cLo = _mm_unpacklo_epi8(c, zero), cHi = _mm_unpackhi_epi8(c, zero);
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(o, zero), _mm_sub_epi16(full, cLo)),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(m, zero), cLo)), half);
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(o, zero), _mm_sub_epi16(full, cHi)),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(m, zero), cHi)), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; x + 4 <= n; x += 4) {
+        Uint32 c4;
+        SDL_memcpy(&c4, coverage + x, 4);
+        uint32x4_t cw = vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(c4))));
+        uint8x16_t c = vreinterpretq_u8_u32(vmulq_n_u32(cw, 0x01010101u));
+        uint8x16_t ic = vmvnq_u8(c);
+        uint8x16_t o = vld1q_u8(dst + x * 4);
+        uint8x16_t m = vld1q_u8(mapped + x * 4);
+
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(o), vget_low_u8(ic)), vget_low_u8(m), vget_low_u8(c));
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(o), vget_high_u8(ic)), vget_high_u8(m), vget_high_u8(c));
+        lo = vaddq_u16(lo, vdupq_n_u16(128));
+        hi = vaddq_u16(hi, vdupq_n_u16(128));
+        vst1q_u8(dst + x * 4, vcombine_u8(vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8),
+                                          vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8)));
+    }
+#endif
+    for (; x < n; ++x) {
+        int c = coverage[x];
+        for (int k = 0; k < 4; ++k) {
+            int v = dst[x * 4 + k] * (255 - c) + mapped[x * 4 + k] * c + 128;
+            dst[x * 4 + k] = static_cast<Uint8>((v + (v >> 8)) >> 8);
+        }
+    }
+}
+
+ColorLut fromCurve(float (*fn)(float, const float*), const float* args) {
+    ColorLut lut;
+    for (int i = 0; i < 256; ++i) {
+        float v = fn(i / 255.0f, args);
+        Uint8 b = static_cast<Uint8>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+        lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = b;
+    }
+    return lut;
+}
+
+}
+
+ColorLut ColorLut::identity() {
+    ColorLut lut;
+    for (int i = 0; i < 256; ++i) {
+        lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = static_cast<Uint8>(i);
+    }
+    return lut;
+}
+
+ColorLut ColorLut::brightnessContrast(float brightness, float contrast) {
+    // Как в GIMP: яркость тянет к белому или чёрному, контраст — наклон вокруг 0.5
+    float args[2] = {
+        std::clamp(brightness, -100.0f, 100.0f) / 100.0f,
+        tanf((std::clamp(contrast, -100.0f, 100.0f) / 100.0f + 1.0f) * Pi / 4.0f)
+    };
+    return fromCurve([](float v, const float* a) {
+        v = a[0] < 0.0f ? v * (1.0f + a[0]) : v + (1.0f - v) * a[0];
+        return (v - 0.5f) * a[1] + 0.5f;
+    }, args);
+}
+
+ColorLut ColorLut::levels(int inBlack, int inWhite, float gamma, int outBlack, int outWhite) {
+    float args[5] = {
+        inBlack / 255.0f,
+        std::max(1, inWhite - inBlack) / 255.0f,
+        1.0f / std::max(0.01f, gamma),
+        outBlack / 255.0f,
+        (outWhite - outBlack) / 255.0f
+    };
+    return fromCurve([](float v, const float* a) {
+        v = std::clamp((v - a[0]) / a[1], 0.0f, 1.0f);
+        return a[3] + powf(v, a[2]) * a[4];
+    }, args);
+}
+
+ColorLut ColorLut::curves(const std::vector<SDL_Point>& points) {
+    // Монотонная кубическая интерполяция (Fritsch–Carlson): без выбросов между точками
+    std::vector<SDL_Point> pts = points;
+    for (SDL_Point& p : pts) {
+        p.x = std::clamp(p.x, 0, 255);
+        p.y = std::clamp(p.y, 0, 255);
+    }
+    std::sort(pts.begin(), pts.end(), [](const SDL_Point& a, const SDL_Point& b) { return a.x < b.x; });
+    pts.erase(std::unique(pts.begin(), pts.end(),
+                          [](const SDL_Point& a, const SDL_Point& b) { return a.x == b.x; }), pts.end());
+    if (pts.size() < 2) {
+        ColorLut lut = identity();
+        if (!pts.empty()) {
+            for (int i = 0; i < 256; ++i) lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = static_cast<Uint8>(pts[0].y);
+        }
+        return lut;
+    }
+
+    const size_t n = pts.size();
+    std::vector<float> slope(n - 1), tangent(n);
+    for (size_t i = 0; i + 1 < n; ++i) {
+        slope[i] = float(pts[i + 1].y - pts[i].y) / float(pts[i + 1].x - pts[i].x);
+    }
+    tangent[0] = slope[0];
+    tangent[n - 1] = slope[n - 2];
+    for (size_t i = 1; i + 1 < n; ++i) {
+        tangent[i] = slope[i - 1] * slope[i] <= 0.0f ? 0.0f : (slope[i - 1] + slope[i]) * 0.5f;
+    }
+    for (size_t i = 0; i + 1 < n; ++i) {
+        if (slope[i] == 0.0f) {
+            tangent[i] = tangent[i + 1] = 0.0f;
+            continue;
+        }
+        float a = tangent[i] / slope[i], b = tangent[i + 1] / slope[i];
+        float len = a * a + b * b;
+        if (len > 9.0f) {
+            float k = 3.0f / sqrtf(len);
+            tangent[i] = k * a * slope[i];
+            tangent[i + 1] = k * b * slope[i];
+        }
+    }
+
+    ColorLut lut;
+    size_t seg = 0;
+    for (int x = 0; x < 256; ++x) {
+        float y;
+        if (x <= pts[0].x) {
+            y = float(pts[0].y);
+        } else if (x >= pts[n - 1].x) {
+            y = float(pts[n - 1].y);
+        } else {
+            while (x > pts[seg + 1].x) ++seg;
+            float h = float(pts[seg + 1].x - pts[seg].x);
+            float t = (x - pts[seg].x) / h;
+            float t2 = t * t, t3 = t2 * t;
+            y = (2 * t3 - 3 * t2 + 1) * pts[seg].y + (t3 - 2 * t2 + t) * h * tangent[seg] +
+                (-2 * t3 + 3 * t2) * pts[seg + 1].y + (t3 - t2) * h * tangent[seg + 1];
+        }
+        Uint8 b = static_cast<Uint8>(std::clamp(y + 0.5f, 0.0f, 255.0f));
+        lut.table[0][x] = lut.table[1][x] = lut.table[2][x] = b;
+    }
+    return lut;
+}
+
+ColorLut ColorLut::invert() {
+    ColorLut lut;
+    for (int i = 0; i < 256; ++i) {
+        lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = static_cast<Uint8>(255 - i);
+    }
+    return lut;
+}
+
+ColorLut ColorLut::posterize(int levels) {
+    levels = std::clamp(levels, 2, 255);
+    ColorLut lut;
+    for (int i = 0; i < 256; ++i) {
+        int step = (i * (levels - 1) + 127) / 255;
+        Uint8 b = static_cast<Uint8>((step * 255 + (levels - 1) / 2) / (levels - 1));
+        lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = b;
+    }
+    return lut;
+}
+
+ColorLut ColorLut::threshold(int level) {
+    ColorLut lut;
+    for (int i = 0; i < 256; ++i) {
+        lut.table[0][i] = lut.table[1][i] = lut.table[2][i] = i >= level ? 255 : 0;
+    }
+    return lut;
+}
+
+ColorLut ColorLut::then(const ColorLut& next) const {
+    ColorLut lut;
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < 256; ++i) {
+            lut.table[c][i] = next.table[c][table[c][i]];
+        }
+    }
+    return lut;
+}
+
+bool ColorLut::isIdentity() const {
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < 256; ++i) {
+            if (table[c][i] != i) return false;
+        }
+    }
+    return true;
+}
+
+void applyLut(Uint8* pixels, int w, int h, int pitch, const ColorLut& lut) {
+    const PackedLut packed(lut);
+    for (int y = 0; y < h; ++y) {
+        Uint32* row = reinterpret_cast<Uint32*>(pixels + y * pitch);
+        packed.apply(row, row, w);
+    }
+}
+
+SDL_Rect applyLut(SDL_Surface* surface, const ColorLut& lut, const SelectionMask* selection) {
+    if (!surface) return SDL_Rect{0, 0, 0, 0};
+    if (surface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("applyLut: unsupported pixel format %s", SDL_GetPixelFormatName(surface->format));
+        return SDL_Rect{0, 0, 0, 0};
+    }
+
+    bool clipped = selection && selection->active();
+    SDL_Rect area = clipped ? selection->clipRect(surface->w, surface->h)
+                            : SDL_Rect{0, 0, surface->w, surface->h};
+    if (SDL_RectEmpty(&area) || lut.isIdentity()) return SDL_Rect{0, 0, 0, 0};
+
+    const PackedLut packed(lut);
+    SDL_LockSurface(surface);
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+
+    parallelFor(0, area.h, 64, [&](int from, int to) {
+        std::vector<Uint32> mapped(clipped ? area.w : 0);
+        std::vector<Uint8> coverage(clipped ? area.w : 0);
+        for (int yy = from; yy < to; ++yy) {
+            int y = area.y + yy;
+            Uint32* row = reinterpret_cast<Uint32*>(pixels + y * surface->pitch) + area.x;
+            if (!clipped) {
+                packed.apply(row, row, area.w);
+                continue;
+            }
+            selection->readRow(y, area.x, area.w, coverage.data());
+            packed.apply(row, mapped.data(), area.w);
+            blendCoverage(reinterpret_cast<Uint8*>(row), reinterpret_cast<const Uint8*>(mapped.data()),
+                          coverage.data(), area.w);
+        }
+    });
+
+    SDL_UnlockSurface(surface);
+    return area;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include "selection.h"
+
+// Поканальная таблица 256 значений для R, G, B (альфа не меняется).
+// Любая цепочка таких коррекций сворачивается в одну таблицу через then().
+struct ColorLut {
+    Uint8 table[3][256];
+
+    static ColorLut identity();
+    static ColorLut brightnessContrast(float brightness, float contrast);   // -100..100
+    static ColorLut levels(int inBlack, int inWhite, float gamma, int outBlack, int outWhite);
+    static ColorLut curves(const std::vector<SDL_Point>& points);           // монотонный кубический сплайн
+    static ColorLut invert();
+    static ColorLut posterize(int levels);
+    static ColorLut threshold(int level);
+
+    // Сначала эта таблица, потом next
+    ColorLut then(const ColorLut& next) const;
+    bool isIdentity() const;
+};
+
+// Применяет таблицу к буферу RGBA32 на месте (в вызывающем потоке)
+void applyLut(Uint8* pixels, int w, int h, int pitch, const ColorLut& lut);
+
+// Применяет таблицу к слою RGBA32 полосами строк на всех ядрах. Если выделение
+// активно, результат смешивается с исходником по покрытию. Возвращает изменённый прямоугольник.
+SDL_Rect applyLut(SDL_Surface* surface, const ColorLut& lut, const SelectionMask* selection = nullptr);
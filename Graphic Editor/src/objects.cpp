@@ -0,0 +1,313 @@
+#include "objects.h"
+#include "raster.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+bool overlaps(const SDL_FRect& a, const SDL_FRect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+bool contains(const SDL_FRect& outer, const SDL_FRect& inner) {
+    return inner.x >= outer.x && inner.y >= outer.y &&
+           inner.x + inner.w <= outer.x + outer.w && inner.y + inner.h <= outer.y + outer.h;
+}
+
+SDL_FRect unite(const SDL_FRect& a, const SDL_FRect& b) {
+    const float x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+    const float x1 = std::max(a.x + a.w, b.x + b.w), y1 = std::max(a.y + a.h, b.y + b.h);
+    return SDL_FRect{ x0, y0, x1 - x0, y1 - y0 };
+}
+
+}
+
+ObjectHandle ObjectStore::add(ObjectType type, const SDL_FRect& rect, SDL_Color color) {
+    Uint32 slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<Uint32>(indexOfSlot.size());
+        indexOfSlot.push_back(Free);
+        generations.push_back(0);
+    }
+    indexOfSlot[slot] = static_cast<Uint32>(xs.size());
+
+    xs.push_back(rect.x);
+    ys.push_back(rect.y);
+    ws.push_back(rect.w);
+    hs.push_back(rect.h);
+    colors.push_back(color);
+    types.push_back(type);
+    slotOf.push_back(slot);
+    invalidateSpans();
+    return ObjectHandle{ slot, generations[slot] };
+}
+
+int ObjectStore::indexOf(ObjectHandle h) const {
+    if (!h.valid() || h.slot >= indexOfSlot.size()) return -1;
+    if (generations[h.slot] != h.generation || indexOfSlot[h.slot] == Free) return -1;
+    return static_cast<int>(indexOfSlot[h.slot]);
+}
+
+size_t ObjectStore::compact(const std::vector<bool>& dead) {
+    size_t out = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        if (dead[i]) {
+            // дескриптор удалённого объекта больше не совпадёт по поколению
+            Uint32 slot = slotOf[i];
+            indexOfSlot[slot] = Free;
+            ++generations[slot];
+            freeSlots.push_back(slot);
+            continue;
+        }
+        if (out != i) {
+            xs[out] = xs[i];
+            ys[out] = ys[i];
+            ws[out] = ws[i];
+            hs[out] = hs[i];
+            colors[out] = colors[i];
+            types[out] = types[i];
+            slotOf[out] = slotOf[i];
+            indexOfSlot[slotOf[out]] = static_cast<Uint32>(out);
+        }
+        ++out;
+    }
+    const size_t removed = xs.size() - out;
+    if (removed) invalidateSpans();
+    xs.resize(out);
+    ys.resize(out);
+    ws.resize(out);
+    hs.resize(out);
+    colors.resize(out);
+    types.resize(out);
+    slotOf.resize(out);
+    return removed;
+}
+
+bool ObjectStore::remove(ObjectHandle h) {
+    int i = indexOf(h);
+    if (i < 0) return false;
+    std::vector<bool> dead(xs.size(), false);
+    dead[i] = true;
+    compact(dead);
+    return true;
+}
+
+size_t ObjectStore::removeAt(float x, float y, ObjectType type) {
+    std::vector<bool> dead(xs.size());
+    bool any = false;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        dead[i] = types[i] == type && x >= xs[i] && x <= xs[i] + ws[i] && y >= ys[i] && y <= ys[i] + hs[i];
+        any |= dead[i];
+    }
+    return any ? compact(dead) : 0;
+}
+
+void ObjectStore::clear() {
+    std::vector<bool> dead(xs.size(), true);
+    compact(dead);
+}
+
+ObjectHandle ObjectStore::hitTest(float x, float y, ObjectType type) const {
+    // С конца: верхний объект нарисован последним
+    for (size_t i = xs.size(); i-- > 0;) {
+        if (types[i] == type && x >= xs[i] && x <= xs[i] + ws[i] && y >= ys[i] && y <= ys[i] + hs[i]) {
+            Uint32 slot = slotOf[i];
+            return ObjectHandle{ slot, generations[slot] };
+        }
+    }
+    return ObjectHandle{};
+}
+
+SDL_FRect ObjectStore::rect(ObjectHandle h) const {
+    int i = indexOf(h);
+    return i < 0 ? SDL_FRect{ 0, 0, 0, 0 } : rectAt(i);
+}
+
+void ObjectStore::setRect(ObjectHandle h, const SDL_FRect& r) {
+    int i = indexOf(h);
+    if (i >= 0) setRectAt(i, r);
+}
+
+void ObjectStore::setRectAt(size_t i, const SDL_FRect& r) {
+    xs[i] = r.x;
+    ys[i] = r.y;
+    ws[i] = r.w;
+    hs[i] = r.h;
+    ++revision_;
+    if (!spansValid) return;
+    for (Lod& lod : lods) lod.valid = false;
+    // Перетаскивание: рамка участка только расширяется — отсечение остаётся консервативным
+    auto it = std::upper_bound(spans.begin(), spans.end(), static_cast<Uint32>(i),
+                               [](Uint32 index, const Span& s) { return index < s.begin; });
+    Span& span = *(it - 1);
+    span.bounds = unite(span.bounds, r);
+    totalBounds = unite(totalBounds, r);
+}
+
+void ObjectStore::translate(float dx, float dy) {
+    const size_t n = xs.size();
+    float* x = xs.data();
+    float* y = ys.data();
+    for (size_t i = 0; i < n; ++i) x[i] += dx;
+    for (size_t i = 0; i < n; ++i) y[i] += dy;
+    invalidateSpans();
+}
+
+void ObjectStore::scale(float sx, float sy) {
+    // Края, а не размер: соседние прямоугольники остаются стык в стык
+    const size_t n = xs.size();
+    for (size_t i = 0; i < n; ++i) {
+        const float x0 = std::round(xs[i] * sx), x1 = std::round((xs[i] + ws[i]) * sx);
+        xs[i] = x0;
+        ws[i] = x1 - x0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const float y0 = std::round(ys[i] * sy), y1 = std::round((ys[i] + hs[i]) * sy);
+        ys[i] = y0;
+        hs[i] = y1 - y0;
+    }
+    invalidateSpans();
+}
+
+void ObjectStore::buildSpans() const {
+    spans.clear();
+    totalBounds = SDL_FRect{ 0, 0, 0, 0 };
+    const Uint32 n = static_cast<Uint32>(xs.size());
+    for (Uint32 i = 0; i < n;) {
+        Span span = { i, i + 1, rectAt(i) };
+        while (span.end < n && span.end - span.begin < SpanSize) {
+            span.bounds = unite(span.bounds, rectAt(span.end));
+            ++span.end;
+        }
+        totalBounds = spans.empty() ? span.bounds : unite(totalBounds, span.bounds);
+        spans.push_back(span);
+        i = span.end;
+    }
+    spansValid = true;
+}
+
+int ObjectStore::lodLevel(float scale) {
+    if (scale >= 0.5f) return 0;
+    const int level = static_cast<int>(std::floor(std::log2(1.0f / scale)));
+    return std::min(level, LodLevels);
+}
+
+void ObjectStore::buildLod(int level) const {
+    Lod& lod = lods[level - 1];
+    lod.rects.clear();
+    lod.colors.clear();
+    lod.spanStart.clear();
+    const float cell = static_cast<float>(1 << level);
+    std::unordered_map<Uint64, Uint32> seen;
+
+    for (const Span& span : spans) {
+        lod.spanStart.push_back(static_cast<Uint32>(lod.rects.size()));
+        seen.clear();
+        for (Uint32 i = span.begin; i < span.end; ++i) {
+            const float x0 = std::floor(xs[i] / cell), y0 = std::floor(ys[i] / cell);
+            const float x1 = std::max(x0 + 1.0f, std::ceil((xs[i] + ws[i]) / cell));
+            const float y1 = std::max(y0 + 1.0f, std::ceil((ys[i] + hs[i]) / cell));
+            const SDL_FRect snapped = { x0 * cell, y0 * cell, (x1 - x0) * cell, (y1 - y0) * cell };
+            const SDL_Color c = colors[i];
+
+            // Координаты бывают отрицательными: сначала в знаковое целое, потом маска
+            const Uint64 key = (Uint64(static_cast<Sint64>(x0)) & 0xFFFF) |
+                               ((Uint64(static_cast<Sint64>(y0)) & 0xFFFF) << 16) |
+                               ((Uint64(static_cast<Sint64>(x1 - x0)) & 0xFFFF) << 32) |
+                               ((Uint64(static_cast<Sint64>(y1 - y0)) & 0xFFFF) << 48);
+            auto found = seen.find(key);
+            if (found != seen.end()) {
+                const SDL_FRect& r = lod.rects[found->second];
+                const SDL_Color& rc = lod.colors[found->second];
+                if (r.x == snapped.x && r.y == snapped.y && r.w == snapped.w && r.h == snapped.h &&
+                    rc.r == c.r && rc.g == c.g && rc.b == c.b && rc.a == c.a) {
+                    continue;
+                }
+            }
+            seen[key] = static_cast<Uint32>(lod.rects.size());
+            lod.rects.push_back(snapped);
+            lod.colors.push_back(c);
+        }
+    }
+    lod.spanStart.push_back(static_cast<Uint32>(lod.rects.size()));
+    lod.valid = true;
+}
+
+SDL_FRect ObjectStore::bounds() const {
+    if (!spansValid) buildSpans();
+    return totalBounds;
+}
+
+void ObjectStore::draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY, const SDL_FRect& visible) const {
+    if (xs.empty()) return;
+    if (!spansValid) buildSpans();
+    if (!overlaps(totalBounds, visible)) return;
+
+    // Подряд идущие объекты одного цвета — одним вызовом
+    std::vector<SDL_FRect> batch;
+    batch.reserve(SDL_min(xs.size(), size_t(4096)));
+    SDL_Color current = { 0, 0, 0, 0 };
+    auto flush = [&]() {
+        if (batch.empty()) return;
+        SDL_SetRenderDrawColor(renderer, current.r, current.g, current.b, current.a);
+        SDL_RenderFillRects(renderer, batch.data(), static_cast<int>(batch.size()));
+        batch.clear();
+    };
+    auto emit = [&](const SDL_FRect& r, SDL_Color c) {
+        if (c.r != current.r || c.g != current.g || c.b != current.b || c.a != current.a) {
+            flush();
+            current = c;
+        }
+        batch.push_back(SDL_FRect{ r.x * scale + offsetX, r.y * scale + offsetY, r.w * scale, r.h * scale });
+    };
+
+    const int level = lodLevel(scale);
+    if (level > 0 && !lods[level - 1].valid) buildLod(level);
+
+    for (size_t s = 0; s < spans.size(); ++s) {
+        const Span& span = spans[s];
+        if (!overlaps(span.bounds, visible)) continue;
+        const bool whole = contains(visible, span.bounds);
+
+        if (level > 0) {
+            const Lod& lod = lods[level - 1];
+            for (Uint32 k = lod.spanStart[s]; k < lod.spanStart[s + 1]; ++k) {
+                if (whole || overlaps(lod.rects[k], visible)) emit(lod.rects[k], lod.colors[k]);
+            }
+            continue;
+        }
+        for (Uint32 i = span.begin; i < span.end; ++i) {
+            if (whole || (xs[i] < visible.x + visible.w && visible.x < xs[i] + ws[i] &&
+                          ys[i] < visible.y + visible.h && visible.y < ys[i] + hs[i])) {
+                emit(rectAt(i), colors[i]);
+            }
+        }
+    }
+    flush();
+}
+
+void ObjectStore::rasterize(Uint8* buf, int pitch, SDL_Rect area) const {
+    if (xs.empty()) return;
+    if (!spansValid) buildSpans();
+    const SDL_FRect visible = { float(area.x), float(area.y), float(area.w), float(area.h) };
+    if (!overlaps(totalBounds, visible)) return;
+
+    for (const Span& span : spans) {
+        if (!overlaps(span.bounds, visible)) continue;
+        for (Uint32 i = span.begin; i < span.end; ++i) {
+            // Пиксель закрашен, если его центр внутри прямоугольника — как при отрисовке в масштабе 1
+            const int x0 = std::max(area.x, static_cast<int>(std::lround(xs[i])));
+            const int y0 = std::max(area.y, static_cast<int>(std::lround(ys[i])));
+            const int x1 = std::min(area.x + area.w, static_cast<int>(std::lround(xs[i] + ws[i])));
+            const int y1 = std::min(area.y + area.h, static_cast<int>(std::lround(ys[i] + hs[i])));
+            for (int y = y0; y < y1; ++y) {
+                Uint8* p = buf + static_cast<size_t>(y - area.y) * pitch + (x0 - area.x) * 4;
+                for (int x = x0; x < x1; ++x, p += 4) blendPixel(p, colors[i], 255);
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <array>
+#include <vector>
+
+// Векторные объекты слоя в виде структуры массивов: координаты, цвета и типы
+// лежат в отдельных плотных массивах в порядке отрисовки. Перенос,
+// масштабирование и поиск попадания идут одним проходом по непрерывной памяти,
+// отрисовка — пачками SDL_RenderFillRects без виртуальных вызовов.
+
+enum class ObjectType : Uint8 {
+    Rect         // прямоугольник инструмента выделения
+};
+
+// Стабильный дескриптор: не меняется при удалении других объектов;
+// после удаления самого объекта становится недействительным (другое поколение)
+struct ObjectHandle {
+    Uint32 slot = 0xFFFFFFFFu;
+    Uint32 generation = 0;
+
+    bool valid() const { return slot != 0xFFFFFFFFu; }
+    bool operator==(const ObjectHandle& o) const { return slot == o.slot && generation == o.generation; }
+    bool operator!=(const ObjectHandle& o) const { return !(*this == o); }
+};
+
+class ObjectStore {
+public:
+    ObjectHandle add(ObjectType type, const SDL_FRect& rect, SDL_Color color);
+
+    bool alive(ObjectHandle h) const { return indexOf(h) >= 0; }
+    bool remove(ObjectHandle h);
+    // Удаляет объекты типа type, содержащие точку (мировые координаты)
+    size_t removeAt(float x, float y, ObjectType type);
+    void clear();
+
+    // Верхний объект типа type под точкой или недействительный дескриптор
+    ObjectHandle hitTest(float x, float y, ObjectType type) const;
+
+    SDL_FRect rect(ObjectHandle h) const;
+    void setRect(ObjectHandle h, const SDL_FRect& rect);
+
+    // Над всеми объектами сразу
+    void translate(float dx, float dy);
+    void scale(float sx, float sy);   // относительно (0, 0), с округлением краёв до целых
+
+    // Плотный доступ по индексу 0..size()-1 (индексы меняются при удалении)
+    size_t size() const { return xs.size(); }
+    SDL_FRect rectAt(size_t i) const { return SDL_FRect{ xs[i], ys[i], ws[i], hs[i] }; }
+    void setRectAt(size_t i, const SDL_FRect& rect);
+    ObjectType typeAt(size_t i) const { return types[i]; }
+    SDL_Color colorAt(size_t i) const { return colors[i]; }
+
+    // Рамка всех объектов (мировые координаты); пустая, если объектов нет
+    SDL_FRect bounds() const;
+    // Рисует только объекты, пересекающие visible (мировые координаты). Отсечение
+    // двухуровневое: сначала рамки участков, затем рамки объектов внутри частично видимых.
+    // При scale < 0.5 рисуется упрощённый уровень детализации (см. Lod)
+    void draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY, const SDL_FRect& visible) const;
+
+    // Растеризует объекты в буфер RGBA32 области area (координаты холста) поверх
+    // его содержимого — для композита под корректирующим слоем. Из нескольких
+    // потоков можно звать только после bounds(): кэш рамок строится лениво
+    void rasterize(Uint8* buf, int pitch, SDL_Rect area) const;
+
+    // Растёт при каждом изменении объектов
+    Uint32 revision() const { return revision_; }
+
+private:
+    // Участок плотных массивов: подряд идущие объекты (не длиннее SpanSize)
+    // с кэшированной рамкой. Порядок при удалении сохраняется.
+    struct Span {
+        Uint32 begin, end;
+        SDL_FRect bounds;
+    };
+    static constexpr Uint32 SpanSize = 256;
+    void buildSpans() const;
+    void invalidateSpans() {
+        ++revision_;
+        spansValid = false;
+        for (Lod& lod : lods) lod.valid = false;
+    }
+
+    // Уровень детализации L: прямоугольники каждого участка прижаты к сетке с
+    // шагом 2^L мировых единиц (около пикселя экрана при scale ~ 2^-L), совпавшие
+    // выброшены. Штрихи кисти — пиксели слоя, так что это касается только
+    // прямоугольников: при сильном отдалении тысячи мелких прямоугольников,
+    // попавших в одну ячейку, рисуются одним. Строится лениво.
+    struct Lod {
+        std::vector<SDL_FRect> rects;
+        std::vector<SDL_Color> colors;
+        std::vector<Uint32> spanStart;   // span s -> [spanStart[s], spanStart[s + 1])
+        bool valid = false;
+    };
+    static constexpr int LodLevels = 6;   // шаг сетки 2..64
+    static int lodLevel(float scale);
+    void buildLod(int level) const;
+
+    int indexOf(ObjectHandle h) const;
+    // Удаляет помеченные объекты, сохраняя порядок остальных
+    size_t compact(const std::vector<bool>& dead);
+
+    // плотные массивы, по элементу на объект
+    std::vector<float> xs, ys, ws, hs;
+    std::vector<SDL_Color> colors;
+    std::vector<ObjectType> types;
+    std::vector<Uint32> slotOf;        // плотный индекс -> слот
+
+    // слоты дескрипторов
+    std::vector<Uint32> indexOfSlot;   // слот -> плотный индекс (Free — свободен)
+    std::vector<Uint32> generations;
+    std::vector<Uint32> freeSlots;
+    Uint32 revision_ = 0;
+
+    // кэш рамок, пересобирается лениво после изменений
+    mutable std::vector<Span> spans;
+    mutable SDL_FRect totalBounds = { 0, 0, 0, 0 };
+    mutable bool spansValid = false;
+    mutable std::array<Lod, LodLevels> lods;
+
+    static constexpr Uint32 Free = 0xFFFFFFFFu;
+};
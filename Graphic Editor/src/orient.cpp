@@ -0,0 +1,194 @@
+#include "orient.h"
+#include "parallel.h"
+#include "tiles.h"
+#include <algorithm>
+#include <vector>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr int Block = 64;   // сторона блока транспонирования: src и dst блока лежат в L1
+
+// Пиксели RGBA32 w x h: тайл снимка или временный буфер
+struct View {
+    Uint8* pixels;
+    int pitch;
+    int w, h;
+};
+
+inline Uint32* rowOf(const View& v, int y) {
+    return reinterpret_cast<Uint32*>(v.pixels + static_cast<size_t>(y) * v.pitch);
+}
+
+// Переворот строки из n пикселей на месте
+void reverseRow(Uint32* row, int n) {
+    int i = 0, j = n - 1;
+#if defined(SDL_SSE2_INTRINSICS)
+    for (; j - i + 1 >= 8; i += 4, j -= 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j - 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + j - 3), _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; j - i + 1 >= 8; i += 4, j -= 4) {
+        uint32x4_t a = vrev64q_u32(vld1q_u32(row + i));
+        uint32x4_t b = vrev64q_u32(vld1q_u32(row + j - 3));
+        vst1q_u32(row + i, vcombine_u32(vget_high_u32(b), vget_low_u32(b)));
+        vst1q_u32(row + j - 3, vcombine_u32(vget_high_u32(a), vget_low_u32(a)));
+    }
+#endif
+    for (; i < j; ++i, --j) std::swap(row[i], row[j]);
+}
+
+// Поворот на 90° (clockwise) или 270°: пиксель src (x, y) попадает в
+// dst (h - 1 - y, x) или (y, w - 1 - x) соответственно
+void rotateBlock(const View& src, const View& dst, int x0, int y0, int x1, int y1, bool clockwise) {
+    const int w = src.w, h = src.h;
+    int y = y0;
+#if defined(SDL_SSE2_INTRINSICS) || defined(SDL_NEON_INTRINSICS)
+    for (; y + 4 <= y1; y += 4) {
+        const Uint32* r[4] = { rowOf(src, y), rowOf(src, y + 1), rowOf(src, y + 2), rowOf(src, y + 3) };
+        int x = x0;
+        for (; x + 4 <= x1; x += 4) {
+#if defined(SDL_SSE2_INTRINSICS)
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r[0] + x));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r[1] + x));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r[2] + x));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r[3] + x));
+            __m128i t0 = _mm_unpacklo_epi32(a, b), t1 = _mm_unpacklo_epi32(c, d);
+            __m128i t2 = _mm_unpackhi_epi32(a, b), t3 = _mm_unpackhi_epi32(c, d);
+            __m128i col[4] = {   // col[j] — столбец x + j исходного блока сверху вниз
+                _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+            };
+            for (int j = 0; j < 4; ++j) {
+                if (clockwise) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(rowOf(dst, x + j) + (h - 4 - y)),
+                                     _mm_shuffle_epi32(col[j], _MM_SHUFFLE(0, 1, 2, 3)));
+                } else {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(rowOf(dst, w - 1 - x - j) + y), col[j]);
+                }
+            }
+#else
+            uint32x4x2_t p01 = vtrnq_u32(vld1q_u32(r[0] + x), vld1q_u32(r[1] + x));
+            uint32x4x2_t p23 = vtrnq_u32(vld1q_u32(r[2] + x), vld1q_u32(r[3] + x));
+            uint32x4_t col[4] = {
+                vcombine_u32(vget_low_u32(p01.val[0]), vget_low_u32(p23.val[0])),
+                vcombine_u32(vget_low_u32(p01.val[1]), vget_low_u32(p23.val[1])),
+                vcombine_u32(vget_high_u32(p01.val[0]), vget_high_u32(p23.val[0])),
+                vcombine_u32(vget_high_u32(p01.val[1]), vget_high_u32(p23.val[1]))
+            };
+            for (int j = 0; j < 4; ++j) {
+                if (clockwise) {
+                    uint32x4_t rev = vrev64q_u32(col[j]);
+                    vst1q_u32(rowOf(dst, x + j) + (h - 4 - y), vcombine_u32(vget_high_u32(rev), vget_low_u32(rev)));
+                } else {
+                    vst1q_u32(rowOf(dst, w - 1 - x - j) + y, col[j]);
+                }
+            }
+#endif
+        }
+        for (; x < x1; ++x) {
+            for (int k = 0; k < 4; ++k) {
+                if (clockwise) rowOf(dst, x)[h - 1 - y - k] = r[k][x];
+                else           rowOf(dst, w - 1 - x)[y + k] = r[k][x];
+            }
+        }
+    }
+#endif
+    for (; y < y1; ++y) {
+        const Uint32* r = rowOf(src, y);
+        for (int x = x0; x < x1; ++x) {
+            if (clockwise) rowOf(dst, x)[h - 1 - y] = r[x];
+            else           rowOf(dst, w - 1 - x)[y] = r[x];
+        }
+    }
+}
+
+// Поворот или отражение тайла src в dst (для 90° и 270° стороны переставлены)
+void orientTile(const View& src, const View& dst, Orientation o) {
+    if (swapsAxes(o)) {
+        for (int y0 = 0; y0 < src.h; y0 += Block) {
+            for (int x0 = 0; x0 < src.w; x0 += Block) {
+                rotateBlock(src, dst, x0, y0, std::min(x0 + Block, src.w), std::min(y0 + Block, src.h),
+                            o == Orientation::Rotate90);
+            }
+        }
+        return;
+    }
+    for (int y = 0; y < src.h; ++y) {
+        Uint32* row = rowOf(dst, o == Orientation::FlipHorizontal ? y : src.h - 1 - y);
+        SDL_memcpy(row, rowOf(src, y), src.w * 4);
+        if (o != Orientation::FlipVertical) reverseRow(row, src.w);
+    }
+}
+
+}
+
+bool swapsAxes(Orientation o) {
+    return o == Orientation::Rotate90 || o == Orientation::Rotate270;
+}
+
+SDL_Surface* orientSnapshot(std::shared_ptr<const TileSnapshot> snapshot, Orientation o, int outW, int outH) {
+    if (!snapshot) return nullptr;
+    const int w = snapshot->w, h = snapshot->h, tilesX = snapshot->tilesX;
+    // Свои ссылки на тайлы; снимок отпускаем, чтобы тайлы освобождались по ходу
+    std::vector<PixelTilePtr> tiles = snapshot->tiles;
+    snapshot.reset();
+
+    SDL_Surface* dst = SDL_CreateSurface(outW, outH, SDL_PIXELFORMAT_RGBA32);
+    if (!dst) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "orientSnapshot: %s", SDL_GetError());
+        return nullptr;
+    }
+    const int dx = (outW - (swapsAxes(o) ? h : w)) / 2;
+    const int dy = (outH - (swapsAxes(o) ? w : h)) / 2;
+    const SDL_Rect bounds = { 0, 0, outW, outH };
+
+    SDL_LockSurface(dst);
+    parallelFor(0, static_cast<int>(tiles.size()), 1, [&](int from, int to) {
+        std::vector<Uint32> buffer(static_cast<size_t>(LayerTileSize) * LayerTileSize);
+        for (int t = from; t < to; ++t) {
+            const PixelTile& tile = *tiles[t];
+            SDL_Rect r = orientRect(SDL_Rect{ (t % tilesX) * LayerTileSize, (t / tilesX) * LayerTileSize, tile.w, tile.h },
+                                    w, h, o);
+            const View src = { const_cast<Uint8*>(tile.pixels.data()), tile.w * 4, tile.w, tile.h };
+            const View out = { reinterpret_cast<Uint8*>(buffer.data()), r.w * 4, r.w, r.h };
+            orientTile(src, out, o);
+
+            // Повёрнутый тайл — на своё место в сетке; выходящее за холст обрезается
+            r.x += dx;
+            r.y += dy;
+            SDL_Rect clip;
+            if (SDL_GetRectIntersection(&r, &bounds, &clip)) {
+                for (int y = clip.y; y < clip.y + clip.h; ++y) {
+                    SDL_memcpy(static_cast<Uint8*>(dst->pixels) + static_cast<size_t>(y) * dst->pitch + clip.x * 4,
+                               rowOf(out, y - r.y) + (clip.x - r.x), clip.w * 4);
+                }
+            }
+            tiles[t].reset();
+        }
+    });
+    SDL_UnlockSurface(dst);
+    return dst;
+}
+
+SDL_FPoint orientPoint(SDL_FPoint p, int w, int h, Orientation o) {
+    switch (o) {
+        case Orientation::Rotate90:       return { h - p.y, p.x };
+        case Orientation::Rotate180:      return { w - p.x, h - p.y };
+        case Orientation::Rotate270:      return { p.y, w - p.x };
+        case Orientation::FlipHorizontal: return { w - p.x, p.y };
+        case Orientation::FlipVertical:   return { p.x, h - p.y };
+    }
+    return p;
+}
+
+SDL_Rect orientRect(const SDL_Rect& r, int w, int h, Orientation o) {
+    SDL_FPoint a = orientPoint({ float(r.x), float(r.y) }, w, h, o);
+    SDL_FPoint b = orientPoint({ float(r.x + r.w), float(r.y + r.h) }, w, h, o);
+    int x0 = static_cast<int>(std::min(a.x, b.x)), y0 = static_cast<int>(std::min(a.y, b.y));
+    int x1 = static_cast<int>(std::max(a.x, b.x)), y1 = static_cast<int>(std::max(a.y, b.y));
+    return SDL_Rect{ x0, y0, x1 - x0, y1 - y0 };
+}
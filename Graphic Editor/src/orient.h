@@ -0,0 +1,28 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <memory>
+
+struct TileSnapshot;
+
+enum class Orientation {
+    Rotate90,        // по часовой стрелке
+    Rotate180,
+    Rotate270,       // против часовой стрелки
+    FlipHorizontal,
+    FlipVertical
+};
+
+// Меняются ли местами ширина и высота
+bool swapsAxes(Orientation o);
+
+// Поворот или отражение снимка слоя в новый surface outW x outH: результат по
+// центру, выходящее за края обрезается. Тайлы снимка поворачиваются по одному
+// (90° и 270° — транспонирование блоками 64x64 по 4x4 на SIMD), сетка тайлов
+// переставляется, и каждый тайл отпускается сразу после переноса. Если снимок
+// больше никто не держит, пиковая память — surface слоя и результат плюс по
+// тайлу на поток: полной промежуточной копии слоя нет. Любой поток; nullptr при ошибке.
+SDL_Surface* orientSnapshot(std::shared_ptr<const TileSnapshot> snapshot, Orientation o, int outW, int outH);
+
+// Точка (непрерывные координаты) и прямоугольник в холсте w x h после преобразования
+SDL_FPoint orientPoint(SDL_FPoint p, int w, int h, Orientation o);
+SDL_Rect orientRect(const SDL_Rect& r, int w, int h, Orientation o);
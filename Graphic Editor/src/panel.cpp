@@ -0,0 +1,43 @@
+#include "panel.h"
+
+bool CachedPanel::begin(SDL_Renderer* renderer, int width, int height, Uint64 newState) {
+    if (texture && (texture->w != width || texture->h != height)) release();
+    if (!texture) {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!texture) {
+            SDL_Log("CachedPanel: SDL_CreateTexture failed: %s", SDL_GetError());
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        valid = false;
+    }
+    if (valid && state == newState) return false;
+
+    previousTarget = SDL_GetRenderTarget(renderer);
+    if (!SDL_SetRenderTarget(renderer, texture)) {
+        SDL_Log("CachedPanel: SDL_SetRenderTarget failed: %s", SDL_GetError());
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    state = newState;
+    valid = true;
+    return true;
+}
+
+void CachedPanel::end(SDL_Renderer* renderer) {
+    SDL_SetRenderTarget(renderer, previousTarget);
+    previousTarget = nullptr;
+}
+
+void CachedPanel::draw(SDL_Renderer* renderer, float x, float y) const {
+    if (!texture || !valid) return;
+    SDL_FRect dst = { x, y, static_cast<float>(texture->w), static_cast<float>(texture->h) };
+    SDL_RenderTexture(renderer, texture, nullptr, &dst);
+}
+
+void CachedPanel::release() {
+    if (texture) SDL_DestroyTexture(texture);
+    texture = nullptr;
+    valid = false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+// Ключ состояния панели: FNV-1a по значениям, от которых зависит её вид
+class PanelState {
+public:
+    PanelState& add(Uint64 value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+        return *this;
+    }
+    Uint64 value() const { return hash; }
+
+private:
+    Uint64 hash = 14695981039346656037ull;
+};
+
+// Панель интерфейса в собственной текстуре. Перерисовывается, только когда
+// меняется ключ состояния или размер; в остальных кадрах — одна копия текстуры.
+class CachedPanel {
+public:
+    CachedPanel() = default;
+    CachedPanel(const CachedPanel&) = delete;
+    CachedPanel& operator=(const CachedPanel&) = delete;
+    ~CachedPanel() { release(); }
+
+    // true — панель нужно перерисовать: цель рендера переключена на её текстуру
+    // (координаты — от левого верхнего угла панели), после рисования вызвать end()
+    bool begin(SDL_Renderer* renderer, int width, int height, Uint64 state);
+    void end(SDL_Renderer* renderer);
+    void draw(SDL_Renderer* renderer, float x, float y) const;
+
+    void invalidate() { valid = false; }
+    // Освобождает текстуру (до уничтожения рендерера)
+    void release();
+
+private:
+    SDL_Texture* texture = nullptr;
+    SDL_Texture* previousTarget = nullptr;
+    Uint64 state = 0;
+    bool valid = false;
+};
@@ -0,0 +1,77 @@
+#include "parallel.h"
+#include "jobs.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+int workerCount() {
+    static const int count = std::max(1u, std::thread::hardware_concurrency());
+    return count;
+}
+
+namespace {
+
+// Общее состояние одного вызова parallelFor. Помощники, стартовавшие после того,
+// как вызывающий закрыл цикл, body не трогают — ждать их не нужно.
+struct ParallelLoop {
+    std::atomic<int> next{ 0 };
+    int chunks = 0, begin = 0, end = 0, grain = 1;
+    const std::function<void(int, int)>* body = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    int running = 0;
+    bool closed = false;
+
+    void work() {
+        for (int c = next.fetch_add(1); c < chunks; c = next.fetch_add(1)) {
+            int from = begin + c * grain;
+            (*body)(from, std::min(from + grain, end));
+        }
+    }
+};
+
+}
+
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body) {
+    if (end <= begin) return;
+    grain = std::max(grain, 1);
+
+    int chunks = (end - begin + grain - 1) / grain;
+    int threads = std::min(workerCount(), chunks);
+    if (threads <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    // Блоки раздаются через общий счётчик: вызывающий поток работает сам, а
+    // помощники из пула задач подключаются, когда освободятся
+    auto loop = std::make_shared<ParallelLoop>();
+    loop->chunks = chunks;
+    loop->begin = begin;
+    loop->end = end;
+    loop->grain = grain;
+    loop->body = &body;
+
+    for (int i = 1; i < threads; ++i) {
+        submitDetached(JobPriority::High, [loop] {
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                if (loop->closed) return;
+                ++loop->running;
+            }
+            loop->work();
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            if (--loop->running == 0) loop->idle.notify_all();
+        });
+    }
+
+    loop->work();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->closed = true;
+    loop->idle.wait(lock, [&] { return loop->running == 0; });
+}
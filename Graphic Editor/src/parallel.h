@@ -0,0 +1,10 @@
+#pragma once
+#include <functional>
+
+// Количество потоков, на которые делится тяжёлая работа (включая вызывающий)
+int workerCount();
+
+// Делит [begin, end) на блоки по grain элементов и выполняет body(from, to)
+// на всех ядрах (в вызывающем потоке и в пуле задач, см. jobs.h). Возвращает
+// управление, когда все блоки готовы. Вложенные вызовы допустимы.
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
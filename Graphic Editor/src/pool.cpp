@@ -0,0 +1,49 @@
+#include "pool.h"
+
+DrawablePool::~DrawablePool() {
+    const size_t leaked = releaseAll();
+    if (leaked) SDL_Log("DrawablePool: %zu object(s) were still alive at destruction", leaked);
+}
+
+Uint32 DrawablePool::acquire() {
+    Uint32 slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<Uint32>(objects.size());
+        if (slot % ChunkSlots == 0) chunks.push_back(std::make_unique<Slot[]>(ChunkSlots));
+        objects.push_back(nullptr);
+        generations.push_back(0);
+    }
+    ++liveCount;
+    ++totalCreated;
+    if (liveCount > peakCount) peakCount = liveCount;
+    return slot;
+}
+
+void DrawablePool::release(DrawableHandle h) {
+    Drawable* obj = get(h);
+    if (!obj) return;
+    obj->~Drawable();
+    objects[h.slot] = nullptr;
+    ++generations[h.slot];
+    freeSlots.push_back(h.slot);
+    --liveCount;
+}
+
+size_t DrawablePool::releaseAll() {
+    const size_t alive = liveCount;
+    for (Uint32 slot = 0; slot < objects.size(); ++slot) {
+        if (objects[slot]) release(DrawableHandle{ slot, generations[slot] });
+    }
+    return alive;
+}
+
+void DrawablePool::reportLeaks(const char* when) const {
+    if (liveCount == 0) {
+        SDL_Log("DrawablePool (%s): no leaks, %zu created, peak %zu", when, totalCreated, peakCount);
+        return;
+    }
+    SDL_Log("DrawablePool (%s): %zu object(s) leaked of %zu created", when, liveCount, totalCreated);
+}
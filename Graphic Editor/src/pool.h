@@ -0,0 +1,74 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Drawable.h"
+
+// Дескриптор объекта пула: слот + поколение. После release дескриптор
+// недействителен — get вернёт nullptr, а не освобождённую память.
+struct DrawableHandle {
+    Uint32 slot = 0xFFFFFFFFu;
+    Uint32 generation = 0;
+
+    bool valid() const { return slot != 0xFFFFFFFFu; }
+    bool operator==(const DrawableHandle& o) const { return slot == o.slot && generation == o.generation; }
+};
+
+// Пул объектов Drawable документа. Память выделяется блоками по ChunkSlots
+// слотов фиксированного размера и не перемещается; освобождённые слоты
+// переиспользуются. Объект владеет своими ресурсами SDL и освобождает их в
+// деструкторе при release. Счётчики живых объектов позволяют найти утечки.
+class DrawablePool {
+public:
+    static constexpr size_t SlotSize = 64;
+    static constexpr size_t ChunkSlots = 64;
+
+    DrawablePool() = default;
+    DrawablePool(const DrawablePool&) = delete;
+    DrawablePool& operator=(const DrawablePool&) = delete;
+    ~DrawablePool();
+
+    template <typename T, typename... Args>
+    DrawableHandle create(Args&&... args) {
+        static_assert(std::is_base_of<Drawable, T>::value, "T must derive from Drawable");
+        static_assert(sizeof(T) <= SlotSize && alignof(T) <= alignof(std::max_align_t), "T does not fit a pool slot");
+        const Uint32 slot = acquire();
+        objects[slot] = new (slotMemory(slot)) T(std::forward<Args>(args)...);
+        return DrawableHandle{ slot, generations[slot] };
+    }
+
+    Drawable* get(DrawableHandle h) const {
+        if (!h.valid() || h.slot >= objects.size() || generations[h.slot] != h.generation) return nullptr;
+        return objects[h.slot];
+    }
+
+    // Уничтожает объект (с его ресурсами); устаревший дескриптор игнорируется
+    void release(DrawableHandle h);
+    // Уничтожает всё; возвращает, сколько объектов было ещё живо
+    size_t releaseAll();
+
+    size_t live() const { return liveCount; }
+    size_t peak() const { return peakCount; }
+    // Пишет в лог, если живые объекты остались (вызывать после освобождения слоёв)
+    void reportLeaks(const char* when) const;
+
+private:
+    struct alignas(std::max_align_t) Slot {
+        unsigned char bytes[SlotSize];
+    };
+
+    Uint32 acquire();
+    void* slotMemory(Uint32 slot) { return chunks[slot / ChunkSlots][slot % ChunkSlots].bytes; }
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<Drawable*> objects;      // nullptr — слот свободен
+    std::vector<Uint32> generations;
+    std::vector<Uint32> freeSlots;
+    size_t liveCount = 0;
+    size_t peakCount = 0;
+    size_t totalCreated = 0;
+};
@@ -0,0 +1,354 @@
+#include "preview.h"
+#include "layer.h"
+#include "resize.h"
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+SDL_Rect inflateWithin(SDL_Rect r, int by, int w, int h) {
+    SDL_Rect out = { r.x - by, r.y - by, r.w + 2 * by, r.h + 2 * by };
+    SDL_Rect bounds = { 0, 0, w, h };
+    SDL_GetRectIntersection(&out, &bounds, &out);
+    return out;
+}
+
+bool sameRect(const SDL_Rect& a, const SDL_Rect& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Ключ порядка: видимые тайлы раньше невидимых, ближе к центру экрана — раньше
+long long viewPriority(const SDL_Rect& r, const SDL_Rect& visible) {
+    long long dx = r.x + r.w / 2 - (visible.x + visible.w / 2);
+    long long dy = r.y + r.h / 2 - (visible.y + visible.h / 2);
+    long long key = dx * dx + dy * dy;
+    if (!SDL_HasRectIntersection(&r, &visible)) key += 1LL << 40;
+    return key;
+}
+
+}
+
+bool FilterPreview::begin(SDL_Surface* layerSurface, const PreviewFilter& previewFilter, const SelectionMask* selection) {
+    if (active() || !layerSurface || !previewFilter.apply) return false;
+    if (layerSurface->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("FilterPreview: unsupported pixel format %s", SDL_GetPixelFormatName(layerSurface->format));
+        return false;
+    }
+
+    auto src = std::make_shared<Source>();
+    src->original = resizeCanvas(layerSurface, layerSurface->w, layerSurface->h, 0, 0);
+    if (!src->original) return false;
+
+    mask = selection && selection->active() ? selection : nullptr;
+    area = mask ? mask->clipRect(layerSurface->w, layerSurface->h)
+                : SDL_Rect{ 0, 0, layerSurface->w, layerSurface->h };
+    if (SDL_RectEmpty(&area)) return false;
+
+    target = layerSurface;
+    source = src;
+    filter = previewFilter;
+    filter.value = std::clamp(filter.value, filter.minValue, filter.maxValue);
+
+    // Сетка тайлов выровнена по тайлам слоя
+    originX = area.x / LayerTileSize * LayerTileSize;
+    originY = area.y / LayerTileSize * LayerTileSize;
+    tilesX = (area.x + area.w - originX + LayerTileSize - 1) / LayerTileSize;
+    tilesY = (area.y + area.h - originY + LayerTileSize - 1) / LayerTileSize;
+    done.assign(tilesX * tilesY, false);
+
+    schedule();
+    return true;
+}
+
+SDL_Rect FilterPreview::tileRect(int tile) const {
+    SDL_Rect r = { originX + (tile % tilesX) * LayerTileSize, originY + (tile / tilesX) * LayerTileSize,
+                   LayerTileSize, LayerTileSize };
+    SDL_GetRectIntersection(&r, &area, &r);
+    return r;
+}
+
+// Отменяет задачи текущего поколения; их результаты collect() отбросит
+void FilterPreview::cancelJobs() {
+    if (jobs) jobs->cancel();
+    jobs.reset();
+    queue.reset();
+    ++generation;
+    std::lock_guard<std::mutex> lock(results->mutex);
+    results->finished.clear();
+}
+
+// Новое поколение: группа задач на все неготовые тайлы в порядке видимости
+void FilterPreview::schedule() {
+    cancelJobs();
+
+    queue = std::make_shared<Queue>();
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (done[t]) continue;
+        SDL_Rect r = tileRect(t);
+        if (SDL_RectEmpty(&r)) continue;
+        queue->tiles.push_back({ t, r });
+    }
+    const int count = static_cast<int>(queue->tiles.size());
+    reprioritize();
+
+    auto p = std::make_shared<Params>();
+    p->source = source;
+    p->filter = filter;
+    p->value = filter.value;
+    p->pad = filter.padding ? filter.padding(filter.value) : 0;
+    jobs = createTaskGroup(std::string("preview ") + filter.name, JobPriority::Normal);
+    jobs->addWork(count);
+    for (int i = 0; i < count; ++i) {
+        const Uint32 gen = generation;
+        std::shared_ptr<Queue> pending = queue;
+        std::shared_ptr<Results> out = results;
+        submitTask(jobs, [p, pending, out, gen](TaskGroup& group) {
+            PendingTile next;
+            {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                if (pending->tiles.empty()) return;
+                next = pending->tiles.back();
+                pending->tiles.pop_back();
+            }
+            std::vector<Uint8> pixels = group.cancelled() ? std::vector<Uint8>() : renderTile(*p, next.rect);
+            group.advance();
+            if (pixels.empty() || group.cancelled()) return;
+            std::lock_guard<std::mutex> lock(out->mutex);
+            out->finished.push_back({ gen, next.tile, std::move(pixels) });
+        });
+    }
+    finishTaskGroup(jobs);
+}
+
+// Переставляет ещё не взятые тайлы под текущую видимую область; поколение,
+// задачи и готовые результаты не трогаются
+void FilterPreview::reprioritize() {
+    if (!queue) return;
+    const SDL_Rect visible = proxyVisible;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    std::sort(queue->tiles.begin(), queue->tiles.end(), [&](const PendingTile& a, const PendingTile& b) {
+        return viewPriority(a.rect, visible) > viewPriority(b.rect, visible);
+    });
+}
+
+// Тайл полного разрешения: фильтр по копии тайла с полями из оригинала
+std::vector<Uint8> FilterPreview::renderTile(const Params& params, SDL_Rect rect) {
+    SDL_Surface* original = params.source->original;
+    SDL_Rect padded = inflateWithin(rect, params.pad, original->w, original->h);
+    SDL_Surface* tile = resizeCanvas(original, padded.w, padded.h, -padded.x, -padded.y);
+    if (!tile) return {};
+
+    params.filter.apply(tile, params.value, 1.0f);
+
+    std::vector<Uint8> out(static_cast<size_t>(rect.w) * rect.h * 4);
+    for (int y = 0; y < rect.h; ++y) {
+        SDL_memcpy(&out[static_cast<size_t>(y) * rect.w * 4],
+                   static_cast<const Uint8*>(tile->pixels) + (rect.y - padded.y + y) * tile->pitch + (rect.x - padded.x) * 4,
+                   rect.w * 4);
+    }
+    SDL_DestroySurface(tile);
+    return out;
+}
+
+void FilterPreview::blendTile(SDL_Rect rect, const Uint8* pixels) {
+    const SDL_Surface* original = source->original;
+    std::vector<Uint8> coverage(rect.w, 255);
+    for (int y = 0; y < rect.h; ++y) {
+        Uint8* dst = static_cast<Uint8*>(target->pixels) + (rect.y + y) * target->pitch + rect.x * 4;
+        const Uint8* src = pixels + static_cast<size_t>(y) * rect.w * 4;
+        if (!mask) {
+            SDL_memcpy(dst, src, rect.w * 4);
+            continue;
+        }
+        const Uint8* orig = static_cast<const Uint8*>(original->pixels) + (rect.y + y) * original->pitch + rect.x * 4;
+        mask->readRow(rect.y + y, rect.x, rect.w, coverage.data());
+        for (int i = 0; i < rect.w * 4; ++i) {
+            int a = coverage[i / 4];
+            dst[i] = static_cast<Uint8>((src[i] * a + orig[i] * (255 - a)) / 255);
+        }
+    }
+}
+
+void FilterPreview::restoreTile(SDL_Rect rect) {
+    const SDL_Surface* original = source->original;
+    for (int y = rect.y; y < rect.y + rect.h; ++y) {
+        SDL_memcpy(static_cast<Uint8*>(target->pixels) + y * target->pitch + rect.x * 4,
+                   static_cast<const Uint8*>(original->pixels) + y * original->pitch + rect.x * 4,
+                   rect.w * 4);
+    }
+}
+
+void FilterPreview::setValue(float newValue, std::vector<SDL_Rect>& changed) {
+    if (!active()) return;
+    newValue = std::clamp(newValue, filter.minValue, filter.maxValue);
+    if (newValue == filter.value) return;
+    filter.value = newValue;
+
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (!done[t]) continue;
+        SDL_Rect r = tileRect(t);
+        restoreTile(r);
+        changed.push_back(r);
+        done[t] = false;
+    }
+    schedule();
+}
+
+void FilterPreview::collect(std::vector<SDL_Rect>& changed) {
+    if (!active()) return;
+    std::vector<TileResult> ready;
+    {
+        std::lock_guard<std::mutex> lock(results->mutex);
+        ready.swap(results->finished);
+    }
+    for (const TileResult& result : ready) {
+        if (result.generation != generation || done[result.tile]) continue;
+        SDL_Rect r = tileRect(result.tile);
+        blendTile(r, result.pixels.data());
+        done[result.tile] = true;
+        changed.push_back(r);
+    }
+}
+
+void FilterPreview::updateView(SDL_Renderer* renderer, SDL_Rect visible, float viewScale) {
+    if (!active()) return;
+    SDL_Rect vis;
+    if (!SDL_GetRectIntersection(&visible, &area, &vis)) return;
+    const bool viewChanged = !sameRect(vis, proxyVisible) || viewScale != proxyScale;
+    if (proxy && !viewChanged && proxyGeneration == generation) return;
+
+    const SDL_Surface* original = source->original;
+    const int pad = filter.padding ? filter.padding(filter.value) : 0;
+    SDL_Rect region = inflateWithin(vis, pad, original->w, original->h);
+    SDL_Surface* base = resizeCanvas(source->original, region.w, region.h, -region.x, -region.y);
+    if (!base) return;
+
+    // При отдалении фильтр считается в разрешении экрана
+    const float ps = std::min(1.0f, viewScale);
+    if (ps < 1.0f) {
+        SDL_Surface* small = resizeSurface(base,
+                                           std::max(1, static_cast<int>(region.w * ps + 0.5f)),
+                                           std::max(1, static_cast<int>(region.h * ps + 0.5f)), Resample::Box);
+        SDL_DestroySurface(base);
+        base = small;
+        if (!base) return;
+    }
+    SDL_Surface* filtered = resizeCanvas(base, base->w, base->h, 0, 0);
+    if (!filtered) {
+        SDL_DestroySurface(base);
+        return;
+    }
+    filter.apply(filtered, filter.value, float(base->w) / region.w);
+
+    if (mask) {
+        const float sx = float(region.w) / base->w, sy = float(region.h) / base->h;
+        for (int y = 0; y < base->h; ++y) {
+            Uint8* dst = static_cast<Uint8*>(filtered->pixels) + y * filtered->pitch;
+            const Uint8* orig = static_cast<const Uint8*>(base->pixels) + y * base->pitch;
+            const int wy = region.y + static_cast<int>((y + 0.5f) * sy);
+            for (int x = 0; x < base->w; ++x) {
+                int a = mask->at(region.x + static_cast<int>((x + 0.5f) * sx), wy);
+                for (int c = 0; c < 4; ++c) {
+                    dst[x * 4 + c] = static_cast<Uint8>((dst[x * 4 + c] * a + orig[x * 4 + c] * (255 - a)) / 255);
+                }
+            }
+        }
+    }
+
+    if (proxy) SDL_DestroyTexture(proxy);
+    proxy = SDL_CreateTextureFromSurface(renderer, filtered);
+    if (!proxy) SDL_Log("FilterPreview: %s", SDL_GetError());
+    SDL_DestroySurface(filtered);
+    SDL_DestroySurface(base);
+
+    proxyRect = region;
+    proxyVisible = vis;
+    proxyScale = viewScale;
+    if (viewChanged) reprioritize();   // новые видимые тайлы — в начало очереди
+    proxyGeneration = generation;
+}
+
+void FilterPreview::draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY) const {
+    if (!active() || !proxy) return;
+    const float sx = float(proxy->w) / proxyRect.w, sy = float(proxy->h) / proxyRect.h;
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (done[t]) continue;
+        SDL_Rect r = tileRect(t), part;
+        if (!SDL_GetRectIntersection(&r, &proxyVisible, &part)) continue;
+        SDL_FRect src = { (part.x - proxyRect.x) * sx, (part.y - proxyRect.y) * sy, part.w * sx, part.h * sy };
+        SDL_FRect dst = { part.x * scale + offsetX, part.y * scale + offsetY, part.w * scale, part.h * scale };
+        SDL_RenderTexture(renderer, proxy, &src, &dst);
+    }
+}
+
+void FilterPreview::commit(std::function<void(SDL_Rect)> done) {
+    if (!active() || committing()) return;
+    commitDone = std::move(done);
+
+    // Задачи текущего поколения уже стоят в очереди на все неготовые тайлы;
+    // группа commit только дожидается их и завершает просмотр в потоке UI
+    TaskGroupPtr pending = jobs;
+    const Uint32 gen = generation;
+    commitJob = createTaskGroup(std::string("apply ") + filter.name, JobPriority::Normal);
+    submitTask(commitJob, [pending](TaskGroup&) {
+        if (pending) pending->wait();
+    });
+    finishTaskGroup(commitJob, [this, gen](TaskGroup&) {
+        // Просмотр мог быть уже завершён finishCommit или отменён
+        if (committing() && generation == gen) completeCommit();
+    });
+}
+
+void FilterPreview::finishCommit() {
+    if (!committing()) return;
+    commitJob->wait();
+    completeCommit();
+}
+
+void FilterPreview::completeCommit() {
+    std::vector<SDL_Rect> ready;
+    collect(ready);
+    cancelJobs();
+    // Тайлы, которые не досчитались (ошибка выделения памяти), — в этом потоке
+    Params p;
+    p.source = source;
+    p.filter = filter;
+    p.value = filter.value;
+    p.pad = filter.padding ? filter.padding(filter.value) : 0;
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (done[t]) continue;
+        SDL_Rect r = tileRect(t);
+        if (SDL_RectEmpty(&r)) continue;
+        std::vector<Uint8> pixels = renderTile(p, r);
+        if (!pixels.empty()) blendTile(r, pixels.data());
+    }
+    SDL_Rect changed = area;
+    std::function<void(SDL_Rect)> finished = std::move(commitDone);
+    release();
+    if (finished) finished(changed);
+}
+
+SDL_Rect FilterPreview::cancel() {
+    if (!active()) return SDL_Rect{ 0, 0, 0, 0 };
+    cancelJobs();
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        if (done[t]) restoreTile(tileRect(t));
+    }
+    SDL_Rect changed = area;
+    release();
+    return changed;
+}
+
+void FilterPreview::release() {
+    if (proxy) SDL_DestroyTexture(proxy);
+    proxy = nullptr;
+    commitJob.reset();
+    commitDone = nullptr;
+    proxyRect = proxyVisible = SDL_Rect{ 0, 0, 0, 0 };
+    proxyScale = 0.0f;
+    target = nullptr;
+    mask = nullptr;
+    source.reset();
+    done.clear();
+    tilesX = tilesY = 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "selection.h"
+#include "jobs.h"
+
+// Фильтр с одним регулируемым параметром. apply обрабатывает весь surface на месте;
+// scale < 1 — surface уменьшен относительно слоя, пространственные параметры
+// нужно умножить на scale. padding — сколько соседних пикселей нужно фильтру.
+struct PreviewFilter {
+    const char* name = "";
+    float value = 1.0f;
+    float minValue = 0.1f, maxValue = 100.0f;
+    float step = 0.0f;   // шаг клавишами [ и ]; 0 — на 25%
+    std::function<void(SDL_Surface* surface, float value, float scale)> apply;
+    std::function<int(float value)> padding;
+};
+
+// Живой просмотр фильтра над слоем. Сначала фильтр считается по видимой области
+// в разрешении экрана (прокси) и рисуется поверх слоя; затем пул задач считает
+// тайлы в полном разрешении (видимые первыми), и они заменяют прокси по одному.
+// Изменение параметра отменяет группу задач старого поколения и начинает новую;
+// прокрутка и масштаб только переупорядочивают ещё не взятые тайлы.
+class FilterPreview {
+public:
+
+    bool active() const { return target != nullptr; }
+    float value() const { return filter.value; }
+    const PreviewFilter& currentFilter() const { return filter; }
+
+    // Запоминает оригинал слоя; selection должно жить до commit/cancel
+    bool begin(SDL_Surface* layerSurface, const PreviewFilter& previewFilter, const SelectionMask* selection);
+    // Новое значение параметра; в changed попадают тайлы, возвращённые к оригиналу
+    void setValue(float value, std::vector<SDL_Rect>& changed);
+    // Пересчитывает прокси, если видимая область или масштаб изменились (или устарел параметр)
+    void updateView(SDL_Renderer* renderer, SDL_Rect visible, float viewScale);
+    // Переносит готовые тайлы полного разрешения в слой
+    void collect(std::vector<SDL_Rect>& changed);
+    // Прокси поверх ещё не готовых тайлов
+    void draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY) const;
+
+    // Применяет фильтр: оставшиеся тайлы досчитываются в пуле задач (готовые
+    // по-прежнему забирает collect), после последнего просмотр завершается и
+    // в потоке UI вызывается done с изменённой областью
+    void commit(std::function<void(SDL_Rect changed)> done);
+    bool committing() const { return commitJob != nullptr; }
+    // Дожидается начатого commit в этом потоке — перед изменением слоя
+    void finishCommit();
+    // Возвращает слой к оригиналу
+    SDL_Rect cancel();
+
+private:
+    struct Source {
+        SDL_Surface* original = nullptr;
+        ~Source() { SDL_DestroySurface(original); }
+    };
+    struct Params {
+        std::shared_ptr<const Source> source;
+        PreviewFilter filter;
+        float value = 0.0f;
+        int pad = 0;
+    };
+    struct TileResult { Uint32 generation; int tile; std::vector<Uint8> pixels; };
+    // Очередь тайлов поколения: задача берёт следующий тайл в момент запуска,
+    // поэтому порядок можно менять, не отменяя задачи. Следующий — в конце.
+    struct PendingTile { int tile; SDL_Rect rect; };
+    struct Queue {
+        std::mutex mutex;
+        std::vector<PendingTile> tiles;
+    };
+    // Готовые тайлы; задачи держат shared_ptr, поэтому переживают отмену просмотра
+    struct Results {
+        std::mutex mutex;
+        std::vector<TileResult> finished;
+    };
+
+    SDL_Rect tileRect(int tile) const;
+    void schedule();
+    void reprioritize();
+    void cancelJobs();
+    static std::vector<Uint8> renderTile(const Params& params, SDL_Rect rect);
+    void completeCommit();
+    void blendTile(SDL_Rect rect, const Uint8* pixels);
+    void restoreTile(SDL_Rect rect);
+    void release();
+
+    SDL_Surface* target = nullptr;
+    const SelectionMask* mask = nullptr;
+    PreviewFilter filter;
+    std::shared_ptr<const Source> source;
+    SDL_Rect area = { 0, 0, 0, 0 };         // clipRect выделения
+    int tilesX = 0, tilesY = 0, originX = 0, originY = 0;
+    std::vector<bool> done;
+
+    // прокси видимой области
+    SDL_Texture* proxy = nullptr;
+    SDL_Rect proxyRect = { 0, 0, 0, 0 };    // область слоя, покрытая прокси
+    SDL_Rect proxyVisible = { 0, 0, 0, 0 };
+    float proxyScale = 0.0f;
+    Uint32 proxyGeneration = 0;
+
+    // задачи в пуле
+    Uint32 generation = 0;
+    TaskGroupPtr jobs;
+    std::shared_ptr<Queue> queue;
+    TaskGroupPtr commitJob;                 // ждёт задачи поколения после commit
+    std::function<void(SDL_Rect)> commitDone;
+    std::shared_ptr<Results> results = std::make_shared<Results>();
+};
@@ -0,0 +1,180 @@
+#include "raster.h"
+#include <algorithm>
+#include <cfloat>
+#include <math.h>
+
+namespace {
+
+struct Edge {
+    float x0, y0, x1, y1;   // y0 < y1
+    float dxdy;
+    float dir;              // +1 вниз, -1 вверх
+};
+
+// Вклад отрезка в строку аккумулятора (площадь под отрезком по ячейкам).
+// x и xnext уже в пределах [0, w], d — высота отрезка со знаком.
+void accumulateSegment(float* acc, float x, float xnext, float d) {
+    float x0 = std::min(x, xnext);
+    float x1 = std::max(x, xnext);
+    float x0floor = floorf(x0);
+    int x0i = static_cast<int>(x0floor);
+    float x1ceil = ceilf(x1);
+    int x1i = static_cast<int>(x1ceil);
+
+    if (x1i <= x0i + 1) {
+        // отрезок внутри одной ячейки
+        float xmf = 0.5f * (x + xnext) - x0floor;
+        acc[x0i]     += d - d * xmf;
+        acc[x0i + 1] += d * xmf;
+        return;
+    }
+
+    float s = 1.0f / (x1 - x0);
+    float x0f = x0 - x0floor;
+    float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+    float x1f = x1 - x1ceil + 1.0f;
+    float am = 0.5f * s * x1f * x1f;
+
+    acc[x0i] += d * a0;
+    if (x1i == x0i + 2) {
+        acc[x0i + 1] += d * (1.0f - a0 - am);
+    } else {
+        float a1 = s * (1.5f - x0f);
+        acc[x0i + 1] += d * (a1 - a0);
+        for (int xi = x0i + 2; xi < x1i - 1; ++xi) {
+            acc[xi] += d * s;
+        }
+        float a2 = a1 + (x1i - x0i - 3) * s;
+        acc[x1i - 1] += d * (1.0f - a2 - am);
+    }
+    acc[x1i] += d * am;
+}
+
+inline Uint8 resolveCoverage(float sum, FillRule rule) {
+    float v = fabsf(sum);
+    if (rule == FillRule::NonZero) {
+        if (v > 1.0f) v = 1.0f;
+    } else {
+        v = fmodf(v, 2.0f);
+        if (v > 1.0f) v = 2.0f - v;
+    }
+    return static_cast<Uint8>(v * 255.0f + 0.5f);
+}
+
+}
+
+void rasterizePolygon(const std::vector<SDL_FPoint>& polygon, SDL_Rect clip,
+                      FillRule rule, const CoverageRowFn& emit) {
+    int n = static_cast<int>(polygon.size());
+    if (n < 3 || clip.w <= 0 || clip.h <= 0) return;
+
+    // 1) Таблица рёбер (горизонтальные не дают покрытия)
+    std::vector<Edge> edges;
+    edges.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        SDL_FPoint a = polygon[i];
+        SDL_FPoint b = polygon[(i + 1) % n];
+        if (a.y == b.y) continue;
+
+        Edge e;
+        if (a.y < b.y) {
+            e = { a.x, a.y, b.x, b.y, 0.0f, 1.0f };
+        } else {
+            e = { b.x, b.y, a.x, a.y, 0.0f, -1.0f };
+        }
+        e.dxdy = (e.x1 - e.x0) / (e.y1 - e.y0);
+        if (e.y1 <= clip.y || e.y0 >= clip.y + clip.h) continue;
+        edges.push_back(e);
+    }
+    if (edges.empty()) return;
+
+    std::sort(edges.begin(), edges.end(),
+              [](const Edge& l, const Edge& r) { return l.y0 < r.y0; });
+
+    // 2) Построчный проход со списком активных рёбер
+    std::vector<float> acc(clip.w + 2, 0.0f);
+    std::vector<Uint8> line(clip.w);
+    std::vector<const Edge*> active;
+    size_t next = 0;
+
+    int rowBegin = std::max(clip.y, static_cast<int>(floorf(edges.front().y0)));
+    const float width = static_cast<float>(clip.w);
+
+    for (int y = rowBegin; y < clip.y + clip.h; ++y) {
+        float rowTop = static_cast<float>(y);
+        float rowBottom = rowTop + 1.0f;
+
+        while (next < edges.size() && edges[next].y0 < rowBottom) {
+            active.push_back(&edges[next++]);
+        }
+        active.erase(std::remove_if(active.begin(), active.end(),
+                     [rowTop](const Edge* e) { return e->y1 <= rowTop; }), active.end());
+
+        if (active.empty()) {
+            if (next == edges.size()) break;
+            continue;
+        }
+
+        int spanMin = clip.w;
+        for (const Edge* e : active) {
+            float sy0 = std::max(e->y0, rowTop);
+            float sy1 = std::min(e->y1, rowBottom);
+            if (sy1 <= sy0) continue;
+
+            float xa = e->x0 + (sy0 - e->y0) * e->dxdy - clip.x;
+            float xb = e->x0 + (sy1 - e->y0) * e->dxdy - clip.x;
+            xa = std::clamp(xa, 0.0f, width);
+            xb = std::clamp(xb, 0.0f, width);
+
+            accumulateSegment(acc.data(), xa, xb, (sy1 - sy0) * e->dir);
+            spanMin = std::min(spanMin, static_cast<int>(std::min(xa, xb)));
+        }
+        if (spanMin >= clip.w) continue;
+
+        // 3) Префиксная сумма даёт покрытие; левее первого ребра оно нулевое
+        float sum = 0.0f;
+        SDL_memset(line.data(), 0, spanMin);
+        for (int x = spanMin; x < clip.w; ++x) {
+            sum += acc[x];
+            acc[x] = 0.0f;
+            line[x] = resolveCoverage(sum, rule);
+        }
+        acc[clip.w] = acc[clip.w + 1] = 0.0f;
+
+        emit(y, clip.x, clip.w, line.data());
+    }
+}
+
+CoverageMask rasterizePolygonMask(const std::vector<SDL_FPoint>& polygon,
+                                  int clipW, int clipH, FillRule rule) {
+    CoverageMask mask;
+    if (polygon.size() < 3) return mask;
+
+    float minX =  FLT_MAX, minY =  FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (const auto& p : polygon) {
+        minX = std::min(minX, p.x);
+        minY = std::min(minY, p.y);
+        maxX = std::max(maxX, p.x);
+        maxY = std::max(maxY, p.y);
+    }
+
+    int x0 = std::clamp(static_cast<int>(floorf(minX)), 0, clipW);
+    int y0 = std::clamp(static_cast<int>(floorf(minY)), 0, clipH);
+    int x1 = std::clamp(static_cast<int>(ceilf(maxX)), 0, clipW);
+    int y1 = std::clamp(static_cast<int>(ceilf(maxY)), 0, clipH);
+    if (x1 <= x0 || y1 <= y0) return mask;
+
+    mask.x = x0;
+    mask.y = y0;
+    mask.w = x1 - x0;
+    mask.h = y1 - y0;
+    mask.alpha.assign(static_cast<size_t>(mask.w) * mask.h, 0);
+
+    SDL_Rect clip = { x0, y0, mask.w, mask.h };
+    rasterizePolygon(polygon, clip, rule,
+        [&mask](int y, int, int w, const Uint8* coverage) {
+            SDL_memcpy(mask.alpha.data() + static_cast<size_t>(y - mask.y) * mask.w, coverage, w);
+        });
+    return mask;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include <functional>
+
+enum class FillRule {
+    EvenOdd,   // как у pointInPolygon (ray casting)
+    NonZero
+};
+
+// Покрытие полигона: 8 бит на пиксель в пределах bounding box
+struct CoverageMask {
+    int x = 0, y = 0;           // левый верхний угол в координатах поверхности
+    int w = 0, h = 0;
+    std::vector<Uint8> alpha;   // w * h, 0 = снаружи, 255 = внутри
+
+    bool empty() const { return w <= 0 || h <= 0; }
+    const Uint8* row(int yy) const { return alpha.data() + static_cast<size_t>(yy) * w; }
+};
+
+// Строка покрытия: пиксели [x, x + w) строки y
+using CoverageRowFn = std::function<void(int y, int x, int w, const Uint8* coverage)>;
+
+// Сканлайн-растеризатор с таблицей рёбер и аналитическим сглаживанием границы.
+// Стоимость O(H * активные рёбра + площадь), память O(W).
+void rasterizePolygon(const std::vector<SDL_FPoint>& polygon, SDL_Rect clip,
+                      FillRule rule, const CoverageRowFn& emit);
+
+CoverageMask rasterizePolygonMask(const std::vector<SDL_FPoint>& polygon,
+                                  int clipW, int clipH,
+                                  FillRule rule = FillRule::EvenOdd);
+
+// Source-over цвета color с покрытием coverage (0..255) на пиксель RGBA32.
+// Одна формула для всех заливок (floodFill и др.): один цвет даёт одинаковые пиксели
+inline void blendPixel(Uint8* p, SDL_Color color, int coverage) {
+    const int a = coverage * color.a / 255;
+    if (a == 0) return;
+    const int inv = 255 - a;
+    p[0] = static_cast<Uint8>((color.r * a + p[0] * inv) / 255);
+    p[1] = static_cast<Uint8>((color.g * a + p[1] * inv) / 255);
+    p[2] = static_cast<Uint8>((color.b * a + p[2] * inv) / 255);
+    p[3] = static_cast<Uint8>(a + p[3] * inv / 255);
+}
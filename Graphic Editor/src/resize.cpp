@@ -0,0 +1,221 @@
+#include "resize.h"
+#include "parallel.h"
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr int BandRows = 32;   // строк результата на одно задание
+
+// Веса всех выходных отсчётов вдоль одной оси: отсчёт i берёт count[i]
+// подряд идущих входных начиная с first[i], веса — w[i * stride + k]
+struct AxisWeights {
+    std::vector<int> first, count;
+    std::vector<float> w;
+    int stride = 0;
+};
+
+AxisWeights computeWeights(int srcSize, int dstSize, Resample filter) {
+    const float scale = float(dstSize) / float(srcSize);
+    // При уменьшении ядро растягивается на шаг выборки (кроме Nearest)
+    const float stretch = filter == Resample::Nearest ? 1.0f : std::max(1.0f, 1.0f / scale);
+    const float support = resampleSupport(filter) * stretch;
+
+    AxisWeights aw;
+    aw.stride = static_cast<int>(ceilf(support)) * 2 + 1;
+    aw.first.resize(dstSize);
+    aw.count.resize(dstSize);
+    aw.w.assign(static_cast<size_t>(dstSize) * aw.stride, 0.0f);
+
+    for (int i = 0; i < dstSize; ++i) {
+        float center = (i + 0.5f) / scale - 0.5f;
+        int left = static_cast<int>(ceilf(center - support));
+        int right = static_cast<int>(floorf(center + support));
+        int first = std::clamp(left, 0, srcSize - 1);
+        int last = std::clamp(right, 0, srcSize - 1);
+        last = std::min(last, first + aw.stride - 1);
+
+        float* w = &aw.w[static_cast<size_t>(i) * aw.stride];
+        float sum = 0.0f;
+        for (int j = left; j <= right; ++j) {
+            float wt = resampleWeight(filter, (j - center) / stretch);
+            if (wt == 0.0f) continue;
+            // за краем повторяем крайний пиксель
+            int k = std::clamp(std::clamp(j, 0, srcSize - 1) - first, 0, last - first);
+            w[k] += wt;
+            sum += wt;
+        }
+        if (sum == 0.0f) {
+            // ядро не попало ни в один центр (Nearest на границе) — ближайший пиксель
+            first = last = std::clamp(static_cast<int>(floorf(center + 0.5f)), 0, srcSize - 1);
+            w[0] = 1.0f;
+            sum = 1.0f;
+        }
+        for (int k = 0; k <= last - first; ++k) w[k] /= sum;
+        aw.first[i] = first;
+        aw.count[i] = last - first + 1;
+    }
+    return aw;
+}
+
+// Строка RGBA32 -> float RGBA, цвет умножен на альфу
+void premultiplyRow(const Uint8* src, float* dst, int w) {
+    for (int x = 0; x < w; ++x, src += 4, dst += 4) {
+        float a = src[3] / 255.0f;
+        dst[0] = src[0] * a;
+        dst[1] = src[1] * a;
+        dst[2] = src[2] * a;
+        dst[3] = src[3];
+    }
+}
+
+void horizontalPass(const float* src, float* dst, int dstW, const AxisWeights& aw) {
+    for (int x = 0; x < dstW; ++x) {
+        const float* s = src + aw.first[x] * 4;
+        const float* w = &aw.w[static_cast<size_t>(x) * aw.stride];
+        const int n = aw.count[x];
+#if defined(SDL_SSE_INTRINSICS)
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < n; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+        }
+        _mm_storeu_ps(dst + x * 4, acc);
+#elif defined(SDL_NEON_INTRINSICS)
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (int k = 0; k < n; ++k) {
+            acc = vmlaq_n_f32(acc, vld1q_f32(s + k * 4), w[k]);
+        }
+        vst1q_f32(dst + x * 4, acc);
+#else
+        float acc[4] = {0, 0, 0, 0};
+        for (int k = 0; k < n; ++k) {
+            for (int c = 0; c < 4; ++c) acc[c] += w[k] * s[k * 4 + c];
+        }
+        for (int c = 0; c < 4; ++c) dst[x * 4 + c] = acc[c];
+#endif
+    }
+}
+
+// acc += w * row для n чисел
+void multiplyAdd(float* acc, const float* row, float w, int n) {
+    int i = 0;
+#if defined(SDL_SSE_INTRINSICS)
+    const __m128 vw = _mm_set1_ps(w);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(vw, _mm_loadu_ps(row + i))));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), vld1q_f32(row + i), w));
+    }
+#endif
+    for (; i < n; ++i) acc[i] += w * row[i];
+}
+
+void unpremultiplyRow(const float* src, Uint8* dst, int w) {
+    for (int x = 0; x < w; ++x, src += 4, dst += 4) {
+        float a = std::clamp(src[3], 0.0f, 255.0f);
+        if (a < 0.5f) {
+            dst[0] = dst[1] = dst[2] = dst[3] = 0;
+            continue;
+        }
+        // отрицательные лепестки бикубики и Ланцоша обрезаем
+        float k = 255.0f / a;
+        dst[0] = static_cast<Uint8>(std::clamp(src[0] * k + 0.5f, 0.0f, 255.0f));
+        dst[1] = static_cast<Uint8>(std::clamp(src[1] * k + 0.5f, 0.0f, 255.0f));
+        dst[2] = static_cast<Uint8>(std::clamp(src[2] * k + 0.5f, 0.0f, 255.0f));
+        dst[3] = static_cast<Uint8>(a + 0.5f);
+    }
+}
+
+}
+
+SDL_Surface* resizeSurface(SDL_Surface* src, int dstW, int dstH, Resample filter) {
+    if (!src || dstW <= 0 || dstH <= 0) return nullptr;
+    if (src->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("resizeSurface: unsupported pixel format %s", SDL_GetPixelFormatName(src->format));
+        return nullptr;
+    }
+
+    SDL_Surface* dst = SDL_CreateSurface(dstW, dstH, SDL_PIXELFORMAT_RGBA32);
+    if (!dst) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "resizeSurface: %s", SDL_GetError());
+        return nullptr;
+    }
+
+    const AxisWeights wx = computeWeights(src->w, dstW, filter);
+    const AxisWeights wy = computeWeights(src->h, dstH, filter);
+
+    SDL_LockSurface(src);
+    SDL_LockSurface(dst);
+    const Uint8* srcPixels = static_cast<const Uint8*>(src->pixels);
+    Uint8* dstPixels = static_cast<Uint8*>(dst->pixels);
+    const int rowFloats = dstW * 4;
+
+    // Каждая полоса строк результата сама считает нужные ей строки горизонтального
+    // прохода: промежуточный буфер маленький и лежит в кэше своего потока
+    int bands = (dstH + BandRows - 1) / BandRows;
+    parallelFor(0, bands, 1, [&](int from, int to) {
+        std::vector<float> srcRow(static_cast<size_t>(src->w) * 4);
+        std::vector<float> acc(rowFloats);
+        std::vector<float> tmp;
+        for (int b = from; b < to; ++b) {
+            int y0 = b * BandRows;
+            int y1 = std::min(y0 + BandRows, dstH);
+            int r0 = wy.first[y0];
+            int r1 = r0;
+            for (int y = y0; y < y1; ++y) r1 = std::max(r1, wy.first[y] + wy.count[y]);
+
+            tmp.resize(static_cast<size_t>(r1 - r0) * rowFloats);
+            for (int r = r0; r < r1; ++r) {
+                premultiplyRow(srcPixels + r * src->pitch, srcRow.data(), src->w);
+                horizontalPass(srcRow.data(), &tmp[static_cast<size_t>(r - r0) * rowFloats], dstW, wx);
+            }
+
+            for (int y = y0; y < y1; ++y) {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                const float* w = &wy.w[static_cast<size_t>(y) * wy.stride];
+                for (int k = 0; k < wy.count[y]; ++k) {
+                    multiplyAdd(acc.data(), &tmp[static_cast<size_t>(wy.first[y] + k - r0) * rowFloats], w[k], rowFloats);
+                }
+                unpremultiplyRow(acc.data(), dstPixels + y * dst->pitch, dstW);
+            }
+        }
+    });
+
+    SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(src);
+    return dst;
+}
+
+SDL_Surface* resizeCanvas(SDL_Surface* src, int newW, int newH, int offsetX, int offsetY) {
+    if (!src || newW <= 0 || newH <= 0) return nullptr;
+
+    SDL_Surface* dst = SDL_CreateSurface(newW, newH, src->format);
+    if (!dst) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "resizeCanvas: %s", SDL_GetError());
+        return nullptr;
+    }
+
+    // Новый surface уже прозрачный — копируем только пересечение
+    SDL_Rect from = { 0, 0, src->w, src->h };
+    SDL_Rect to = { offsetX, offsetY, src->w, src->h };
+    SDL_Rect bounds = { 0, 0, newW, newH };
+    SDL_Rect part;
+    if (SDL_GetRectIntersection(&to, &bounds, &part)) {
+        from = { part.x - offsetX, part.y - offsetY, part.w, part.h };
+        SDL_LockSurface(src);
+        SDL_LockSurface(dst);
+        const int bpp = SDL_BYTESPERPIXEL(src->format);
+        for (int y = 0; y < part.h; ++y) {
+            SDL_memcpy(static_cast<Uint8*>(dst->pixels) + (part.y + y) * dst->pitch + part.x * bpp,
+                       static_cast<const Uint8*>(src->pixels) + (from.y + y) * src->pitch + from.x * bpp,
+                       part.w * bpp);
+        }
+        SDL_UnlockSurface(dst);
+        SDL_UnlockSurface(src);
+    }
+    return dst;
+}
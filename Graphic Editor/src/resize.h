@@ -0,0 +1,14 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "transform.h"
+
+// Новый surface RGBA32 dstW x dstH с содержимым src, отмасштабированным
+// сепарабельным фильтром (Nearest, Box, Bilinear, Bicubic, Lanczos3).
+// При уменьшении ядро растягивается на шаг выборки — без алиасинга.
+// Веса считаются заранее для каждой оси, расчёт идёт в премультиплицированной
+// альфе полосами строк результата на всех ядрах.
+SDL_Surface* resizeSurface(SDL_Surface* src, int dstW, int dstH, Resample filter);
+
+// Новый surface newW x newH: содержимое src сдвинуто на (offsetX, offsetY),
+// остальное прозрачно, выходящее за край обрезается
+SDL_Surface* resizeCanvas(SDL_Surface* src, int newW, int newH, int offsetX, int offsetY);
@@ -0,0 +1,480 @@
+#include "selection.h"
+#include "distance.h"
+#include "parallel.h"
+#include <algorithm>
+#include <math.h>
+#include <SDL3/SDL_intrin.h>
+
+namespace {
+
+constexpr int TileArea = SelectionMask::TileSize * SelectionMask::TileSize;
+
+// Побайтовые операции над покрытием, 16 пикселей за шаг
+void unionBytes(Uint8* dst, const Uint8* src, size_t n) {
+    size_t i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(d, s));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vmaxq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = std::max(dst[i], src[i]);
+}
+
+// dst * (1 - src) приближаем как min(dst, 255 - src)
+void subtractBytes(Uint8* dst, const Uint8* src, size_t n) {
+    size_t i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (; i + 16 <= n; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_min_epu8(d, _mm_xor_si128(s, ones)));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vminq_u8(vld1q_u8(dst + i), vmvnq_u8(vld1q_u8(src + i))));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = std::min<Uint8>(dst[i], 255 - src[i]);
+}
+
+void intersectBytes(Uint8* dst, const Uint8* src, size_t n) {
+    size_t i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_min_epu8(d, s));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vminq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = std::min(dst[i], src[i]);
+}
+
+void invertBytes(Uint8* dst, size_t n) {
+    size_t i = 0;
+#if defined(SDL_SSE2_INTRINSICS)
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (; i + 16 <= n; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, ones));
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vmvnq_u8(vld1q_u8(dst + i)));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = 255 - dst[i];
+}
+
+// Квадраты расстояний от каждого пикселя до ближайшего пикселя, где source(coverage) истинно
+template <typename Pred>
+std::vector<float> distanceField(const std::vector<Uint8>& coverage, int w, int h, Pred source) {
+    std::vector<float> dist(coverage.size());
+    for (size_t i = 0; i < coverage.size(); ++i) {
+        dist[i] = source(coverage[i]) ? 0.0f : DistanceInf;
+    }
+    distanceTransform(dist, w, h);
+    return dist;
+}
+
+bool allEqual(const Uint8* p, size_t n, Uint8 v) {
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] != v) return false;
+    }
+    return true;
+}
+
+}
+
+Uint8* SelectionMask::Tile::materialize() {
+    if (!data) {
+        data.reset(new Uint8[TileArea]);
+        SDL_memset(data.get(), fill, TileArea);
+    }
+    return data.get();
+}
+
+void SelectionMask::Tile::compact() {
+    if (data && allEqual(data.get(), TileArea, data[0])) {
+        fill = data[0];
+        data.reset();
+    }
+}
+
+void SelectionMask::reset(int width, int height) {
+    w = std::max(width, 0);
+    h = std::max(height, 0);
+    tilesX = (w + TileSize - 1) / TileSize;
+    tilesY = (h + TileSize - 1) / TileSize;
+    tiles.clear();
+    tiles.resize(static_cast<size_t>(tilesX) * tilesY);
+    cachedBounds = {0, 0, 0, 0};
+    boundsDirty = false;
+}
+
+SDL_Rect SelectionMask::tileRect(int tx, int ty) const {
+    SDL_Rect r = { tx * TileSize, ty * TileSize, TileSize, TileSize };
+    r.w = std::min(r.w, w - r.x);
+    r.h = std::min(r.h, h - r.y);
+    return r;
+}
+
+const SDL_Rect& SelectionMask::bounds() const {
+    if (!boundsDirty) return cachedBounds;
+
+    int minX = w, minY = h, maxX = 0, maxY = 0;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            const Tile& t = tileAt(tx, ty);
+            SDL_Rect r = tileRect(tx, ty);
+            if (t.uniform()) {
+                if (t.fill == 0) continue;
+                minX = std::min(minX, r.x);
+                minY = std::min(minY, r.y);
+                maxX = std::max(maxX, r.x + r.w);
+                maxY = std::max(maxY, r.y + r.h);
+                continue;
+            }
+            for (int yy = 0; yy < r.h; ++yy) {
+                const Uint8* row = t.data.get() + yy * TileSize;
+                for (int xx = 0; xx < r.w; ++xx) {
+                    if (!row[xx]) continue;
+                    minX = std::min(minX, r.x + xx);
+                    minY = std::min(minY, r.y + yy);
+                    maxX = std::max(maxX, r.x + xx + 1);
+                    maxY = std::max(maxY, r.y + yy + 1);
+                }
+            }
+        }
+    }
+
+    if (maxX > minX && maxY > minY) {
+        cachedBounds = { minX, minY, maxX - minX, maxY - minY };
+    } else {
+        cachedBounds = { 0, 0, 0, 0 };
+    }
+    boundsDirty = false;
+    return cachedBounds;
+}
+
+SDL_Rect SelectionMask::clipRect(int surfaceW, int surfaceH) const {
+    SDL_Rect surfaceRect = { 0, 0, surfaceW, surfaceH };
+    if (!active()) return surfaceRect;
+
+    SDL_Rect result;
+    if (!SDL_GetRectIntersection(&bounds(), &surfaceRect, &result)) {
+        return SDL_Rect{0, 0, 0, 0};
+    }
+    return result;
+}
+
+Uint8 SelectionMask::at(int x, int y) const {
+    if (x < 0 || y < 0 || x >= w || y >= h) return 0;
+    const Tile& t = tileAt(x / TileSize, y / TileSize);
+    if (t.uniform()) return t.fill;
+    return t.data[(y % TileSize) * TileSize + (x % TileSize)];
+}
+
+void SelectionMask::readRow(int y, int x, int count, Uint8* out) const {
+    if (y < 0 || y >= h) {
+        SDL_memset(out, 0, count);
+        return;
+    }
+    int end = x + count;
+    int cx = x;
+    while (cx < end) {
+        if (cx < 0 || cx >= w) {
+            int stop = cx < 0 ? std::min(0, end) : end;
+            SDL_memset(out + (cx - x), 0, stop - cx);
+            cx = stop;
+            continue;
+        }
+        int tx = cx / TileSize;
+        int stop = std::min({ end, (tx + 1) * TileSize, w });
+        const Tile& t = tileAt(tx, y / TileSize);
+        if (t.uniform()) {
+            SDL_memset(out + (cx - x), t.fill, stop - cx);
+        } else {
+            SDL_memcpy(out + (cx - x), t.data.get() + (y % TileSize) * TileSize + (cx % TileSize), stop - cx);
+        }
+        cx = stop;
+    }
+}
+
+void SelectionMask::writeRow(int y, int x, int count, const Uint8* src) {
+    int end = std::min(x + count, w);
+    int cx = std::max(x, 0);
+    while (cx < end) {
+        int tx = cx / TileSize;
+        int stop = std::min(end, (tx + 1) * TileSize);
+        Tile& t = tileAt(tx, y / TileSize);
+        const Uint8* s = src + (cx - x);
+        if (!t.uniform() || !allEqual(s, stop - cx, t.fill)) {
+            SDL_memcpy(t.materialize() + (y % TileSize) * TileSize + (cx % TileSize), s, stop - cx);
+        }
+        cx = stop;
+    }
+    boundsDirty = true;
+}
+
+void SelectionMask::clear() {
+    for (Tile& t : tiles) {
+        t.data.reset();
+        t.fill = 0;
+    }
+    cachedBounds = {0, 0, 0, 0};
+    boundsDirty = false;
+}
+
+void SelectionMask::selectAll() {
+    for (Tile& t : tiles) {
+        t.data.reset();
+        t.fill = 255;
+    }
+    cachedBounds = {0, 0, w, h};
+    boundsDirty = false;
+}
+
+void SelectionMask::invert() {
+    for (Tile& t : tiles) {
+        if (t.uniform()) {
+            t.fill = 255 - t.fill;
+        } else {
+            invertBytes(t.data.get(), TileArea);
+        }
+    }
+    boundsDirty = true;
+}
+
+void SelectionMask::combineTile(Tile& dst, const Tile& src, SelectionOp op) {
+    // Быстрые пути для однородных тайлов: без прохода по пикселям
+    if (src.uniform()) {
+        Uint8 v = src.fill;
+        if ((op == SelectionOp::Add && v == 0) ||
+            (op == SelectionOp::Subtract && v == 0) ||
+            (op == SelectionOp::Intersect && v == 255)) {
+            return;
+        }
+        if ((op == SelectionOp::Add && v == 255) ||
+            (op == SelectionOp::Subtract && v == 255) ||
+            (op == SelectionOp::Intersect && v == 0)) {
+            dst.data.reset();
+            dst.fill = (op == SelectionOp::Add) ? 255 : 0;
+            return;
+        }
+    }
+    if (dst.uniform()) {
+        Uint8 v = dst.fill;
+        if ((op == SelectionOp::Add && v == 255) ||
+            (op == SelectionOp::Subtract && v == 0) ||
+            (op == SelectionOp::Intersect && v == 0)) {
+            return;
+        }
+        if (!src.uniform() &&
+            ((op == SelectionOp::Add && v == 0) || (op == SelectionOp::Intersect && v == 255))) {
+            dst.data.reset(new Uint8[TileArea]);
+            SDL_memcpy(dst.data.get(), src.data.get(), TileArea);
+            return;
+        }
+    }
+
+    Uint8 constant[TileArea];
+    const Uint8* s = src.data.get();
+    if (!s) {
+        SDL_memset(constant, src.fill, TileArea);
+        s = constant;
+    }
+    Uint8* d = dst.materialize();
+    switch (op) {
+        case SelectionOp::Add:       unionBytes(d, s, TileArea); break;
+        case SelectionOp::Subtract:  subtractBytes(d, s, TileArea); break;
+        case SelectionOp::Intersect: intersectBytes(d, s, TileArea); break;
+        default: break;
+    }
+    dst.compact();
+}
+
+void SelectionMask::combine(const SelectionMask& other, SelectionOp op) {
+    if (other.w != w || other.h != h) {
+        SDL_Log("SelectionMask::combine: size mismatch %dx%d vs %dx%d", w, h, other.w, other.h);
+        return;
+    }
+
+    if (op == SelectionOp::Replace) {
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            const Tile& s = other.tiles[i];
+            tiles[i].fill = s.fill;
+            tiles[i].data.reset();
+            if (!s.uniform()) {
+                tiles[i].data.reset(new Uint8[TileArea]);
+                SDL_memcpy(tiles[i].data.get(), s.data.get(), TileArea);
+            }
+        }
+        cachedBounds = other.bounds();
+        boundsDirty = false;
+        return;
+    }
+
+    // Работаем только с тайлами внутри bounding box участвующих выделений
+    SDL_Rect area = (op == SelectionOp::Intersect) ? bounds() : other.bounds();
+    if (op == SelectionOp::Subtract) {
+        SDL_Rect both;
+        if (!SDL_GetRectIntersection(&bounds(), &other.bounds(), &both)) return;
+        area = both;
+    }
+    if (SDL_RectEmpty(&area)) return;
+
+    int tx0 = area.x / TileSize;
+    int ty0 = area.y / TileSize;
+    int tx1 = (area.x + area.w - 1) / TileSize;
+    int ty1 = (area.y + area.h - 1) / TileSize;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            combineTile(tileAt(tx, ty), other.tileAt(tx, ty), op);
+        }
+    }
+    boundsDirty = true;
+}
+
+void SelectionMask::combine(const CoverageMask& mask, SelectionOp op) {
+    SelectionMask tmp;
+    tmp.reset(w, h);
+    for (int yy = 0; yy < mask.h; ++yy) {
+        int y = mask.y + yy;
+        if (y < 0 || y >= h) continue;
+        tmp.writeRow(y, mask.x, mask.w, mask.row(yy));
+    }
+    for (Tile& t : tmp.tiles) t.compact();
+    combine(tmp, op);
+}
+
+void SelectionMask::combineRect(SDL_Rect rect, SelectionOp op) {
+    SDL_Rect canvas = { 0, 0, w, h };
+    SDL_Rect r;
+    SelectionMask tmp;
+    tmp.reset(w, h);
+
+    if (SDL_GetRectIntersection(&rect, &canvas, &r)) {
+        std::vector<Uint8> full(r.w, 255);
+        int tx0 = r.x / TileSize, tx1 = (r.x + r.w - 1) / TileSize;
+        int ty0 = r.y / TileSize, ty1 = (r.y + r.h - 1) / TileSize;
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                SDL_Rect tr = tmp.tileRect(tx, ty);
+                SDL_Rect part;
+                SDL_GetRectIntersection(&tr, &r, &part);
+                if (SDL_RectsEqual(&part, &tr)) {
+                    tmp.tileAt(tx, ty).fill = 255;   // тайл целиком внутри
+                    continue;
+                }
+                for (int y = part.y; y < part.y + part.h; ++y) {
+                    tmp.writeRow(y, part.x, part.w, full.data());
+                }
+            }
+        }
+        tmp.boundsDirty = true;
+    }
+    combine(tmp, op);
+}
+
+void SelectionMask::combinePolygon(const std::vector<SDL_FPoint>& polygon, SelectionOp op) {
+    combine(rasterizePolygonMask(polygon, w, h), op);
+}
+
+std::vector<Uint8> SelectionMask::readRegion(const SDL_Rect& area) const {
+    std::vector<Uint8> coverage(static_cast<size_t>(area.w) * area.h);
+    for (int yy = 0; yy < area.h; ++yy) {
+        readRow(area.y + yy, area.x, area.w, coverage.data() + static_cast<size_t>(yy) * area.w);
+    }
+    return coverage;
+}
+
+void SelectionMask::replaceRegion(const SDL_Rect& area, const std::vector<Uint8>& coverage) {
+    for (int yy = 0; yy < area.h; ++yy) {
+        writeRow(area.y + yy, area.x, area.w, coverage.data() + static_cast<size_t>(yy) * area.w);
+    }
+    int tx0 = area.x / TileSize, tx1 = (area.x + area.w - 1) / TileSize;
+    int ty0 = area.y / TileSize, ty1 = (area.y + area.h - 1) / TileSize;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) tileAt(tx, ty).compact();
+    }
+    boundsDirty = true;
+}
+
+SDL_Rect SelectionMask::inflatedBounds(int by) const {
+    const SDL_Rect& b = bounds();
+    int x0 = std::max(0, b.x - by);
+    int y0 = std::max(0, b.y - by);
+    int x1 = std::min(w, b.x + b.w + by);
+    int y1 = std::min(h, b.y + b.h + by);
+    return SDL_Rect{ x0, y0, x1 - x0, y1 - y0 };
+}
+
+void SelectionMask::grow(float radius) {
+    if (radius <= 0.0f || !active()) return;
+
+    SDL_Rect area = inflatedBounds(static_cast<int>(ceilf(radius)) + 1);
+    std::vector<Uint8> coverage = readRegion(area);
+    std::vector<float> dist = distanceField(coverage, area.w, area.h,
+                                            [](Uint8 c) { return c >= 128; });
+
+    parallelFor(0, area.h, 64, [&](int from, int to) {
+        for (size_t i = static_cast<size_t>(from) * area.w; i < static_cast<size_t>(to) * area.w; ++i) {
+            float a = std::clamp(radius + 1.0f - sqrtf(dist[i]), 0.0f, 1.0f);
+            coverage[i] = std::max(coverage[i], static_cast<Uint8>(a * 255.0f + 0.5f));
+        }
+    });
+    replaceRegion(area, coverage);
+}
+
+void SelectionMask::shrink(float radius) {
+    if (radius <= 0.0f || !active()) return;
+
+    // +1 пиксель, чтобы увидеть невыделенных соседей у границы bounding box
+    SDL_Rect area = inflatedBounds(1);
+    std::vector<Uint8> coverage = readRegion(area);
+    std::vector<float> dist = distanceField(coverage, area.w, area.h,
+                                            [](Uint8 c) { return c < 128; });
+
+    parallelFor(0, area.h, 64, [&](int from, int to) {
+        for (size_t i = static_cast<size_t>(from) * area.w; i < static_cast<size_t>(to) * area.w; ++i) {
+            float a = std::clamp(sqrtf(dist[i]) - radius, 0.0f, 1.0f);
+            coverage[i] = std::min(coverage[i], static_cast<Uint8>(a * 255.0f + 0.5f));
+        }
+    });
+    replaceRegion(area, coverage);
+}
+
+void SelectionMask::feather(float radius) {
+    if (radius <= 0.0f || !active()) return;
+
+    SDL_Rect area = inflatedBounds(static_cast<int>(ceilf(radius)) + 1);
+    std::vector<Uint8> coverage = readRegion(area);
+    std::vector<float> toOutside = distanceField(coverage, area.w, area.h,
+                                                 [](Uint8 c) { return c < 128; });
+    std::vector<float> toInside = distanceField(coverage, area.w, area.h,
+                                                [](Uint8 c) { return c >= 128; });
+
+    // Знаковое расстояние до границы (граница — между центрами пикселей),
+    // затем плавный переход шириной 2 * radius
+    parallelFor(0, area.h, 64, [&](int from, int to) {
+        for (size_t i = static_cast<size_t>(from) * area.w; i < static_cast<size_t>(to) * area.w; ++i) {
+            float s = coverage[i] >= 128 ? sqrtf(toOutside[i]) - 0.5f
+                                         : 0.5f - sqrtf(toInside[i]);
+            float t = std::clamp(0.5f + s / (2.0f * radius), 0.0f, 1.0f);
+            t = t * t * (3.0f - 2.0f * t);
+            coverage[i] = static_cast<Uint8>(t * 255.0f + 0.5f);
+        }
+    });
+    replaceRegion(area, coverage);
+}
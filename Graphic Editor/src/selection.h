@@ -0,0 +1,76 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include <memory>
+#include "raster.h"
+
+enum class SelectionOp {
+    Replace,
+    Add,        // объединение
+    Subtract,
+    Intersect
+};
+
+// Маска выделения: 8 бит покрытия на пиксель, хранится разреженно тайлами.
+// Однородный тайл (всё 0 или всё 255) не занимает памяти.
+class SelectionMask {
+public:
+    static constexpr int TileSize = 64;
+
+    void reset(int width, int height);   // пустое выделение размером с холст
+    int width() const { return w; }
+    int height() const { return h; }
+
+    // Есть ли хоть один выделенный пиксель
+    bool active() const { return !SDL_RectEmpty(&bounds()); }
+    // Кэшированный bounding box ненулевого покрытия
+    const SDL_Rect& bounds() const;
+    // Область, которую должен обработать инструмент/фильтр:
+    // без выделения — вся поверхность, иначе bounds() ∩ поверхность
+    SDL_Rect clipRect(int surfaceW, int surfaceH) const;
+
+    Uint8 at(int x, int y) const;
+    // Покрытие строки y в диапазоне [x, x + count) (вне холста — 0)
+    void readRow(int y, int x, int count, Uint8* out) const;
+
+    void clear();
+    void selectAll();
+    void invert();
+
+    void combine(const SelectionMask& other, SelectionOp op);
+    void combine(const CoverageMask& mask, SelectionOp op);
+    void combineRect(SDL_Rect rect, SelectionOp op);
+    void combinePolygon(const std::vector<SDL_FPoint>& polygon, SelectionOp op);
+
+    // Расширение/сужение на radius пикселей и растушёвка границы.
+    // Считаются через точное преобразование расстояния, стоимость не растёт с радиусом.
+    void grow(float radius);
+    void shrink(float radius);
+    void feather(float radius);
+
+private:
+    struct Tile {
+        Uint8 fill = 0;                       // значение однородного тайла
+        std::unique_ptr<Uint8[]> data;        // nullptr — тайл однородный
+
+        bool uniform() const { return !data; }
+        Uint8* materialize();
+        void compact();                       // однородный буфер -> fill
+    };
+
+    int w = 0, h = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<Tile> tiles;
+
+    mutable SDL_Rect cachedBounds = {0, 0, 0, 0};
+    mutable bool boundsDirty = false;
+
+    Tile& tileAt(int tx, int ty) { return tiles[ty * tilesX + tx]; }
+    const Tile& tileAt(int tx, int ty) const { return tiles[ty * tilesX + tx]; }
+    SDL_Rect tileRect(int tx, int ty) const;
+    void writeRow(int y, int x, int count, const Uint8* src);
+    std::vector<Uint8> readRegion(const SDL_Rect& area) const;
+    void replaceRegion(const SDL_Rect& area, const std::vector<Uint8>& coverage);
+    SDL_Rect inflatedBounds(int by) const;
+    void combineTile(Tile& dst, const Tile& src, SelectionOp op);
+};
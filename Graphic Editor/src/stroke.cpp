@@ -0,0 +1,278 @@
+#include "stroke.h"
+#include "raster.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Catmull–Rom между b и c по соседним a и d
+float catmullRom(float a, float b, float c, float d, float t) {
+    return 0.5f * (2.0f * b + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t * t
+                   + (3.0f * b - a - 3.0f * c + d) * t * t * t);
+}
+
+Uint64 lerpTime(Uint64 t0, Uint64 t1, float t) {
+    return t1 >= t0 ? t0 + static_cast<Uint64>((t1 - t0) * static_cast<double>(t)) : t0;
+}
+
+}
+
+StrokeSampler::StrokeSampler() {
+    thread = std::thread([this] { run(); });
+}
+
+StrokeSampler::~StrokeSampler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void StrokeSampler::begin(float x, float y, float radius, Uint64 timestamp) {
+    BrushSample s;
+    s.kind = BrushSample::Begin;
+    s.x = x;
+    s.y = y;
+    s.radius = radius;
+    s.timestamp = timestamp;
+    submit(s);
+}
+
+void StrokeSampler::addPoint(float x, float y, Uint64 timestamp) {
+    BrushSample s;
+    s.x = x;
+    s.y = y;
+    s.timestamp = timestamp;
+    submit(s);
+}
+
+size_t StrokeSampler::drain(std::vector<BrushDab>& out) {
+    size_t n = 0;
+    BrushDab dab;
+    while (output.pop(dab)) {
+        out.push_back(dab);
+        ++n;
+    }
+    return n;
+}
+
+void StrokeSampler::end(Uint64 timestamp, std::vector<BrushDab>& out) {
+    BrushSample s;
+    s.kind = BrushSample::End;
+    s.timestamp = timestamp;
+    submit(s);
+    // Выходной буфер разгружаем и во время ожидания — иначе поток может встать на полном буфере
+    while (processed.load(std::memory_order_acquire) < submitted) {
+        if (!drain(out)) std::this_thread::yield();
+    }
+    drain(out);
+}
+
+void StrokeSampler::submit(const BrushSample& sample) {
+    // Буфер на 4096 точек переполняется, только если поток штриха стоит; ждём его
+    while (!input.push(sample)) std::this_thread::yield();
+    ++submitted;
+    // Флаг и notify — под мьютексом: поток штриха не пропустит пробуждение
+    // между проверкой условия и засыпанием
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    pending = true;
+    wake.notify_one();
+}
+
+void StrokeSampler::run() {
+    BrushSample sample;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending; });
+            if (stopping) return;
+            // Сбрасываем до разбора: точка, положенная позже, снова поднимет флаг
+            pending = false;
+        }
+        while (input.pop(sample)) {
+            process(sample);
+            processed.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+void StrokeSampler::process(const BrushSample& s) {
+    switch (s.kind) {
+    case BrushSample::Begin:
+        radius = s.radius;
+        spacing = std::max(1.5f, radius * 0.25f);
+        toNext = spacing;
+        window[0] = s;
+        count = 1;
+        place(s.x, s.y, s.timestamp);
+        break;
+
+    case BrushSample::Move: {
+        if (count == 0) break;   // движение без нажатия
+        const BrushSample& last = window[count - 1];
+        if (std::fabs(s.x - last.x) < 0.01f && std::fabs(s.y - last.y) < 0.01f) break;
+        if (count == 4) {
+            std::copy(window + 1, window + 4, window);
+            count = 3;
+        }
+        window[count++] = s;
+        // Участок между предпоследними точками готов, когда известна следующая
+        if (count == 3) segment(window[0], window[0], window[1], window[2]);
+        if (count == 4) segment(window[0], window[1], window[2], window[3]);
+        break;
+    }
+
+    case BrushSample::End:
+        if (count == 2) segment(window[0], window[0], window[1], window[1]);
+        if (count >= 3) segment(window[count - 3], window[count - 2], window[count - 1], window[count - 1]);
+        count = 0;
+        break;
+    }
+}
+
+void StrokeSampler::segment(const BrushSample& a, const BrushSample& b, const BrushSample& c, const BrushSample& d) {
+    // Кривая разбивается на отрезки по ~2 единицы, по ним шагаем с постоянным интервалом
+    const float chord = std::hypot(c.x - b.x, c.y - b.y);
+    const int pieces = std::max(1, static_cast<int>(std::ceil(chord / 2.0f)));
+    float px = b.x, py = b.y;
+    Uint64 pt = b.timestamp;
+    for (int i = 1; i <= pieces; ++i) {
+        const float t = static_cast<float>(i) / pieces;
+        const float qx = catmullRom(a.x, b.x, c.x, d.x, t);
+        const float qy = catmullRom(a.y, b.y, c.y, d.y, t);
+        const Uint64 qt = lerpTime(b.timestamp, c.timestamp, t);
+        walk(px, py, qx, qy, pt, qt);
+        px = qx;
+        py = qy;
+        pt = qt;
+    }
+}
+
+void StrokeSampler::walk(float x0, float y0, float x1, float y1, Uint64 t0, Uint64 t1) {
+    const float length = std::hypot(x1 - x0, y1 - y0);
+    float pos = 0.0f;
+    while (length - pos >= toNext) {
+        pos += toNext;
+        const float t = pos / length;
+        place(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, lerpTime(t0, t1, t));
+        toNext = spacing;
+    }
+    toNext -= length - pos;
+}
+
+void StrokeSampler::place(float x, float y, Uint64 timestamp) {
+    const BrushDab dab = { x, y, radius, timestamp };
+    // UI забирает отпечатки каждый кадр и при end(); до тех пор ждём
+    while (!output.push(dab)) {
+        if (stopping) return;
+        std::this_thread::yield();
+    }
+}
+
+void StrokeOverlay::release() {
+    if (texture) SDL_DestroyTexture(texture);
+    if (pixels) SDL_DestroySurface(pixels);
+    texture = nullptr;
+    pixels = nullptr;
+    visible = false;
+}
+
+bool StrokeOverlay::begin(SDL_Renderer* renderer, int width, int height, SDL_Color c) {
+    if (!pixels || !texture || pixels->w != width || pixels->h != height) {
+        release();
+        pixels = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+        if (!pixels) {
+            SDL_Log("StrokeOverlay: SDL_CreateSurface failed: %s", SDL_GetError());
+            return false;
+        }
+        SDL_FillSurfaceRect(pixels, nullptr, 0);
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!texture) {
+            SDL_Log("StrokeOverlay: SDL_CreateTexture failed: %s", SDL_GetError());
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        SDL_UpdateTexture(texture, nullptr, pixels->pixels, pixels->pitch);
+    }
+    color = SDL_MapSurfaceRGBA(pixels, c.r, c.g, c.b, c.a);
+    dirty = touched = { 0, 0, 0, 0 };
+    visible = true;
+    return true;
+}
+
+SDL_Rect StrokeOverlay::dabRect(const BrushDab& dab) {
+    return SDL_Rect{
+        static_cast<int>(dab.x - dab.radius),
+        static_cast<int>(dab.y - dab.radius),
+        static_cast<int>(2 * dab.radius),
+        static_cast<int>(2 * dab.radius)
+    };
+}
+
+void StrokeOverlay::addDabs(const std::vector<BrushDab>& dabs) {
+    if (!visible) return;
+    const SDL_Rect bounds = { 0, 0, pixels->w, pixels->h };
+    for (const BrushDab& dab : dabs) {
+        SDL_Rect r = dabRect(dab);
+        if (!SDL_GetRectIntersection(&r, &bounds, &r)) continue;
+        SDL_FillSurfaceRect(pixels, &r, color);
+        SDL_GetRectUnion(&dirty, &r, &dirty);
+    }
+}
+
+void StrokeOverlay::draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY) {
+    if (!visible || !texture) return;
+    if (!SDL_RectEmpty(&dirty)) {
+        const Uint8* src = static_cast<const Uint8*>(pixels->pixels)
+                         + dirty.y * pixels->pitch + dirty.x * SDL_BYTESPERPIXEL(pixels->format);
+        SDL_UpdateTexture(texture, &dirty, src, pixels->pitch);
+        SDL_GetRectUnion(&touched, &dirty, &touched);
+        dirty = { 0, 0, 0, 0 };
+    }
+    SDL_FRect dst = { offsetX, offsetY, pixels->w * scale, pixels->h * scale };
+    SDL_RenderTexture(renderer, texture, nullptr, &dst);
+}
+
+SDL_Rect StrokeOverlay::bounds() const {
+    SDL_Rect r;
+    SDL_GetRectUnion(&touched, &dirty, &r);
+    return r;
+}
+
+void StrokeOverlay::composite(SDL_Surface* target) const {
+    if (!visible || !target) return;
+    if (target->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Log("StrokeOverlay: unsupported target format %s", SDL_GetPixelFormatName(target->format));
+        return;
+    }
+    SDL_Rect area = bounds();
+    const SDL_Rect clip = { 0, 0, target->w, target->h };
+    if (!SDL_GetRectIntersection(&area, &clip, &area)) return;
+
+    SDL_LockSurface(target);
+    for (int y = area.y; y < area.y + area.h; ++y) {
+        const Uint8* src = static_cast<const Uint8*>(pixels->pixels) + y * pixels->pitch;
+        Uint8* dst = static_cast<Uint8*>(target->pixels) + y * target->pitch;
+        for (int x = area.x; x < area.x + area.w; ++x) {
+            const Uint8* s = src + x * 4;
+            if (s[3]) blendPixel(dst + x * 4, SDL_Color{ s[0], s[1], s[2], 255 }, s[3]);
+        }
+    }
+    SDL_UnlockSurface(target);
+}
+
+void StrokeOverlay::end() {
+    if (!visible) return;
+    visible = false;
+    // Стираем только то, чего касался штрих: поверхность переиспользуется следующим
+    SDL_GetRectUnion(&touched, &dirty, &touched);
+    if (!SDL_RectEmpty(&touched)) {
+        SDL_FillSurfaceRect(pixels, &touched, 0);
+        const Uint8* src = static_cast<const Uint8*>(pixels->pixels)
+                         + touched.y * pixels->pitch + touched.x * SDL_BYTESPERPIXEL(pixels->format);
+        if (texture) SDL_UpdateTexture(texture, &touched, src, pixels->pitch);
+    }
+    dirty = touched = { 0, 0, 0, 0 };
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+
+// Точка ввода кисти в мировых координатах; timestamp — из события SDL (нс)
+struct BrushSample {
+    enum Kind : Uint8 { Begin, Move, End };
+    float x = 0.0f, y = 0.0f;
+    float radius = 0.0f;          // только для Begin
+    Uint64 timestamp = 0;
+    Kind kind = Move;
+};
+
+// Отпечаток кисти в мировых координатах
+struct BrushDab {
+    float x, y, radius;
+    Uint64 timestamp;
+};
+
+// Поток штриха: поток UI кладёт каждое событие движения в кольцевой буфер,
+// отдельный поток сглаживает путь (Catmull–Rom по соседним точкам) и расставляет
+// отпечатки с шагом по длине дуги — с частотой ввода, а не кадров. Готовые
+// отпечатки забираются потоком UI через второй буфер.
+class StrokeSampler {
+public:
+    StrokeSampler();
+    ~StrokeSampler();
+    StrokeSampler(const StrokeSampler&) = delete;
+    StrokeSampler& operator=(const StrokeSampler&) = delete;
+
+    // Только из потока UI
+    void begin(float x, float y, float radius, Uint64 timestamp);
+    void addPoint(float x, float y, Uint64 timestamp);
+    // Готовые отпечатки; возвращает, сколько добавлено
+    size_t drain(std::vector<BrushDab>& out);
+    // Завершает штрих и ждёт, пока поток расставит все отпечатки
+    void end(Uint64 timestamp, std::vector<BrushDab>& out);
+
+private:
+    void submit(const BrushSample& sample);
+    void run();
+    void process(const BrushSample& sample);
+    void segment(const BrushSample& a, const BrushSample& b, const BrushSample& c, const BrushSample& d);
+    void walk(float x0, float y0, float x1, float y1, Uint64 t0, Uint64 t1);
+    void place(float x, float y, Uint64 timestamp);
+
+    SpscRing<BrushSample, 4096> input;     // UI -> поток штриха
+    SpscRing<BrushDab, 16384> output;      // поток штриха -> UI
+    Uint64 submitted = 0;                  // пишет только UI
+    std::atomic<Uint64> processed{ 0 };
+
+    std::thread thread;
+    std::atomic<bool> stopping{ false };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool pending = false;                  // есть новые точки; под sleepMutex
+
+    // состояние потока штриха
+    BrushSample window[4];
+    int count = 0;
+    float radius = 0.0f;
+    float spacing = 1.5f;
+    float toNext = 0.0f;      // длина дуги до следующего отпечатка
+};
+
+// Текущий штрих поверх слоя: новые отпечатки растеризуются в поверхность размера
+// холста, в текстуру загружается только изменившийся прямоугольник, рисуется
+// одним квадом. Стоимость кадра зависит от числа новых отпечатков, а не от длины штриха.
+class StrokeOverlay {
+public:
+    StrokeOverlay() = default;
+    StrokeOverlay(const StrokeOverlay&) = delete;
+    StrokeOverlay& operator=(const StrokeOverlay&) = delete;
+    ~StrokeOverlay() { release(); }
+
+    bool active() const { return visible; }
+    // Начинает штрих над холстом width x height
+    bool begin(SDL_Renderer* renderer, int width, int height, SDL_Color color);
+    // Отпечаток — квадрат 2r x 2r, как прямоугольники готового штриха
+    void addDabs(const std::vector<BrushDab>& dabs);
+    // Загружает накопленные изменения и рисует поверх холста
+    void draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY);
+    // Всё, что нарисовано за штрих (координаты холста)
+    SDL_Rect bounds() const;
+    // Переносит пиксели штриха в target (RGBA32) поверх его содержимого
+    void composite(SDL_Surface* target) const;
+    // Штрих перенесён в слой — очищаем
+    void end();
+    // Освобождает текстуру (до уничтожения рендерера)
+    void release();
+
+private:
+    static SDL_Rect dabRect(const BrushDab& dab);
+
+    SDL_Surface* pixels = nullptr;
+    SDL_Texture* texture = nullptr;
+    SDL_Rect dirty = { 0, 0, 0, 0 };      // ещё не загружено в текстуру
+    SDL_Rect touched = { 0, 0, 0, 0 };    // всё, что нарисовано за штрих
+    Uint32 color = 0;
+    bool visible = false;
+};
@@ -0,0 +1,65 @@
+#include "thumbnail.h"
+#include <algorithm>
+
+ThumbnailSamples gatherThumbnailSamples(SDL_Surface* surface, int size) {
+    ThumbnailSamples out;
+    if (!surface || surface->w <= 0 || surface->h <= 0 || size <= 0) return out;
+    if (SDL_BYTESPERPIXEL(surface->format) != 4) return out;
+
+    const float k = std::min(float(size) / surface->w, float(size) / surface->h);
+    out.w = std::max(1, static_cast<int>(surface->w * k + 0.5f));
+    out.h = std::max(1, static_cast<int>(surface->h * k + 0.5f));
+    const float cellW = float(surface->w) / out.w, cellH = float(surface->h) / out.h;
+    out.samplesX = std::clamp(static_cast<int>(cellW), 1, 4);
+    out.samplesY = std::clamp(static_cast<int>(cellH), 1, 4);
+
+    const int cols = out.w * out.samplesX, rows = out.h * out.samplesY;
+    out.pixels.resize(static_cast<size_t>(cols) * rows * 4);
+    std::vector<int> xs(cols);
+    for (int i = 0; i < cols; ++i) {
+        xs[i] = std::min(surface->w - 1, static_cast<int>((i / out.samplesX + (i % out.samplesX + 0.5f) / out.samplesX) * cellW));
+    }
+    SDL_LockSurface(surface);
+    for (int j = 0; j < rows; ++j) {
+        const int py = std::min(surface->h - 1, static_cast<int>((j / out.samplesY + (j % out.samplesY + 0.5f) / out.samplesY) * cellH));
+        const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) + py * surface->pitch);
+        Uint32* dst = reinterpret_cast<Uint32*>(&out.pixels[static_cast<size_t>(j) * cols * 4]);
+        for (int i = 0; i < cols; ++i) dst[i] = row[xs[i]];
+    }
+    SDL_UnlockSurface(surface);
+    return out;
+}
+
+ThumbnailPixels buildThumbnail(const ThumbnailSamples& samples) {
+    ThumbnailPixels out;
+    if (samples.pixels.empty()) return out;
+    out.w = samples.w;
+    out.h = samples.h;
+    out.pixels.assign(static_cast<size_t>(out.w) * out.h * 4, 0);
+
+    const int cols = samples.w * samples.samplesX;
+    for (int y = 0; y < out.h; ++y) {
+        for (int x = 0; x < out.w; ++x) {
+            // Цвет усредняется с весом альфы, чтобы прозрачные пиксели не темнили край
+            Uint32 r = 0, g = 0, b = 0, a = 0;
+            for (int sy = 0; sy < samples.samplesY; ++sy) {
+                const Uint8* row = &samples.pixels[static_cast<size_t>(y * samples.samplesY + sy) * cols * 4];
+                for (int sx = 0; sx < samples.samplesX; ++sx) {
+                    const Uint8* p = row + (x * samples.samplesX + sx) * 4;
+                    r += p[0] * p[3];
+                    g += p[1] * p[3];
+                    b += p[2] * p[3];
+                    a += p[3];
+                }
+            }
+            Uint8* d = &out.pixels[(static_cast<size_t>(y) * out.w + x) * 4];
+            if (a > 0) {
+                d[0] = static_cast<Uint8>(r / a);
+                d[1] = static_cast<Uint8>(g / a);
+                d[2] = static_cast<Uint8>(b / a);
+                d[3] = static_cast<Uint8>(a / (samples.samplesX * samples.samplesY));
+            }
+        }
+    }
+    return out;
+}
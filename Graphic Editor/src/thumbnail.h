@@ -0,0 +1,44 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include "jobs.h"
+
+constexpr int ThumbnailSize = 24;
+
+// Отсчёты для миниатюры слоя: сетка до 4x4 пикселей слоя на каждый пиксель
+// миниатюры, вписанной в size x size с сохранением пропорций — не больше
+// 24 * 24 * 16 пикселей при любом размере слоя. Собираются в потоке UI прямо
+// из surface (копия слоя или его снимок для этого не нужны), усредняются в фоне.
+struct ThumbnailSamples {
+    int w = 0, h = 0;                 // размер миниатюры
+    int samplesX = 1, samplesY = 1;   // отсчётов на её пиксель
+    std::vector<Uint8> pixels;        // RGBA32, (w * samplesX) x (h * samplesY)
+};
+ThumbnailSamples gatherThumbnailSamples(SDL_Surface* surface, int size = ThumbnailSize);
+
+// Миниатюра RGBA32 w x h: среднее отсчётов каждого пикселя (любой поток)
+struct ThumbnailPixels {
+    int w = 0, h = 0;
+    std::vector<Uint8> pixels;
+};
+ThumbnailPixels buildThumbnail(const ThumbnailSamples& samples);
+
+// Миниатюра слоя для панели слоёв. Пиксели считаются фоновой задачей,
+// текстура обновляется в потоке UI по её завершении.
+struct LayerThumbnail {
+    SDL_Texture* texture = nullptr;
+    int w = 0, h = 0;
+    Uint32 revision = 0;          // ревизия слоя, по которой построена текстура
+    bool built = false;
+    Uint32 seenRevision = 0;      // последняя замеченная ревизия слоя
+    Uint64 staleSince = 0;        // когда она появилась (мс)
+    TaskGroupPtr job;
+
+    LayerThumbnail() = default;
+    LayerThumbnail(const LayerThumbnail&) = delete;
+    LayerThumbnail& operator=(const LayerThumbnail&) = delete;
+    ~LayerThumbnail() {
+        if (job) job->cancel();
+        if (texture) SDL_DestroyTexture(texture);
+    }
+};
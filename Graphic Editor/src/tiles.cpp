@@ -0,0 +1,102 @@
+#include "tiles.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+PixelTilePtr copyTile(const SDL_Surface* surface, int x0, int y0, int w, int h) {
+    auto tile = std::make_shared<PixelTile>();
+    tile->w = w;
+    tile->h = h;
+    tile->pixels.resize(static_cast<size_t>(w) * h * 4);
+    const Uint8* src = static_cast<const Uint8*>(surface->pixels) + static_cast<size_t>(y0) * surface->pitch + x0 * 4;
+    for (int y = 0; y < h; ++y) {
+        std::memcpy(&tile->pixels[static_cast<size_t>(y) * w * 4], src + static_cast<size_t>(y) * surface->pitch, w * 4);
+    }
+    return tile;
+}
+
+}
+
+std::shared_ptr<const TileSnapshot> snapshotLayer(Layer& layer) {
+    SDL_Surface* surface = layer.surface;
+    if (!surface || surface->format != SDL_PIXELFORMAT_RGBA32) return nullptr;
+
+    std::shared_ptr<const TileSnapshot> held = layer.tiles.lock();
+    const TileSnapshot* prev = held.get();
+    // Тайлы прошлого снимка годятся, только если размер не менялся
+    if (prev && (prev->w != surface->w || prev->h != surface->h)) prev = nullptr;
+
+    auto snap = std::make_shared<TileSnapshot>();
+    snap->w = surface->w;
+    snap->h = surface->h;
+    snap->tilesX = (surface->w + LayerTileSize - 1) / LayerTileSize;
+    snap->tilesY = (surface->h + LayerTileSize - 1) / LayerTileSize;
+    snap->tiles.resize(static_cast<size_t>(snap->tilesX) * snap->tilesY);
+    snap->revisions.resize(snap->tiles.size());
+
+    bool changed = !prev;
+    SDL_LockSurface(surface);
+    for (int ty = 0; ty < snap->tilesY; ++ty) {
+        for (int tx = 0; tx < snap->tilesX; ++tx) {
+            const size_t i = static_cast<size_t>(ty) * snap->tilesX + tx;
+            const Uint32 rev = layer.tileRevision(tx, ty);
+            snap->revisions[i] = rev;
+            if (prev && prev->revisions[i] == rev) {
+                snap->tiles[i] = prev->tiles[i];
+                continue;
+            }
+            const int x0 = tx * LayerTileSize, y0 = ty * LayerTileSize;
+            snap->tiles[i] = copyTile(surface, x0, y0, std::min(LayerTileSize, surface->w - x0),
+                                      std::min(LayerTileSize, surface->h - y0));
+            changed = true;
+        }
+    }
+    SDL_UnlockSurface(surface);
+
+    if (!changed) return held;
+    layer.tiles = snap;
+    return snap;
+}
+
+std::vector<Uint8> flattenTiles(const TileSnapshot& snapshot) {
+    const size_t pitch = static_cast<size_t>(snapshot.w) * 4;
+    std::vector<Uint8> out(pitch * snapshot.h);
+    for (int ty = 0; ty < snapshot.tilesY; ++ty) {
+        for (int tx = 0; tx < snapshot.tilesX; ++tx) {
+            const PixelTile& tile = *snapshot.tiles[static_cast<size_t>(ty) * snapshot.tilesX + tx];
+            Uint8* dst = &out[static_cast<size_t>(ty) * LayerTileSize * pitch + static_cast<size_t>(tx) * LayerTileSize * 4];
+            for (int y = 0; y < tile.h; ++y) {
+                std::memcpy(dst + y * pitch, &tile.pixels[static_cast<size_t>(y) * tile.w * 4], tile.w * 4);
+            }
+        }
+    }
+    return out;
+}
+
+SDL_Surface* surfaceFromSnapshot(const TileSnapshot& snapshot) {
+    return surfaceFromSnapshot(snapshot, snapshot.w, snapshot.h, 0, 0);
+}
+
+SDL_Surface* surfaceFromSnapshot(const TileSnapshot& snapshot, int newW, int newH, int offsetX, int offsetY) {
+    SDL_Surface* surface = SDL_CreateSurface(newW, newH, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) {
+        SDL_Log("surfaceFromSnapshot: %s", SDL_GetError());
+        return nullptr;
+    }
+    const SDL_Rect bounds = { 0, 0, newW, newH };
+    Uint8* pixels = static_cast<Uint8*>(surface->pixels);
+    for (int ty = 0; ty < snapshot.tilesY; ++ty) {
+        for (int tx = 0; tx < snapshot.tilesX; ++tx) {
+            const PixelTile& tile = *snapshot.tiles[static_cast<size_t>(ty) * snapshot.tilesX + tx];
+            const SDL_Rect r = { tx * LayerTileSize + offsetX, ty * LayerTileSize + offsetY, tile.w, tile.h };
+            SDL_Rect clip;
+            if (!SDL_GetRectIntersection(&r, &bounds, &clip)) continue;
+            for (int y = clip.y; y < clip.y + clip.h; ++y) {
+                std::memcpy(pixels + static_cast<size_t>(y) * surface->pitch + clip.x * 4,
+                            &tile.pixels[(static_cast<size_t>(y - r.y) * tile.w + (clip.x - r.x)) * 4], clip.w * 4);
+            }
+        }
+    }
+    return surface;
+}
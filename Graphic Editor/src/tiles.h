@@ -0,0 +1,37 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <memory>
+#include <vector>
+#include "layer.h"
+
+// Неизменяемый тайл пикселей RGBA32 (LayerTileSize x LayerTileSize, крайние меньше)
+struct PixelTile {
+    int w = 0, h = 0;
+    std::vector<Uint8> pixels;   // строки по w * 4 байт подряд
+};
+using PixelTilePtr = std::shared_ptr<const PixelTile>;
+
+// Снимок пикселей слоя по тайлам. Тайлы разделяются между снимками и копиями
+// слоя; новый снимок копирует только тайлы, изменённые после прошлого
+// (по ревизиям тайлов слоя), остальные — указатели из прошлого снимка.
+// Снимок не меняется, поэтому его можно отдавать фоновым задачам.
+struct TileSnapshot {
+    int w = 0, h = 0;
+    int tilesX = 0, tilesY = 0;
+    std::vector<PixelTilePtr> tiles;
+    std::vector<Uint32> revisions;   // ревизия слоя, по которой снят тайл
+};
+
+// Снимок текущих пикселей слоя. Пока прошлый снимок жив (его держит задача),
+// неизменённые тайлы берутся из него; когда задачи его отпустят, память
+// освобождается, и следующий снимок копирует слой заново.
+// Только в потоке UI. Пустой указатель — у слоя нет пикселей.
+std::shared_ptr<const TileSnapshot> snapshotLayer(Layer& layer);
+
+// Собирает снимок в сплошной буфер RGBA32 (pitch = w * 4)
+std::vector<Uint8> flattenTiles(const TileSnapshot& snapshot);
+// Новый surface RGBA32 с пикселями снимка (любой поток); nullptr при ошибке
+SDL_Surface* surfaceFromSnapshot(const TileSnapshot& snapshot);
+// То же в surface newW x newH со сдвигом (offsetX, offsetY): остальное прозрачно,
+// выходящее за край обрезается
+SDL_Surface* surfaceFromSnapshot(const TileSnapshot& snapshot, int newW, int newH, int offsetX, int offsetY);
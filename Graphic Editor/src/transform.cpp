@@ -0,0 +1,280 @@
+#include "transform.h"
+#include "parallel.h"
+#include "resize.h"
+#include <algorithm>
+#include <math.h>
+
+namespace {
+
+constexpr int WarpTile = 64;
+constexpr float Pi = 3.14159265358979f;
+
+int filterRadius(Resample filter) {
+    switch (filter) {
+        case Resample::Bilinear: return 1;
+        case Resample::Bicubic:  return 2;
+        case Resample::Lanczos3: return 3;
+        default:                 return 0;
+    }
+}
+
+// Отсчёт src в точке (u, v) (центры пикселей — в целых), премультиплицированный RGBA
+void sample(const Uint8* pixels, int pitch, int w, int h, Resample filter,
+            float u, float v, float out[4]) {
+    out[0] = out[1] = out[2] = out[3] = 0.0f;
+
+    if (filter == Resample::Nearest) {
+        int x = static_cast<int>(floorf(u + 0.5f));
+        int y = static_cast<int>(floorf(v + 0.5f));
+        if (x < 0 || y < 0 || x >= w || y >= h) return;
+        const Uint8* p = pixels + y * pitch + x * 4;
+        float a = p[3] / 255.0f;
+        out[0] = p[0] * a;
+        out[1] = p[1] * a;
+        out[2] = p[2] * a;
+        out[3] = p[3];
+        return;
+    }
+
+    const int r = filterRadius(filter);
+    int x0 = static_cast<int>(floorf(u)) - r + 1;
+    int y0 = static_cast<int>(floorf(v)) - r + 1;
+    if (x0 + 2 * r <= 0 || y0 + 2 * r <= 0 || x0 >= w || y0 >= h) return;
+
+    float wx[6], wy[6];
+    float sumX = 0.0f, sumY = 0.0f;
+    for (int i = 0; i < 2 * r; ++i) {
+        wx[i] = resampleWeight(filter, u - (x0 + i));
+        wy[i] = resampleWeight(filter, v - (y0 + i));
+        sumX += wx[i];
+        sumY += wy[i];
+    }
+    float norm = 1.0f / (sumX * sumY);
+
+    // Пиксели за краем src прозрачны — это и даёт сглаженный край
+    for (int j = 0; j < 2 * r; ++j) {
+        int y = y0 + j;
+        if (y < 0 || y >= h || wy[j] == 0.0f) continue;
+        const Uint8* row = pixels + y * pitch;
+        for (int i = 0; i < 2 * r; ++i) {
+            int x = x0 + i;
+            if (x < 0 || x >= w) continue;
+            const Uint8* p = row + x * 4;
+            float weight = wx[i] * wy[j];
+            float a = p[3] * weight;
+            out[0] += p[0] * a;
+            out[1] += p[1] * a;
+            out[2] += p[2] * a;
+            out[3] += a;
+        }
+    }
+    float scaleA = norm / 255.0f;
+    out[0] *= scaleA;
+    out[1] *= scaleA;
+    out[2] *= scaleA;
+    out[3] *= norm;
+}
+
+}
+
+const char* resampleName(Resample filter) {
+    switch (filter) {
+        case Resample::Nearest:  return "nearest";
+        case Resample::Bilinear: return "bilinear";
+        case Resample::Bicubic:  return "bicubic";
+        case Resample::Lanczos3: return "lanczos3";
+        case Resample::Box:      return "box";
+    }
+    return "?";
+}
+
+float resampleSupport(Resample filter) {
+    switch (filter) {
+        case Resample::Bilinear: return 1.0f;
+        case Resample::Bicubic:  return 2.0f;
+        case Resample::Lanczos3: return 3.0f;
+        default:                 return 0.5f;
+    }
+}
+
+float resampleWeight(Resample filter, float x) {
+    x = fabsf(x);
+    switch (filter) {
+        case Resample::Bilinear:
+            return x < 1.0f ? 1.0f - x : 0.0f;
+        case Resample::Bicubic: {
+            const float a = -0.5f;
+            if (x < 1.0f) return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
+            if (x < 2.0f) return ((a * x - 5.0f * a) * x + 8.0f * a) * x - 4.0f * a;
+            return 0.0f;
+        }
+        case Resample::Lanczos3: {
+            if (x < 1e-5f) return 1.0f;
+            if (x >= 3.0f) return 0.0f;
+            float px = Pi * x;
+            return 3.0f * sinf(px) * sinf(px / 3.0f) / (px * px);
+        }
+        default:
+            return x < 0.5f ? 1.0f : 0.0f;
+    }
+}
+
+Affine Affine::translate(float x, float y) {
+    Affine m;
+    m.tx = x;
+    m.ty = y;
+    return m;
+}
+
+Affine Affine::scale(float sx, float sy) {
+    Affine m;
+    m.a = sx;
+    m.d = sy;
+    return m;
+}
+
+Affine Affine::rotate(float radians) {
+    Affine m;
+    float cs = cosf(radians), sn = sinf(radians);
+    m.a = cs;  m.b = -sn;
+    m.c = sn;  m.d = cs;
+    return m;
+}
+
+Affine Affine::skew(float shx, float shy) {
+    Affine m;
+    m.b = shx;
+    m.c = shy;
+    return m;
+}
+
+Affine Affine::operator*(const Affine& o) const {
+    Affine m;
+    m.a = a * o.a + b * o.c;
+    m.b = a * o.b + b * o.d;
+    m.c = c * o.a + d * o.c;
+    m.d = c * o.b + d * o.d;
+    m.tx = a * o.tx + b * o.ty + tx;
+    m.ty = c * o.tx + d * o.ty + ty;
+    return m;
+}
+
+Affine Affine::inverse() const {
+    Affine m;
+    float det = a * d - b * c;
+    if (fabsf(det) < 1e-12f) return m;
+    float inv = 1.0f / det;
+    m.a =  d * inv;
+    m.b = -b * inv;
+    m.c = -c * inv;
+    m.d =  a * inv;
+    m.tx = -(m.a * tx + m.b * ty);
+    m.ty = -(m.c * tx + m.d * ty);
+    return m;
+}
+
+SDL_FRect transformedBounds(const SDL_FRect& rect, const Affine& m) {
+    SDL_FPoint corners[4] = {
+        m.apply(rect.x, rect.y),
+        m.apply(rect.x + rect.w, rect.y),
+        m.apply(rect.x, rect.y + rect.h),
+        m.apply(rect.x + rect.w, rect.y + rect.h)
+    };
+    float minX = corners[0].x, maxX = corners[0].x;
+    float minY = corners[0].y, maxY = corners[0].y;
+    for (const SDL_FPoint& p : corners) {
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+    }
+    return SDL_FRect{ minX, minY, maxX - minX, maxY - minY };
+}
+
+namespace {
+
+void warpTiles(SDL_Surface* src, SDL_Surface* dst, const Affine& forward,
+               Resample filter, SDL_Rect area, WarpBlend blend) {
+    const Affine inv = forward.inverse();
+    SDL_LockSurface(src);
+    SDL_LockSurface(dst);
+    const Uint8* srcPixels = static_cast<const Uint8*>(src->pixels);
+    Uint8* dstPixels = static_cast<Uint8*>(dst->pixels);
+
+    int tilesX = (area.w + WarpTile - 1) / WarpTile;
+    int tilesY = (area.h + WarpTile - 1) / WarpTile;
+
+    parallelFor(0, tilesX * tilesY, 1, [&](int from, int to) {
+        for (int t = from; t < to; ++t) {
+            int x0 = area.x + (t % tilesX) * WarpTile;
+            int y0 = area.y + (t / tilesX) * WarpTile;
+            int x1 = std::min(x0 + WarpTile, area.x + area.w);
+            int y1 = std::min(y0 + WarpTile, area.y + area.h);
+
+            for (int y = y0; y < y1; ++y) {
+                // Центр пикселя dst -> координаты src; вдоль строки шаг постоянный
+                SDL_FPoint s = inv.apply(x0 + 0.5f, y + 0.5f);
+                float u = s.x - 0.5f, v = s.y - 0.5f;
+                Uint8* row = dstPixels + y * dst->pitch;
+
+                for (int x = x0; x < x1; ++x, u += inv.a, v += inv.c) {
+                    float c[4];
+                    sample(srcPixels, src->pitch, src->w, src->h, filter, u, v, c);
+                    float a = std::clamp(c[3], 0.0f, 255.0f);
+                    if (a < 0.5f) continue;
+
+                    // c[0..2] — цвет, умноженный на альфу; dst хранится без умножения
+                    Uint8* p = row + x * 4;
+                    float k = a / 255.0f;
+                    float below = (p[3] / 255.0f) * (blend == WarpBlend::Add ? 1.0f : 1.0f - k);
+                    float outA = k + below;
+                    float norm = 1.0f / outA;
+                    outA = std::min(outA, 1.0f);   // Add: сумма покрытий не больше 1
+                    // отрицательные лепестки бикубики и Ланцоша обрезаем
+                    p[0] = static_cast<Uint8>(std::clamp((c[0] + p[0] * below) * norm + 0.5f, 0.0f, 255.0f));
+                    p[1] = static_cast<Uint8>(std::clamp((c[1] + p[1] * below) * norm + 0.5f, 0.0f, 255.0f));
+                    p[2] = static_cast<Uint8>(std::clamp((c[2] + p[2] * below) * norm + 0.5f, 0.0f, 255.0f));
+                    p[3] = static_cast<Uint8>(outA * 255.0f + 0.5f);
+                }
+            }
+        }
+    });
+
+    SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(src);
+}
+
+}
+
+void warpAffine(SDL_Surface* src, SDL_Surface* dst, const Affine& forward,
+                Resample filter, SDL_Rect area, WarpBlend blend) {
+    if (!src || !dst) return;
+    SDL_Rect dstRect = { 0, 0, dst->w, dst->h };
+    if (!SDL_GetRectIntersection(&area, &dstRect, &area)) return;
+
+    // Масштаб вдоль осей src. При уменьшении ядро обратной выборки пропускает
+    // пиксели, поэтому src сначала сжимается сепарабельным фильтром с растянутым
+    // ядром (resizeSurface), а затем преобразуется уже почти без уменьшения
+    const float sx = std::hypot(forward.a, forward.c);
+    const float sy = std::hypot(forward.b, forward.d);
+    if (filter != Resample::Nearest && (sx < 0.75f || sy < 0.75f)) {
+        const int w = std::max(1, static_cast<int>(ceilf(src->w * std::min(sx, 1.0f))));
+        const int h = std::max(1, static_cast<int>(ceilf(src->h * std::min(sy, 1.0f))));
+        SDL_Surface* reduced = resizeSurface(src, w, h, filter);
+        if (reduced) {
+            const Affine expand = Affine::scale(static_cast<float>(src->w) / w, static_cast<float>(src->h) / h);
+            warpTiles(reduced, dst, forward * expand, filter, area, blend);
+            SDL_DestroySurface(reduced);
+            return;
+        }
+    }
+    warpTiles(src, dst, forward, filter, area, blend);
+}
+
+void TransformSession::release() {
+    if (floating) SDL_DestroySurface(floating);
+    if (original) SDL_DestroySurface(original);
+    if (proxy) SDL_DestroySurface(proxy);
+    if (preview) SDL_DestroyTexture(preview);
+    *this = TransformSession();
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include "layerstack.h"
+
+enum class Resample {
+    Nearest,
+    Bilinear,
+    Bicubic,    // Catmull-Rom
+    Lanczos3,
+    Box         // только для изменения размера: среднее по площади
+};
+
+const char* resampleName(Resample filter);
+
+// Радиус ядра фильтра в пикселях и его вес на расстоянии x
+float resampleSupport(Resample filter);
+float resampleWeight(Resample filter, float x);
+
+// Аффинное преобразование: x' = a*x + b*y + tx, y' = c*x + d*y + ty
+struct Affine {
+    float a = 1, b = 0, c = 0, d = 1;
+    float tx = 0, ty = 0;
+
+    static Affine translate(float x, float y);
+    static Affine scale(float sx, float sy);
+    static Affine rotate(float radians);
+    static Affine skew(float shx, float shy);
+
+    Affine operator*(const Affine& o) const;   // (A * B)(p) = A(B(p))
+    Affine inverse() const;
+    SDL_FPoint apply(float x, float y) const { return { a * x + b * y + tx, c * x + d * y + ty }; }
+    bool identity() const { return a == 1 && b == 0 && c == 0 && d == 1 && tx == 0 && ty == 0; }
+};
+
+// Bounding box прямоугольника после преобразования
+SDL_FRect transformedBounds(const SDL_FRect& rect, const Affine& m);
+
+// Как пиксели src ложатся на dst
+enum class WarpBlend {
+    Over,   // source-over
+    Add     // покрытия складываются (не больше 1): src и dst — дополняющие части
+            // одних пикселей, например вырезанное с мягким краем выделения и остаток
+};
+
+// Рисует src, преобразованный матрицей forward (координаты src -> координаты dst),
+// поверх dst в пределах area. Обратное отображение: каждый пиксель
+// dst берёт отсчёт из src; работа делится на тайлы 64x64 между всеми ядрами.
+// При уменьшении src сначала сжимается с растянутым ядром фильтра (без алиасинга).
+void warpAffine(SDL_Surface* src, SDL_Surface* dst, const Affine& forward,
+                Resample filter, SDL_Rect area, WarpBlend blend = WarpBlend::Over);
+
+enum class TransformMode {
+    Move,
+    Scale,      // Shift
+    Rotate,     // Alt
+    Skew        // Shift + Alt
+};
+
+// Состояние свободной трансформации: вырезанные пиксели и текущая матрица.
+// Сессия живёт между перетаскиваниями: каждое перетаскивание домножает матрицу,
+// а пиксели пересчитываются из floating один раз — при фиксации (Enter,
+// другой инструмент или операция над слоями).
+struct TransformSession {
+    bool active = false;
+    bool dragging = false;             // идёт перетаскивание мышью
+    LayerId layer = NoLayer;           // слой по номеру: его позиция может смениться до фиксации
+    TransformMode mode = TransformMode::Move;
+
+    SDL_Surface* floating = nullptr;   // вырезанные пиксели (полное разрешение)
+    SDL_Surface* original = nullptr;   // нетронутая копия области до вырезания — для отмены
+    SDL_Point origin = {0, 0};         // положение floating на холсте
+    SDL_Surface* proxy = nullptr;      // уменьшенная копия для предпросмотра
+    float proxyScale = 1.0f;
+
+    Affine matrix;                     // координаты холста -> координаты холста
+    Affine base;                       // матрица до текущего перетаскивания
+    SDL_FPoint pivot = {0, 0};
+    SDL_FPoint dragStart = {0, 0};
+
+    SDL_Texture* preview = nullptr;
+    SDL_FRect previewRect = {0, 0, 0, 0};  // в координатах холста
+
+    void release();
+};
@@ -12,7 +12,10 @@ enum class Tool {
     Move,
     Erase,
     Brush,
-    Pen
+    Pen,
+    Fill,
+    Wand,
+    Transform
 };
 
 class Rect : public Drawable {
@@ -140,6 +143,7 @@ enum class ActionType {
     MoveLayerUp,
     MoveLayerDown,
     DrawBrushStroke,
+    DuplicateLayer,
 };
 
 class DrawableImageBackground : public Drawable {
@@ -147,8 +151,14 @@ class DrawableImageBackground : public Drawable {
         SDL_Texture* texture;
         int width, height;
     
+        // Текстура переходит во владение объекта и уничтожается вместе с ним
         DrawableImageBackground(SDL_Texture* tex, int w, int h)
             : texture(tex), width(w), height(h) {}
+        DrawableImageBackground(const DrawableImageBackground&) = delete;
+        DrawableImageBackground& operator=(const DrawableImageBackground&) = delete;
+        ~DrawableImageBackground() override {
+            if (texture) SDL_DestroyTexture(texture);
+        }
     
         void draw(SDL_Renderer* renderer, float scale, float offsetX, float offsetY) const override {
             SDL_FRect dstRect = {
@@ -159,6 +169,11 @@ class DrawableImageBackground : public Drawable {
             SDL_RenderTexture(renderer, texture, nullptr, &dstRect);
         }
 
+        bool bounds(SDL_FRect& out) const override {
+            out = SDL_FRect{ 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height) };
+            return true;
+        }
+
         //void drawToSurface(SDL_Surface* surface, SDL_Renderer* renderer) const override {
         //    // захватим текстуру в пиксели через рендерер
         //    std::vector<Uint32> buf(width*height);
@@ -1,7 +1,43 @@
 #include "undo.h"
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include "editor.h"
 
+std::vector<Uint8> PixelPatch::read(SDL_Surface* surface, const SDL_Rect& area) {
+    std::vector<Uint8> pixels(static_cast<size_t>(area.w) * area.h * 4);
+    SDL_LockSurface(surface);
+    for (int y = 0; y < area.h; ++y) {
+        std::memcpy(&pixels[static_cast<size_t>(y) * area.w * 4],
+                    static_cast<const Uint8*>(surface->pixels) + (area.y + y) * surface->pitch + area.x * 4, area.w * 4);
+    }
+    SDL_UnlockSurface(surface);
+    return pixels;
+}
+
+void PixelPatch::write(SDL_Surface* surface, const SDL_Rect& area, const std::vector<Uint8>& pixels) {
+    SDL_LockSurface(surface);
+    for (int y = 0; y < area.h; ++y) {
+        std::memcpy(static_cast<Uint8*>(surface->pixels) + (area.y + y) * surface->pitch + area.x * 4,
+                    &pixels[static_cast<size_t>(y) * area.w * 4], area.w * 4);
+    }
+    SDL_UnlockSurface(surface);
+}
+
+// Возвращает пиксели штриха (before или after). Если surface слоя с тех пор подменили
+// (размер, поворот, отражение), координаты прямоугольника уже не те — пропускаем
+void UndoManager::applyPatch(Editor& editor, Layer* layer, int pos, const PixelPatch* patch, bool undo) {
+    if (!layer || !patch) return;
+    if (layer->surfaceGeneration != patch->generation) {
+        SDL_Log("Undo: the layer was resized or rotated after the stroke, pixels are left as is");
+        return;
+    }
+    SDL_Surface* surface = layer->writableSurface();
+    if (!surface || patch->area.x + patch->area.w > surface->w || patch->area.y + patch->area.h > surface->h) return;
+    PixelPatch::write(surface, patch->area, undo ? patch->before : patch->after);
+    editor.refreshLayerTexture(pos, &patch->area);
+}
+
 void UndoManager::add_action(const Action& action) {
     if (index + 1 < (int)history.size())
         history.erase(history.begin() + index + 1, history.end());
@@ -9,41 +45,52 @@ void UndoManager::add_action(const Action& action) {
     ++index;
 }
 
-void UndoManager::undo(Editor& editor, std::vector<Layer>& layers, int& active_layer) {
+void UndoManager::clear() {
+    history.clear();
+    index = -1;
+}
+
+void UndoManager::undo(Editor& editor, LayerStack& layers, int& active_layer) {
     if (index < 0) return;
 
-    const Action& action = history[index];
+    Action& action = history[index];
+    Layer* layer = layers.find(action.layer);
+    const int pos = layers.indexOf(action.layer);
 
-    int tmp = active_layer;
-    int tmp1 = action.previous_active_layer;
+    LayerId tmp = layers.idAt(active_layer);
+    LayerId tmp1 = action.previous_active_layer;
 
     switch (action.type) {
         case ActionType::AddRect:
-            if (!layers[action.layerIndex].rects.empty()) {
-                layers[action.layerIndex].rects.pop_back();
-            }
+            if (layer) layer->editShapes().remove(action.object);
             break;
         case ActionType::ToggleVisibility:
-            layers[action.layerIndex].visible = action.previous_visibility;
+            if (layer) layer->visible = action.previous_visibility;
             break;
         case ActionType::ChangeActiveLayer:
             std::swap(tmp, tmp1);
             break;
         case ActionType::MoveLayerUp:
-        case ActionType::MoveLayerDown:
-            std::swap(
-                layers[action.layerIndex],
-                layers[action.layerIndex + (action.type == ActionType::MoveLayerUp ? -1 : 1)]
-            );
-            active_layer = action.layerIndex;
+        case ActionType::MoveLayerDown: {
+            // Слой возвращается на место, откуда его сдвинули
+            int from = pos + (action.type == ActionType::MoveLayerUp ? 1 : -1);
+            if (pos >= 0 && from >= 0 && from < static_cast<int>(layers.size())) {
+                layers.swap(pos, from);
+                active_layer = from;
+            }
             break;
+        }
         case ActionType::DrawBrushStroke: // Обработка кисти
-            // Remove the last brush stroke (undo the drawing)
-            if (!editor.brushStrokes.empty()) {
-                editor.brushStrokes.pop_back();
-            }
-            if (!layers[action.layerIndex].strokes.empty()) {
-                layers[action.layerIndex].strokes.pop_back();
+            applyPatch(editor, layer, pos, action.patch.get(), true);
+            break;
+        case ActionType::DuplicateLayer:
+            // Копия уходит из стопки в историю вместе со своим номером; пиксели
+            // остаются общими с исходным слоем, так что это перенос указателей
+            if (pos >= 0) {
+                action.removedLayer = std::make_shared<Layer>(std::move(layers[pos]));
+                action.layerPosition = pos;
+                layers.erase(pos);
+                active_layer = std::max(0, pos - 1);
             }
             break;
         default:
@@ -53,35 +100,45 @@ void UndoManager::undo(Editor& editor, std::vector<Layer>& layers, int& active_l
     --index;
 }
 
-void UndoManager::redo(Editor& editor, std::vector<Layer>& layers, int& active_layer) {
+void UndoManager::redo(Editor& editor, LayerStack& layers, int& active_layer) {
     if (index + 1 >= (int)history.size()) return;
 
     ++index;
-    const Action& action = history[index];
+    Action& action = history[index];   // при повторе объекты получают новые дескрипторы
+    Layer* layer = layers.find(action.layer);
+    const int pos = layers.indexOf(action.layer);
 
-    int tmp = active_layer;
-    int tmp1 = action.previous_active_layer;
+    LayerId tmp = layers.idAt(active_layer);
+    LayerId tmp1 = action.previous_active_layer;
 
     switch (action.type) {
         case ActionType::AddRect:
-            layers[action.layerIndex].rects.push_back(action.rect);
+            if (layer) action.object = layer->addRect(action.rect);
             break;
         case ActionType::ToggleVisibility:
-            layers[action.layerIndex].visible = !action.previous_visibility;
+            if (layer) layer->visible = !action.previous_visibility;
             break;
         case ActionType::ChangeActiveLayer:
             std::swap(tmp, tmp1);
             break;
         case ActionType::MoveLayerUp:
-        case ActionType::MoveLayerDown:
-            std::swap(
-                layers[action.layerIndex],
-                layers[action.layerIndex + (action.type == ActionType::MoveLayerUp ? -1 : 1)]
-            );
-            active_layer = action.layerIndex + (action.type == ActionType::MoveLayerUp ? -1 : 1);
+        case ActionType::MoveLayerDown: {
+            int to = pos + (action.type == ActionType::MoveLayerUp ? -1 : 1);
+            if (pos >= 0 && to >= 0 && to < static_cast<int>(layers.size())) {
+                layers.swap(pos, to);
+                active_layer = to;
+            }
             break;
+        }
         case ActionType::DrawBrushStroke: // Обработка повторного действия кисти
-            editor.brushStrokes.push_back(action.brushStroke);
+            applyPatch(editor, layer, pos, action.patch.get(), false);
+            break;
+        case ActionType::DuplicateLayer:
+            if (action.removedLayer) {
+                LayerId id = layers.insert(action.layerPosition, std::move(*action.removedLayer), action.layer);
+                action.removedLayer.reset();
+                active_layer = layers.indexOf(id);
+            }
             break;
         default:
             break;
@@ -1,25 +1,48 @@
 #pragma once
+#include <memory>
 #include <vector>
 #include "types.h"
-#include "layer.h"
+#include "layerstack.h"
 
 class Editor;
 
+// Пиксели прямоугольника слоя до и после изменения (RGBA32, строки подряд)
+struct PixelPatch {
+    SDL_Rect area;
+    Uint32 generation = 0;   // Layer::surfaceGeneration при записи
+    std::vector<Uint8> before, after;
+
+    static std::vector<Uint8> read(SDL_Surface* surface, const SDL_Rect& area);
+    static void write(SDL_Surface* surface, const SDL_Rect& area, const std::vector<Uint8>& pixels);
+};
+
 struct Action {
+    // Прямоугольник нужен только AddRect, остальным действиям — пустой
+    Action(ActionType type, LayerId layer,
+           const Rect& rect = Rect{SDL_Rect{0, 0, 0, 0}, SDL_Color{0, 0, 0, 0}})
+        : type(type), layer(layer), rect(rect) {}
+
     ActionType type;
-    int layerIndex;
+    LayerId layer;           // слой по постоянному номеру: позиции меняются при перестановке
     Rect rect;
-    bool previous_visibility;
-    int previous_active_layer;
-    BrushStroke brushStroke;
+    bool previous_visibility = true;
+    LayerId previous_active_layer = NoLayer;
+    ObjectHandle object;     // AddRect: добавленный прямоугольник
+    std::shared_ptr<const PixelPatch> patch;   // DrawBrushStroke: изменённые пиксели слоя
+    std::shared_ptr<Layer> removedLayer;   // DuplicateLayer: копия, убранная отменой
+    int layerPosition = -1;                // и её место в стопке
 };
 
 class UndoManager {
     std::vector<Action> history;
     int index = -1;
 
+    static void applyPatch(Editor& editor, Layer* layer, int pos, const PixelPatch* patch, bool undo);
+
 public:
     void add_action(const Action& action);
-    void undo(Editor& editor, std::vector<Layer>& layers, int& active_layer);
-    void redo(Editor& editor, std::vector<Layer>& layers, int& active_layer);
+    void clear();
+    // Действия над удалёнными слоями пропускаются
+    void undo(Editor& editor, LayerStack& layers, int& active_layer);
+    void redo(Editor& editor, LayerStack& layers, int& active_layer);
 };